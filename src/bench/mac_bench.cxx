@@ -0,0 +1,281 @@
+/******************************************************************************
+ * mac_bench.cxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Microbenchmark of WRT's MAC conversions against the std::stringstream      *
+ * ones they replaced (kept here, as they were, for comparison). Each         *
+ * conversion is run over a synthetic inventory, one MAC at a time and in     *
+ * bulk, and the time per MAC printed - once every conversion is checked to   *
+ * give what the old ones gave.                                               *
+ *                                                                            *
+ *   usage: mac_bench [MACs] [rounds]                                         *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_mac.hxx>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const size_t kDefaultMACs   = 100000;
+const size_t kDefaultRounds = 10;
+
+/******************************************************************************
+ * The stringstream conversions, as AccessPoint had them                      *
+ ******************************************************************************/
+
+void StreamFormatMAC(std::string &MACtoFormat)
+{
+  if (MACtoFormat.empty()) {
+    MACtoFormat = std::string("00:00:00:00:00:00");
+
+  } else {
+    std::stringstream ss(std::ios_base::in |
+                         std::ios_base::out | std::ios_base::ate);
+
+    ss << std::uppercase << MACtoFormat;
+    ss >> MACtoFormat;
+  }
+}
+
+void StreamMACtoEUI64(std::string &MACtoMutate)
+{
+  std::stringstream ss(std::ios_base::in
+                       | std::ios_base::out
+                       | std::ios_base::ate);
+
+  ss << "fe80::" << MACtoMutate.at(0) << std::hex
+     << (std::strtoul(MACtoMutate.c_str() + 1, NULL, 16) | 0x2)
+     << std::dec << std::nouppercase << MACtoMutate.substr(3, 5)
+     << "ff:fe" << MACtoMutate.substr(9, 5)
+     << MACtoMutate.substr(15, 2);
+
+  ss >> MACtoMutate;
+
+  std::transform(MACtoMutate.begin(),
+                 MACtoMutate.end(),
+                 MACtoMutate.begin(),
+                 (int (*)(int))std::tolower);
+}
+
+/**
+ * Checks that every conversion gives what the stringstream ones gave, one
+ * MAC at a time and in bulk - a faster conversion which differs is no gain
+ */
+bool Verify(const std::vector<std::string> &texts, std::vector<uint64_t> &macs,
+            std::vector<char> &out)
+{
+  const size_t count = texts.size();
+  const size_t eui64 = wrt::mac::kEUI64Length + 1;
+
+  if (wrt::mac::ParseAll(texts.data(), count, macs.data()) != count) {
+    std::cerr << "mac::ParseAll did not parse every MAC" << std::endl;
+    return false;
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    char text[wrt::mac::kEUI64Length + 1];
+    std::string formatted(texts[i]), address;
+    uint64_t mac;
+
+    StreamFormatMAC(formatted);
+    address = formatted;
+    StreamMACtoEUI64(address);
+
+    //std::uppercase never applied to strings - the old FormatMAC left the
+    //case as it was given, where mac::Format writes upper case as meant
+    std::transform(formatted.begin(), formatted.end(), formatted.begin(),
+                   (int (*)(int))std::toupper);
+
+    //The old MACtoEUI64 set the universal/local bit rather than flipping
+    //it (RFC 4291), so it only agrees for universally administered MACs -
+    //every address must at least parse back to its MAC
+    uint64_t local = 0x020000000000ULL, back = 0;
+
+    if (!wrt::mac::Parse(texts[i], mac) || mac != macs[i] ||
+        formatted != wrt::mac::Format(mac, text) ||
+        (!(mac & local) &&
+         address != wrt::mac::FormatEUI64(mac, text)) ||
+        !wrt::mac::ParseEUI64(wrt::mac::FormatEUI64(mac, text), back) ||
+        back != mac) {
+      std::cerr << "Conversions of \"" << texts[i] << "\" differ" << std::endl;
+      return false;
+    }
+  }
+
+  wrt::mac::FormatAll(macs.data(), count, out.data());
+
+  for (size_t i = 0; i < count; ++i) {
+    char text[wrt::mac::kLength + 1];
+
+    if (wrt::mac::Format(macs[i], text) !=
+        std::string(out.data() + i * (wrt::mac::kLength + 1))) {
+      std::cerr << "mac::FormatAll differs at \"" << texts[i] << "\""
+                << std::endl;
+      return false;
+    }
+  }
+
+  wrt::mac::FormatEUI64All(macs.data(), count, out.data());
+
+  for (size_t i = 0; i < count; ++i) {
+    char text[wrt::mac::kEUI64Length + 1];
+
+    if (wrt::mac::FormatEUI64(macs[i], text) !=
+        std::string(out.data() + i * eui64)) {
+      std::cerr << "mac::FormatEUI64All differs at \"" << texts[i] << "\""
+                << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/******************************************************************************
+ * Timing                                                                     *
+ ******************************************************************************/
+
+/**
+ * Keeps the conversions' results live, so the work is not optimized away
+ */
+volatile size_t Sink;
+
+/**
+ * Runs a conversion over every MAC, rounds times, and prints ns per MAC
+ */
+template <typename Conversion>
+void Measure(const char *name, size_t macs, size_t rounds,
+             Conversion conversion)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  for (size_t round = 0; round < rounds; ++round) {
+    Sink = Sink + conversion();
+  }
+
+  std::chrono::duration<double, std::nano> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  std::cout << "  " << std::left << std::setw(32) << name
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << elapsed.count() / (macs * rounds)
+            << " ns/MAC" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count  = argc > 1 ? std::strtoul(argv[1], NULL, 10) : kDefaultMACs;
+  size_t rounds = argc > 2 ? std::strtoul(argv[2], NULL, 10) : kDefaultRounds;
+
+  if (!count || !rounds) {
+    std::cerr << "usage: mac_bench [MACs] [rounds]" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> texts(count);
+  std::vector<uint64_t>    macs(count);
+  std::vector<char>        out(count * (wrt::mac::kEUI64Length + 1));
+
+  //Lower case, so the formatters have something to do
+  for (size_t i = 0; i < count; ++i) {
+    char text[wrt::mac::kLength + 1];
+    uint64_t mac = (0x001122000000ULL + i * 2654435761ULL) & 0xFFFFFFFFFFFFULL;
+
+    snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x",
+             (unsigned) (mac >> 40) & 0xFF, (unsigned) (mac >> 32) & 0xFF,
+             (unsigned) (mac >> 24) & 0xFF, (unsigned) (mac >> 16) & 0xFF,
+             (unsigned) (mac >> 8) & 0xFF,  (unsigned) mac & 0xFF);
+    texts[i] = text;
+  }
+
+  if (!Verify(texts, macs, out)) {
+    return EXIT_FAILURE;
+  }
+
+  std::cout << count << " MACs, " << rounds << " rounds" << std::endl;
+
+  Measure("stringstream FormatMAC", count, rounds, [&texts]() {
+    std::string text;
+    size_t total = 0;
+
+    for (const auto &input : texts) {
+      text.assign(input);
+      StreamFormatMAC(text);
+      total += text.size();
+    }
+
+    return total;
+  });
+
+  Measure("stringstream MACtoEUI64", count, rounds, [&texts]() {
+    std::string text;
+    size_t total = 0;
+
+    for (const auto &input : texts) {
+      text.assign(input);
+      StreamMACtoEUI64(text);
+      total += text.size();
+    }
+
+    return total;
+  });
+
+  Measure("mac::Parse + mac::Format", count, rounds, [&texts]() {
+    char text[wrt::mac::kLength + 1];
+    size_t total = 0;
+    uint64_t mac;
+
+    for (const auto &input : texts) {
+      if (wrt::mac::Parse(input, mac)) {
+        total += wrt::mac::Format(mac, text)[0];
+      }
+    }
+
+    return total;
+  });
+
+  Measure("mac::Parse + mac::FormatEUI64", count, rounds, [&texts]() {
+    char text[wrt::mac::kEUI64Length + 1];
+    size_t total = 0;
+    uint64_t mac;
+
+    for (const auto &input : texts) {
+      if (wrt::mac::Parse(input, mac)) {
+        total += wrt::mac::FormatEUI64(mac, text)[0];
+      }
+    }
+
+    return total;
+  });
+
+  Measure("mac::ParseAll", count, rounds, [&texts, &macs, count]() {
+    return wrt::mac::ParseAll(texts.data(), count, macs.data());
+  });
+
+  Measure("mac::FormatAll", count, rounds, [&macs, &out, count]() {
+    wrt::mac::FormatAll(macs.data(), count, out.data());
+    return static_cast<size_t>(out[0]);
+  });
+
+  Measure("mac::FormatEUI64All", count, rounds, [&macs, &out, count]() {
+    wrt::mac::FormatEUI64All(macs.data(), count, out.data());
+    return static_cast<size_t>(out[0]);
+  });
+
+  return EXIT_SUCCESS;
+}
@@ -10,16 +10,26 @@
  *   o. To keep a history of individual logs. (FUTURE)                        *
  *   o. To create a record of based on individual statistics (SUPER FUTURE)   *
  *                                                                            *
+ * An AP is kept in binary form - the MAC as a 48 bit integer, addresses as   *
+ * in_addr/in6_addr with a bit marking each one present, and the name as a    *
+ * counted pointer into a pool shared by every AP (a name leaves the pool     *
+ * with the last AP holding it). Strings are only made when asked for, at the *
+ * edges (output, the configuration file, ssh targets).                       *
+ *                                                                            *
  ******************************************************************************/
 
 #ifndef LIBWRT_ACCESS_POINT_H_
 #define LIBWRT_ACCESS_POINT_H_
 
+#include <netinet/in.h>
+
 #include <string>
+#include <cstdint>
 #include <cstdlib>
 #include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
@@ -49,9 +59,10 @@ class AccessPoint
 {
 public:
   /**
-   * Enum class to uniquely identify AP type
+   * Enum class to uniquely identify AP type - names and profiles of each
+   * are in the type registry (wrt_types.hxx)
    */
-  enum class Type
+  enum class Type : uint8_t
   {
     none,
     tl_wr703n,
@@ -81,7 +92,18 @@ public:
    * @return           indicates whether this AP is greater than (>0),
    *                   less than (<0), or equal to (0) the given AP
    */
-  int compare(AccessPoint const &ap);
+  int compare(AccessPoint const &ap) const;
+
+  /**
+   * Compares every field of two APs - compare() only orders them by name
+   *
+   * @method  identical
+   *
+   * @param   ap       The other AP
+   *
+   * @return           true if the name, type, MAC and addresses all match
+   */
+  bool identical(AccessPoint const &ap) const;
 
   /**
    * Formats a MAC address to be properly formatted - mutates string given
@@ -103,26 +125,39 @@ public:
   static void MACtoEUI64(std::string &MACtoMutate);
 
   /**
-   * Returns a AccessPoint::Type in string form
+   * Parses a MAC address - 12 hex digits, optionally separated by ':', '-'
+   * or '.'
    *
-   * @method  TypeToString
+   * @method  ParseMAC
    *
-   * @param   Type          Enum to return in string form
+   * @param   text          MAC string to parse
+   * @param   mac           Set to the 48 bit MAC, if it parses
    *
-   * @return                String form of enum given
+   * @return                true if text is a MAC address
    */
-  static std::string TypeToString(AccessPoint::Type Type);
+  static bool ParseMAC(const std::string &text, uint64_t &mac);
 
   /**
-   * Returns a AccessPoint::Type in enum form
+   * Returns a 48 bit MAC in string form (upper case, colon separated)
    *
-   * @method  StringToType
+   * @method  MACToString
    *
-   * @param   type          String type to return in enum form
+   * @param   mac           MAC to format
    *
-   * @return                Enum form of given string
+   * @return                String form of the MAC
    */
-  static AccessPoint::Type StringToType(std::string type);
+  static std::string MACToString(uint64_t mac);
+
+  /**
+   * Returns the EUI64 link local IPv6 address of a 48 bit MAC, in string form
+   *
+   * @method  MACToEUI64String
+   *
+   * @param   mac           MAC to derive the address from
+   *
+   * @return                String form of the address
+   */
+  static std::string MACToEUI64String(uint64_t mac);
 
   /****************************************************************************
    * Getter and setter functions                                              *
@@ -135,9 +170,9 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasMAC()
+  inline bool hasMAC() const
   {
-    return mac_address_ != kNoMAC;
+    return present_ & kHasMAC;
   }
 
   /**
@@ -147,9 +182,9 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasName()
+  inline bool hasName() const
   {
-    return ap_name_ != kNoName;
+    return ap_name_ != nullptr;
   }
 
   /**
@@ -159,7 +194,7 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasType()
+  inline bool hasType() const
   {
     return ap_type_ != Type::none;
   }
@@ -171,9 +206,9 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasIPv4()
+  inline bool hasIPv4() const
   {
-    return ipv4_address_ != kNoIPv4;
+    return present_ & kHasIPv4;
   }
 
   /**
@@ -183,9 +218,9 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasIPv6()
+  inline bool hasIPv6() const
   {
-    return ipv6_address_ != kNoIPv6;
+    return present_ & kHasIPv6;
   }
 
   /**
@@ -195,21 +230,22 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasLinkLocalIPv4()
+  inline bool hasLinkLocalIPv4() const
   {
-    return link_local_ipv4_address_ != kNoIPv4;
+    return present_ & kHasLinkLocalIPv4;
   }
 
   /**
-   * Returns whether the object has a link local IPv6 address
+   * Returns whether the object has a link local IPv6 address - derived from
+   * the MAC, so present whenever the MAC is
    *
    * @method  hasLinkLocalIPv6
    *
    * @return  true if specified, else false
    */
-  inline bool hasLinkLocalIPv6()
+  inline bool hasLinkLocalIPv6() const
   {
-    return link_local_ipv6_address_ != kNoIPv6;
+    return hasMAC();
   }
 
   /**
@@ -219,7 +255,7 @@ public:
    *
    * @return  true if specified, else false
    */
-  inline bool hasAddress()
+  inline bool hasAddress() const
   {
     return hasIPv4() || hasIPv6() || hasLinkLocalIPv4() || hasLinkLocalIPv6();
   }
@@ -231,9 +267,9 @@ public:
    *
    * @return  AP name in string format
    */
-  inline std::string getName()
+  inline const std::string &getName() const
   {
-    return ap_name_;
+    return ap_name_ ? *ap_name_ : kNoName;
   }
 
   /**
@@ -243,7 +279,19 @@ public:
    *
    * @return  MAC address in string format
    */
-  inline std::string getMAC()
+  inline std::string getMAC() const
+  {
+    return hasMAC() ? MACToString(mac_address_) : kNoMAC;
+  }
+
+  /**
+   * Accessor to get the MAC address as an integer
+   *
+   * @method  getMACValue
+   *
+   * @return  48 bit MAC address, 0 if none
+   */
+  inline uint64_t getMACValue() const
   {
     return mac_address_;
   }
@@ -255,10 +303,7 @@ public:
    *
    * @return  the type in string format
    */
-  inline std::string getType()
-  {
-    return TypeToString(ap_type_);
-  }
+  std::string getType() const;
 
   /**
    * Accessor to get the enum type
@@ -267,7 +312,7 @@ public:
    *
    * @return  the type in enum format
    */
-  inline AccessPoint::Type getEnumType()
+  inline AccessPoint::Type getEnumType() const
   {
     return ap_type_;
   }
@@ -279,10 +324,7 @@ public:
    *
    * @return  the IPv4 in string format
    */
-  inline std::string getIPv4()
-  {
-    return ipv4_address_;
-  }
+  std::string getIPv4() const;
 
   /**
    * Accessor to get the IPv6 address for a given AP
@@ -291,10 +333,7 @@ public:
    *
    * @return  the IPv6 in string format
    */
-  inline std::string getIPv6()
-  {
-    return ipv6_address_;
-  }
+  std::string getIPv6() const;
 
   /**
    * Accessor to get the link local IPv4 for a given AP
@@ -303,10 +342,7 @@ public:
    *
    * @return  the link local IPv4 in string format
    */
-  inline std::string getLinkLocalIPv4()
-  {
-    return link_local_ipv4_address_;
-  }
+  std::string getLinkLocalIPv4() const;
 
   /**
    * Accessor to get the link local IPv6 for a given AP
@@ -315,9 +351,20 @@ public:
    *
    * @return  the link local IPv6 in string format
    */
-  inline std::string getLinkLocalIPv6()
+  std::string getLinkLocalIPv6() const;
+
+  /**
+   * Accessors to get the addresses in binary form - only meaningful when
+   * the matching has*() is true
+   */
+  inline const struct in_addr &getIPv4Address() const
   {
-    return link_local_ipv6_address_;
+    return ipv4_address_;
+  }
+
+  inline const struct in6_addr &getIPv6Address() const
+  {
+    return ipv6_address_;
   }
 
   /**
@@ -327,31 +374,29 @@ public:
    *
    * @return  A typedef'd list of vector type containing all AP addresses
    */
-  AddressList getAddresses();
+  AddressList getAddresses() const;
 
   /**
-   * AP mutator to set the IPv4 address by string
+   * AP mutator to set the IPv4 address by string - kNoIPv4 clears it
    *
    * @method  setIPv4
    *
    * @param   address  the string to set as the IPv4 address
+   *
+   * @return           false if address is not an IPv4 address (none is set)
    */
-  inline void setIPv4(std::string address)
-  {
-    ipv4_address_ = address;
-  }
+  bool setIPv4(const std::string &address);
 
   /**
-   * AP mutator to set the IPv6 address by string
+   * AP mutator to set the IPv6 address by string - kNoIPv6 clears it
    *
    * @method  setIPv6
    *
    * @param   address  the string to set as the IPv6 address
+   *
+   * @return           false if address is not an IPv6 address (none is set)
    */
-  inline void setIPv6(std::string address)
-  {
-    ipv6_address_ = address;
-  }
+  bool setIPv6(const std::string &address);
 
   /**
    * AP mutator to set the type by AccessPoint::Type enum
@@ -372,69 +417,85 @@ public:
    *
    * @param   type     string to set as the type
    */
-  inline void setType(std::string type)
-  {
-    setType(StringToType(type));
-  }
+  void setType(const std::string &type);
 
   /**
    * Overloaded == operator to use comparator
    */
-  bool operator == (AccessPoint const &ap)
+  bool operator == (AccessPoint const &ap) const
   {
-    return (bool) !compare(ap);
+    return !compare(ap);
   }
 
   /**
    * Overloaded != operator to use comparator
    */
-  bool operator != (AccessPoint const &ap)
+  bool operator != (AccessPoint const &ap) const
   {
-    return (bool) compare(ap);
+    return compare(ap) != 0;
   }
 
   /**
    * Override < operator to use comparator
    */
-  bool operator < (AccessPoint const &ap)
+  bool operator < (AccessPoint const &ap) const
   {
-    return (bool) compare(ap) < 0;
+    return compare(ap) < 0;
   }
 
   /**
    * Override > operator to use comparator
    */
-  bool operator > (AccessPoint const &ap)
+  bool operator > (AccessPoint const &ap) const
   {
-    return (bool) compare(ap) > 0;
+    return compare(ap) > 0;
   }
 
 private:
   /**
-   * AccessPoint internal enum - AP's type
+   * Bits of present_ - which of the binary fields hold a value
    */
-  Type ap_type_ = Type::none;
+  static const uint8_t kHasMAC           = 0x01;
+  static const uint8_t kHasIPv4          = 0x02;
+  static const uint8_t kHasIPv6          = 0x04;
+  static const uint8_t kHasLinkLocalIPv4 = 0x08;
+
+  /**
+   * Returns the pooled copy of a name - equal names share one string, so
+   * they compare equal by pointer. kNoName is held as nullptr. The name is
+   * freed, and leaves the pool, once no AP holds it.
+   */
+  static std::shared_ptr<const std::string> Intern(const std::string &name);
+
+  void initialize(const std::string &Name, const std::string &MACAddress);
 
   /**
-   * AccessPoint internal string - AP's name
+   * AccessPoint internal pointer - AP's name, in the name pool
    */
-  std::string ap_name_ = kNoName;
+  std::shared_ptr<const std::string> ap_name_;
+
   /**
-   * AccessPoint internal string - AP's MAC address
+   * AccessPoint internal integer - AP's MAC address (48 bits)
    */
-  std::string mac_address_ = kNoMAC;
+  uint64_t mac_address_ = 0;
 
   /**
-   * AccessPoint internal string - AP's IPv4 addresses
+   * AccessPoint internal addresses - AP's IPv6 and IPv4 addresses. The link
+   * local IPv6 address is derived from the MAC when asked for.
    */
-  std::string ipv4_address_            = kNoIPv4;
-  std::string link_local_ipv4_address_ = kNoIPv4;
+  struct in6_addr ipv6_address_            = in6_addr();
+  struct in_addr  ipv4_address_            = in_addr();
+  struct in_addr  link_local_ipv4_address_ = in_addr();
+
+  /**
+   * AccessPoint internal enum - AP's type
+   */
+  Type ap_type_ = Type::none;
 
   /**
-   * AccessPoint internal string - AP's IPv6 addresses
+   * AccessPoint internal bits - which fields above are set
    */
-  std::string ipv6_address_            = kNoIPv6;
-  std::string link_local_ipv6_address_ = kNoIPv6;
+  uint8_t present_ = 0;
 };
 
 /**
@@ -0,0 +1,184 @@
+/******************************************************************************
+ * wrt_checkpoint.hxx                                                         *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT push journal. A push is broken into steps    *
+ * per AP (files transferred, uci values set, uci values committed, wireless  *
+ * restarted) and each completed step is appended to a small on-disk journal, *
+ * so that a push that is killed part way through can be resumed rather than  *
+ * started over.                                                              *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_CHECKPOINT_HXX_
+#define LIBWRT_CHECKPOINT_HXX_
+
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace wrt
+{
+
+class Checkpoint
+{
+public:
+  /**
+   * Enum class of push steps, in the order they are performed on an AP
+   */
+  enum class Step : int
+  {
+    kNone        = 0,
+    kTransferred = 1,
+    kSet         = 2,
+    kCommitted   = 3,
+    kRestarted   = 4,
+  };
+
+  /**
+   * Constructor for Checkpoint - takes the path of the journal file
+   */
+  explicit Checkpoint(std::string path);
+  ~Checkpoint();
+
+  /**
+   * Replays the journal on disk. A journal written for a different
+   * generation (i.e. the local configuration changed since) is discarded.
+   *
+   * @method  load
+   *
+   * @param   generation  Identifies the configuration being pushed
+   */
+  void load(std::string generation);
+
+  /**
+   * Replays the journal on disk, without opening it for writing - the file
+   * is neither created nor truncated, and nothing may be journaled after. A
+   * journal written for a different generation reads as no progress.
+   *
+   * @method  read
+   *
+   * @param   generation  Identifies the configuration being pushed
+   */
+  void read(std::string generation);
+
+  /**
+   * Removes the journal from disk and forgets all progress
+   *
+   * @method  clear
+   */
+  void clear();
+
+  /**
+   * Returns whether the given step has been completed for an AP
+   *
+   * @method  isComplete
+   *
+   * @param   ap          Key of the AP (its MAC address)
+   * @param   step        Step to check
+   *
+   * @return              true if the step (or a later one) is journaled
+   */
+  bool isComplete(const std::string &ap, Step step);
+
+  /**
+   * Journals the completion of a step for an AP
+   *
+   * @method  mark
+   *
+   * @param   ap          Key of the AP (its MAC address)
+   * @param   step        Step completed
+   */
+  void mark(const std::string &ap, Step step);
+
+  /**
+   * Returns whether a file transfer to an AP was started by a prior run
+   *
+   * @method  isStarted
+   *
+   * @param   ap          Key of the AP (its MAC address)
+   * @param   file        Name of the file being transferred
+   *
+   * @return              true if a transfer of file was journaled
+   */
+  bool isStarted(const std::string &ap, const std::string &file);
+
+  /**
+   * Returns whether a file transfer to an AP was completed
+   *
+   * @method  isTransferred
+   *
+   * @param   ap          Key of the AP (its MAC address)
+   * @param   file        Name of the file being transferred
+   *
+   * @return              true if the whole file was journaled as sent
+   */
+  bool isTransferred(const std::string &ap, const std::string &file);
+
+  /**
+   * Journals the offset a file transfer to an AP is (re)started from
+   *
+   * @method  setOffset
+   *
+   * @param   ap          Key of the AP (its MAC address)
+   * @param   file        Name of the file being transferred
+   * @param   offset      Byte offset the transfer starts at
+   */
+  void setOffset(const std::string &ap, const std::string &file, off_t offset);
+
+  /**
+   * Journals the completion of a file transfer to an AP
+   *
+   * @method  markTransferred
+   *
+   * @param   ap          Key of the AP (its MAC address)
+   * @param   file        Name of the file transferred
+   */
+  void markTransferred(const std::string &ap, const std::string &file);
+
+  /**
+   * Returns a Checkpoint::Step in string form
+   *
+   * @method  StepToString
+   *
+   * @param   step        Enum to return in string form
+   *
+   * @return              String form of enum given
+   */
+  static std::string StepToString(Step step);
+
+private:
+  /**
+   * Offset journaled for a file which has been completely transferred
+   */
+  static const off_t kTransferComplete = -1;
+
+  /**
+   * Progress of a single AP
+   */
+  struct Progress
+  {
+    Step step = Step::kNone;
+    std::unordered_map<std::string, off_t> files;
+  };
+
+  void append(const std::string &record);
+  void replay(const std::string &record);
+  bool scan(std::string::size_type &complete, std::string::size_type &size);
+
+  std::string path_;
+  std::string generation_;
+  int         journal_ = -1;
+
+  std::unordered_map<std::string, Progress> progress_;
+
+  /* No copy constructor, no = operator */
+  Checkpoint(const Checkpoint &);
+  Checkpoint &operator = (const Checkpoint &);
+};
+
+}
+
+#endif
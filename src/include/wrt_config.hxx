@@ -0,0 +1,137 @@
+/******************************************************************************
+ * wrt_config.hxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT configuration store - the one way wrt.cfg    *
+ * is written. Changes are queued as mutations and applied to the settings in *
+ * memory; flush() then writes them all at once:                              *
+ *                                                                            *
+ *   x. under an advisory lock, so the daemon and operators take turns,       *
+ *   x. to a file beside wrt.cfg, synced and renamed over it, so a kill can   *
+ *      never leave a truncated inventory, and                                *
+ *   x. on top of whatever is on disk - if another process wrote wrt.cfg      *
+ *      since it was read, it is re-read and the queued mutations replayed,   *
+ *      so neither writer loses the other's changes.                          *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_CONFIG_HXX_
+#define LIBWRT_CONFIG_HXX_
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <libconfig.h++>
+
+namespace wrt
+{
+
+class ConfigStore
+{
+public:
+  /**
+   * A change to the configuration - it must give the same result however
+   * often it is applied, as it may be replayed on a newer file
+   */
+  typedef std::function<void (libconfig::Config &)> Mutation;
+
+  /**
+   * Constructor for ConfigStore - takes the path of the configuration file
+   * and the settings it is read into
+   */
+  ConfigStore(std::string path, libconfig::Config &config);
+
+  /**
+   * Reads the configuration file into the settings. A top level setting may
+   * be left out - it is not even parsed. Settings read without it are read
+   * again in full before they are written.
+   *
+   * @method  read
+   *
+   * @param   skip        Name of the setting to leave out, if any
+   *
+   * @return  The settings read
+   */
+  libconfig::Config &read(const std::string &skip = "");
+
+  /**
+   * Applies a change to the settings, and queues it to be written
+   *
+   * @method  mutate
+   *
+   * @param   mutation    Change to apply
+   */
+  void mutate(Mutation mutation);
+
+  /**
+   * Writes every queued change in a single, atomic write
+   *
+   * @method  flush
+   *
+   * @return  true if the file was written, false if nothing was queued
+   */
+  bool flush();
+
+  /**
+   * Returns the number of changes waiting to be written
+   *
+   * @method  pending
+   *
+   * @return  Queued mutations
+   */
+  size_t pending();
+
+  /**
+   * Returns whether the settings were read with a setting left out
+   *
+   * @method  partial
+   *
+   * @return  true if read() skipped a setting
+   */
+  bool partial();
+
+private:
+  /**
+   * Identity of the file as last read or written, to notice other writers
+   */
+  struct Stamp
+  {
+    dev_t  device   = 0;
+    ino_t  inode    = 0;
+    off_t  size     = -1;
+    time_t modified = 0;
+
+    bool operator == (const Stamp &other) const;
+  };
+
+  static Stamp StampOf(const std::string &path);
+  static void Cut(std::string &text, const std::string &name);
+
+  int  lock(int operation);
+  void unlock(int file);
+  void load(const std::string &skip = "");
+
+  std::string path_;
+  std::string lock_path_;
+
+  libconfig::Config &config_;
+
+  std::vector<Mutation> pending_;
+  std::mutex            mutex_;
+  Stamp                 stamp_;
+  bool                  partial_ = false;
+
+  /* No copy constructor, no = operator */
+  ConfigStore(const ConfigStore &);
+  ConfigStore &operator = (const ConfigStore &);
+};
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+/******************************************************************************
+ * wrt_credentials.hxx                                                        *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT credential manager. The identity keys are    *
+ * read and parsed once, before the first session, and every session is       *
+ * authenticated with the keys already in memory. The key each AP accepted is *
+ * remembered (and kept on disk), so later connections offer that key first - *
+ * and ssh, run by a push, is given just that key, with no key parsed here.   *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_CREDENTIALS_HXX_
+#define LIBWRT_CREDENTIALS_HXX_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ssh_session.hxx>
+#include <ssh_keys.hxx>
+
+namespace wrt
+{
+
+/**
+ * Identity files loaded by default, in the order they are offered
+ */
+const std::vector<std::string> kDefaultIdentities = {
+  "id_ecdsa",
+  "id_rsa",
+  "id_dsa",
+};
+
+class Credentials
+{
+public:
+  /**
+   * Constructor for Credentials - takes the directory holding the identity
+   * files, and the file the key each AP accepted is remembered in
+   */
+  Credentials(std::string directory, std::string accepted);
+
+  /**
+   * Reads every identity file present in the directory, and the keys APs
+   * accepted before. Identities which cannot be read are skipped.
+   *
+   * @method  load
+   *
+   * @param   identities  Identity file names, in the order to offer them
+   *
+   * @return              Number of identities loaded
+   */
+  size_t load(const std::vector<std::string> &identities = kDefaultIdentities);
+
+  /**
+   * Reads only the keys APs accepted before - all getIdentityFile() needs.
+   * No identity is parsed, so authenticate() offers none until load().
+   *
+   * @method  loadAccepted
+   */
+  void loadAccepted();
+
+  /**
+   * Authenticates a connected session, offering the key the AP accepted last
+   * time first, and then every other key in order
+   *
+   * @method  authenticate
+   *
+   * @param   session     Connected session
+   * @param   ap          AP the session is connected to (its MAC)
+   *
+   * @return              true if a key was accepted
+   */
+  bool authenticate(ssh::Session &session, const std::string &ap);
+
+  /**
+   * Returns the identity file an AP accepted, for connections made by the
+   * ssh binary rather than the library
+   *
+   * @method  getIdentityFile
+   *
+   * @param   ap          AP to look up (its MAC)
+   *
+   * @return              Path of the identity, empty if none is known
+   */
+  std::string getIdentityFile(const std::string &ap);
+
+  /**
+   * Returns the identity files present in the directory, without reading
+   * them - for ssh, which is tried with one at a time
+   *
+   * @method  available
+   *
+   * @param   identities  Identity file names, in the order to offer them
+   *
+   * @return              Paths of the identities present, in that order
+   */
+  std::vector<std::string> available(
+    const std::vector<std::string> &identities = kDefaultIdentities) const;
+
+  /**
+   * Remembers the identity an AP accepted a connection made by ssh with
+   * (written out by write)
+   *
+   * @method  accept
+   *
+   * @param   ap          AP which accepted the identity (its MAC)
+   * @param   identity    Path of the identity, as returned by available()
+   */
+  void accept(const std::string &ap, const std::string &identity);
+
+  /**
+   * Writes the keys APs accepted back to disk, if any changed
+   *
+   * @method  write
+   */
+  void write();
+
+  /**
+   * Returns the number of identities loaded
+   *
+   * @method  size
+   *
+   * @return  Identities held in memory
+   */
+  inline size_t size() const
+  {
+    return keys_.size();
+  }
+
+private:
+  std::string directory_;
+  std::string accepted_path_;
+
+  std::vector<std::unique_ptr<ssh::PrivateKey> > keys_;
+  std::vector<std::string> names_;
+
+  /**
+   * Identity (by name) each AP accepted
+   */
+  std::unordered_map<std::string, std::string> accepted_;
+
+  std::mutex lock_;
+  bool dirty_ = false;
+
+  /* No copy constructor, no = operator */
+  Credentials(const Credentials &);
+  Credentials &operator = (const Credentials &);
+};
+
+}
+
+#endif
@@ -0,0 +1,190 @@
+/******************************************************************************
+ * wrt_crypto.hxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes WRT SSH crypto profiles. A profile is the cipher,    *
+ * key exchange and MAC preference used to talk to one type of AP - the slow  *
+ * MIPS boards spend most of a push in the handshake, so they get algorithms  *
+ * that are cheap for them. The benchmark measures each candidate on a live   *
+ * AP, so a profile can be chosen by measurement rather than by guesswork.    *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_CRYPTO_HXX_
+#define LIBWRT_CRYPTO_HXX_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <wrt_ap.hxx>
+
+namespace ssh
+{
+class Session;
+}
+
+namespace wrt
+{
+
+/**
+ * Key exchange and cipher candidates the benchmark tries, in order of
+ * preference. Ciphers are only those a stock OpenSSH client still accepts
+ * (no CBC modes, no blowfish) - the winner is handed to ssh -c on push. A
+ * candidate the AP (or libssh) lacks merely fails its round.
+ */
+const std::vector<std::string> kKexCandidates = {
+  "curve25519-sha256@libssh.org",
+  "ecdh-sha2-nistp256",
+  "diffie-hellman-group14-sha1",
+};
+
+const std::vector<std::string> kCipherCandidates = {
+  "chacha20-poly1305@openssh.com",
+  "aes128-gcm@openssh.com",
+  "aes256-gcm@openssh.com",
+  "aes128-ctr",
+  "aes192-ctr",
+  "aes256-ctr",
+};
+
+/**
+ * SSH algorithm preferences for a type of AP. Each is a comma separated list,
+ * in order of preference, and empty means the ssh_config default.
+ *
+ * ciphers - Ciphers (both directions)
+ * kex     - Key exchange methods
+ * macs    - Message authentication codes (both directions)
+ */
+struct CryptoProfile
+{
+  std::string ciphers;
+  std::string kex;
+  std::string macs;
+
+  /**
+   * Returns whether the profile leaves everything to ssh_config
+   */
+  inline bool empty() const
+  {
+    return ciphers.empty() && kex.empty() && macs.empty();
+  }
+
+  /**
+   * Returns the built in profile for a type of AP, from the type registry
+   *
+   * @method  Default
+   *
+   * @param   type        AP type
+   *
+   * @return              Profile for the type (empty if none is known)
+   */
+  static CryptoProfile Default(AccessPoint::Type type);
+
+  /**
+   * Applies the profile to a session, before it connects
+   *
+   * @method  apply
+   *
+   * @param   session     Session to set the algorithm options of
+   */
+  void apply(ssh::Session &session) const;
+
+  /**
+   * Returns the profile as arguments to the ssh binary
+   *
+   * @method  getSSHArguments
+   *
+   * @return  Arguments, e.g. { "-c", "aes128-ctr", ... }
+   */
+  std::vector<std::string> getSSHArguments() const;
+};
+
+class CryptoBenchmark
+{
+public:
+  /**
+   * Connects (and authenticates) a session to the AP being measured, using
+   * the profile given
+   */
+  typedef std::function<void (ssh::Session &, const CryptoProfile &)>
+  Connector;
+
+  /**
+   * Default bytes streamed to measure bulk throughput
+   */
+  static const size_t kDefaultBytes = 1 << 20;
+
+  /**
+   * Default number of times each candidate is measured (the best is kept)
+   */
+  static const int kDefaultRounds = 3;
+
+  /**
+   * Measurement of a single profile
+   *
+   * profile    - Profile measured
+   * handshake  - Seconds to connect and authenticate, -1 if it failed
+   * throughput - Bytes per second streamed, -1 if not measured
+   */
+  struct Result
+  {
+    CryptoProfile profile;
+    double handshake  = -1;
+    double throughput = -1;
+
+    inline bool ok() const
+    {
+      return handshake >= 0;
+    }
+  };
+
+  explicit CryptoBenchmark(Connector connect);
+
+  inline void setBytes(size_t bytes)
+  {
+    bytes_ = bytes;
+  }
+
+  inline void setRounds(int rounds)
+  {
+    rounds_ = rounds > 0 ? rounds : 1;
+  }
+
+  /**
+   * Measures a single profile
+   *
+   * @method  measure
+   *
+   * @param   profile     Profile to measure
+   * @param   bulk        Also measure bulk throughput
+   *
+   * @return              Fastest of the rounds measured
+   */
+  Result measure(const CryptoProfile &profile, bool bulk);
+
+  /**
+   * Finds the fastest profile: each key exchange is timed first (it decides
+   * the handshake), then each cipher is streamed through the fastest one
+   *
+   * @method  run
+   *
+   * @param   base        Profile to vary (and to fall back on)
+   * @param   results     If given, filled with every measurement
+   *
+   * @return              Fastest profile which worked
+   */
+  CryptoProfile run(const CryptoProfile &base,
+                    std::vector<Result> *results = nullptr);
+
+private:
+  Connector connect_;
+
+  size_t bytes_  = kDefaultBytes;
+  int    rounds_ = kDefaultRounds;
+};
+
+}
+
+#endif
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * wrt_file.hxx                                                               *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes how WRT replaces the files it keeps - known_hosts,   *
+ * accepted keys, the config file, inventory images and metrics. A file is    *
+ * written in full beside its destination, synced, and renamed over it, so a  *
+ * reader (or a crash) sees the old file or the new one, never part of        *
+ * either.                                                                    *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_FILE_HXX_
+#define LIBWRT_FILE_HXX_
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <string>
+
+namespace wrt
+{
+
+namespace file
+{
+
+/**
+ * Replaces a file with the given contents, at once (std::runtime_error if
+ * it cannot). A file being replaced keeps its mode; a new one is created
+ * with the mode given.
+ *
+ * @method  Replace
+ *
+ * @param   path        File to replace
+ * @param   data        Its new contents
+ * @param   length      Bytes in data
+ * @param   mode        Mode of the file, if it does not exist yet
+ * @param   suffix      Appended to path to name the file written first -
+ *                      unique per writer, if several may replace path
+ *                      at once
+ */
+void Replace(const std::string &path, const char *data, size_t length,
+             mode_t mode, const std::string &suffix = ".tmp");
+
+inline void Replace(const std::string &path, const std::string &data,
+                    mode_t mode, const std::string &suffix = ".tmp")
+{
+  Replace(path, data.data(), data.size(), mode, suffix);
+}
+
+}
+
+}
+
+#endif
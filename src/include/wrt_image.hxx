@@ -0,0 +1,226 @@
+/******************************************************************************
+ * wrt_image.hxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT inventory image - a compiled, binary copy of *
+ * the APs in wrt.cfg. The image is fixed size records, a hash of the names   *
+ * and a table of strings, mapped into memory as it is: reading it costs the  *
+ * same for 10 APs as for 10,000, where parsing wrt.cfg does not.             *
+ *                                                                            *
+ * An image records which files it was compiled from (wrt.cfg, and any        *
+ * inventory shards), and is only used while none of them has changed - the   *
+ * first run to read a changed inventory compiles a new one.                  *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_IMAGE_HXX_
+#define LIBWRT_IMAGE_HXX_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <wrt_ap.hxx>
+
+namespace wrt
+{
+
+class InventoryImage
+{
+public:
+  /**
+   * Identity of the file an image was compiled from
+   */
+  struct Stamp
+  {
+    uint64_t device   = 0;
+    uint64_t inode    = 0;
+    int64_t  size     = -1;
+    int64_t  modified = 0;
+    int64_t  nanos    = 0;
+
+    bool operator == (const Stamp &other) const;
+
+    /**
+     * Folds the identity of another file into this one
+     *
+     * @method  fold
+     *
+     * @param   other       Identity to fold in
+     *
+     * @return              This identity
+     */
+    Stamp &fold(const Stamp &other);
+
+    /**
+     * Returns the identity of a file (size -1 if it does not exist)
+     *
+     * @method  Of
+     *
+     * @param   path        File to identify
+     *
+     * @return              Its identity
+     */
+    static Stamp Of(const std::string &path);
+
+    /**
+     * Returns the identity of a set of files, folded in order
+     *
+     * @method  Of
+     *
+     * @param   paths       Files to identify
+     *
+     * @return              Their identity
+     */
+    static Stamp Of(const std::vector<std::string> &paths);
+  };
+
+  /**
+   * Where each AP was read from, by name - APs missing are in wrt.cfg
+   */
+  typedef std::unordered_map<std::string, std::string> Origins;
+
+  /**
+   * A single AP, as it lies in the image - the strings point into the
+   * mapping, and are only valid while the image is open
+   */
+  struct View
+  {
+    const char *name;
+    const char *type;
+    const char *mac;
+    const char *ipv4;
+    const char *ipv6;
+    const char *origin;   //File the AP was read from ("" - wrt.cfg)
+
+    /**
+     * Returns the AP as an AccessPoint
+     *
+     * @method  toAccessPoint
+     *
+     * @return  AP the view describes
+     */
+    AccessPoint toAccessPoint() const;
+  };
+
+  /**
+   * Constructor for InventoryImage - takes the path of the image
+   */
+  explicit InventoryImage(std::string path);
+  ~InventoryImage();
+
+  /**
+   * Maps the image, if the files it was compiled from are unchanged
+   *
+   * @method  open
+   *
+   * @return              true if the image is mapped, and current
+   */
+  bool open();
+
+  /**
+   * Maps the image, if it was compiled from files with the identity given
+   *
+   * @method  open
+   *
+   * @param   source      Identity the image must have been compiled from
+   *
+   * @return              true if the image is mapped, and current
+   */
+  bool open(const Stamp &source);
+
+  /**
+   * Unmaps the image
+   *
+   * @method  close
+   */
+  void close();
+
+  /**
+   * Returns whether an image is mapped
+   *
+   * @method  isOpen
+   *
+   * @return  true if mapped
+   */
+  inline bool isOpen() const
+  {
+    return header_ != nullptr;
+  }
+
+  /**
+   * Returns the number of APs in the image
+   *
+   * @method  size
+   *
+   * @return  APs in the image, 0 if none is mapped
+   */
+  size_t size() const;
+
+  /**
+   * Returns an AP by its position in the image
+   *
+   * @method  get
+   *
+   * @param   index       Position, less than size()
+   *
+   * @return              View of the AP
+   */
+  View get(size_t index) const;
+
+  /**
+   * Finds an AP by name, without reading any other
+   *
+   * @method  find
+   *
+   * @param   name        Name of the AP
+   * @param   view        Set to the AP, if it is found
+   *
+   * @return              true if found
+   */
+  bool find(const std::string &name, View &view) const;
+
+  /**
+   * Compiles an image of a list of APs, atomically replacing any image
+   *
+   * @method  Write
+   *
+   * @param   path        Path of the image
+   * @param   sources     Files the APs were read from
+   * @param   source      Identity of those files, as they were read
+   * @param   APs         APs to compile
+   * @param   origins     File each AP was read from
+   */
+  static void Write(const std::string &path,
+                    const std::vector<std::string> &sources,
+                    const Stamp &source,
+                    APList &APs,
+                    const Origins &origins = Origins());
+
+private:
+  struct Header;
+  struct Record;
+
+  static uint32_t Hash(const char *name, size_t length);
+
+  bool map(const Stamp *source);
+
+  std::string path_;
+
+  void           *map_     = nullptr;
+  size_t          length_  = 0;
+  const Header   *header_  = nullptr;
+  const Record   *records_ = nullptr;
+  const uint32_t *buckets_ = nullptr;
+  const char     *strings_ = nullptr;
+
+  /* No copy constructor, no = operator */
+  InventoryImage(const InventoryImage &);
+  InventoryImage &operator = (const InventoryImage &);
+};
+
+}
+
+#endif
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * wrt_inventory.hxx                                                          *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT inventory - the managed APs, indexed by      *
+ * name, MAC and address. Additions and removals are collected in a batch,    *
+ * checked against the inventory (and each other) as a whole, and then        *
+ * applied at once - so a command touching N APs costs N index lookups, and  *
+ * its result is persisted a single time.                                     *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_INVENTORY_HXX_
+#define LIBWRT_INVENTORY_HXX_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <wrt_ap.hxx>
+
+namespace wrt
+{
+
+class Inventory
+{
+public:
+  /**
+   * A set of changes to the inventory, applied all together or not at all
+   */
+  class Batch
+  {
+  public:
+    /**
+     * Queues an AP to be added
+     *
+     * @method  add
+     *
+     * @param   AP          AP to add
+     */
+    void add(AccessPoint AP);
+
+    /**
+     * Queues an AP to be removed
+     *
+     * @method  remove
+     *
+     * @param   key         Name, MAC or address of the AP
+     */
+    void remove(std::string key);
+
+    /**
+     * Returns whether nothing is queued
+     *
+     * @method  empty
+     *
+     * @return  true if the batch changes nothing
+     */
+    inline bool empty() const
+    {
+      return added_.empty() && removed_.empty();
+    }
+
+    /**
+     * Returns the APs queued to be added
+     */
+    inline const std::vector<AccessPoint> &getAdded() const
+    {
+      return added_;
+    }
+
+    /**
+     * Returns the keys of the APs queued to be removed
+     */
+    inline const std::vector<std::string> &getRemoved() const
+    {
+      return removed_;
+    }
+
+  private:
+    friend class Inventory;
+
+    std::vector<AccessPoint> added_;
+    std::vector<std::string> removed_;
+  };
+
+  /**
+   * Adds an AP as it is loaded from the configuration
+   *
+   * @method  insert
+   *
+   * @param   AP          AP to add
+   *
+   * @return              false if its name, MAC or an address is taken
+   */
+  bool insert(AccessPoint AP);
+
+  /**
+   * Finds a managed AP
+   *
+   * @method  find
+   *
+   * @param   key         Name, MAC or address of the AP
+   *
+   * @return              The AP, or nullptr if none matches
+   */
+  AccessPoint *find(const std::string &key);
+
+  /**
+   * Checks a batch against the inventory, and against itself
+   *
+   * @method  validate
+   *
+   * @param   batch       Changes to check
+   *
+   * @return              A description of each conflict (empty if none)
+   */
+  std::vector<std::string> validate(const Batch &batch) const;
+
+  /**
+   * Applies a batch - removals first, then additions. Nothing is applied
+   * unless the whole batch is valid.
+   *
+   * @method  apply
+   *
+   * @param   batch       Changes to apply
+   *
+   * @return              A description of each conflict (empty if applied)
+   */
+  std::vector<std::string> apply(const Batch &batch);
+
+  /**
+   * Returns the batch which turns this inventory into another: APs only in
+   * the other are added, APs only in this one removed, and APs which differ
+   * replaced. APs the two agree on are not touched, so anything held on to
+   * them stays valid.
+   *
+   * @method  diff
+   *
+   * @param   other       Inventory to become
+   *
+   * @return              The changes
+   */
+  Batch diff(const Inventory &other) const;
+
+  /**
+   * Returns the managed APs, by name
+   *
+   * @method  getAPList
+   *
+   * @return  Every AP in the inventory
+   */
+  inline APList &getAPList()
+  {
+    return aps_;
+  }
+
+  /**
+   * Returns the number of managed APs
+   *
+   * @method  size
+   *
+   * @return  Number of APs in the inventory
+   */
+  inline size_t size() const
+  {
+    return aps_.size();
+  }
+
+  /**
+   * Returns a count of the changes made to the inventory - anything built
+   * from its APs (or holding pointers to them) is stale once it moves on
+   *
+   * @method  getRevision
+   *
+   * @return  Changes made so far
+   */
+  inline uint64_t getRevision() const
+  {
+    return revision_;
+  }
+
+  /**
+   * Returns the form a MAC is indexed under (upper case, colon separated)
+   *
+   * @method  MACKey
+   *
+   * @param   mac         MAC address
+   *
+   * @return              The MAC as indexed
+   */
+  static std::string MACKey(std::string mac);
+
+private:
+  std::string resolve(const std::string &key) const;
+  void index(AccessPoint &AP);
+  void unindex(AccessPoint &AP);
+
+  APList aps_;
+  uint64_t revision_ = 0;
+
+  /**
+   * Indexes from MAC (as an integer), and from each address, to the AP's name
+   */
+  std::unordered_map<uint64_t, std::string>    macs_;
+  std::unordered_map<std::string, std::string> addresses_;
+};
+
+}
+
+#endif
@@ -17,10 +17,25 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <iostream>
 #include <streambuf>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+/**
+ * Most verbose output compiled in (an Output::Verbosity, as an int). Output
+ * written through a level tag above it is compiled out - set it with
+ * ./configure --with-max-verbosity=N for a release build.
+ */
+#ifndef WRT_MAX_VERBOSITY
+#define WRT_MAX_VERBOSITY 7
+#endif
 
 namespace wrt {
 
@@ -41,96 +56,495 @@ public:
   };
 
   static std::string EnumToString(Verbosity v);
+
+  /**
+   * Returns whether output of a verbosity is written at the current level
+   *
+   * @method  Emits
+   *
+   * @param   v           Verbosity of the output
+   *
+   * @return              true if it is written
+   */
+  static inline bool Emits(Verbosity v);
+
+  /**
+   * Returns whether output of a verbosity is compiled in at all
+   *
+   * @method  Compiled
+   *
+   * @param   v           Verbosity of the output
+   *
+   * @return              true unless v is above WRT_MAX_VERBOSITY
+   */
+  static constexpr bool Compiled(Verbosity v)
+  {
+    return static_cast<int>(v) <= WRT_MAX_VERBOSITY;
+  }
+
+  /**
+   * A verbosity as a type - see the level tags below
+   */
+  template <Verbosity V>
+  struct Level
+  {
+  };
+
+  /**
+   * Stands in for a stream after a level tag that is compiled out - every
+   * operator<< on it is empty, and inlined away
+   */
+  struct Discard
+  {
+    template <typename T>
+    inline const Discard &operator<< (const T &) const
+    {
+      return *this;
+    }
+
+    inline const Discard &operator<< (std::ostream &(*)(std::ostream &)) const
+    {
+      return *this;
+    }
+  };
 };
 
-class Syslog : public std::basic_streambuf<char, std::char_traits<char>> {
+extern Output::Verbosity OutputLevel;
+extern Output::Verbosity LogLevel;
+
+inline bool Output::Emits(Verbosity v)
+{
+  return static_cast<int>(OutputLevel) >= static_cast<int>(v);
+}
+
+/**
+ * Buffers output for stdout. Characters go straight into the put area, and
+ * are written - in one fwrite() - when it fills, or the stream is flushed.
+ * The verbosity is checked once, as it is set: output of a verbosity which
+ * is not written leaves the stream bad until the next verbosity, so the
+ * operator<< between them format nothing at all.
+ */
+class VerbosityBuffer : public std::streambuf {
 public:
-  enum class LogLevel : int {
-      kSyslogPanic       = LOG_EMERG,
-      kSyslogAlert       = LOG_ALERT,
-      kSyslogCritical    = LOG_CRIT,
-      kSyslogError       = LOG_ERR,
-      kSyslogWarning     = LOG_WARNING,
-      kSyslogNotice      = LOG_NOTICE,
-      kSyslogInfo        = LOG_INFO,
-      kSyslogDebug       = LOG_DEBUG,
-  };
+  static const size_t kBufferSize = 4096;
 
-  explicit Syslog(std::string ident, int facility);
+  explicit VerbosityBuffer(Output::Verbosity v = Output::Verbosity::kDefault);
+  virtual ~VerbosityBuffer();
 
 protected:
-  int sync();
-  int overflow(int c);
+  virtual int overflow(int c = EOF);
+  virtual int sync();
+
+  /**
+   * Returns whether output of a verbosity is written (at OutputLevel)
+   */
+  virtual bool emits(Output::Verbosity v) const;
+
+  /**
+   * Writes what the put area held (to stdout)
+   */
+  virtual bool emit(const char *data, size_t length);
 
 private:
+  bool drain();
+
+  Output::Verbosity buffer_verbosity_;
+  char              buffer_[kBufferSize];
+
   friend std::ostream& operator<< (std::ostream& os,
-    const Syslog::LogLevel& l);
+    const Output::Verbosity& v);
+};
+
+/**
+ * Output stream of a verbosity filtered buffer. Each is meant to be declared
+ * thread_local, so that every thread fills its own buffer and keeps its own
+ * verbosity - lines from parallel workers are written whole, and without a
+ * lock between them.
+ */
+class WRTout : public std::ostream {
+public:
+  WRTout() : std::ostream(new VerbosityBuffer()), std::ios(0) {}
+  ~WRTout() { delete rdbuf(); }
 
-  LogLevel    syslog_priority_;
-  int         syslog_facility_;
-  char        syslog_ident_[50];
-  std::string buffer_;
 };
 
-extern Output::Verbosity OutputLevel;
+/**
+ * A fixed ring of log records, for many producers and one consumer. A
+ * producer claims a slot with a compare and swap - no lock, no allocation -
+ * and should the ring be full, its record is dropped (and counted) rather
+ * than waited on.
+ */
+class LogRing {
+public:
+  static const size_t kRecordSize = 512;
+
+  struct Record {
+    std::atomic<size_t> sequence;
+    time_t              time;
+    int                 tag;
+    size_t              length;
+    char                text[kRecordSize];
+  };
 
-class FileLog : public std::streambuf {
+  /**
+   * Constructor for LogRing - records is rounded up to a power of two
+   */
+  explicit LogRing(size_t records);
 
-};
+  /**
+   * Queues a record - never blocks. Records longer than kRecordSize take
+   * as many slots as they need, one after another, and are queued whole or
+   * not at all.
+   *
+   * @method  push
+   *
+   * @param   data        Text of the record
+   * @param   length      Its length
+   * @param   tag         Whatever the consumer is to know of it
+   *
+   * @return              false if it was dropped, the ring full
+   */
+  bool push(const char *data, size_t length, int tag = 0);
+
+  /**
+   * Returns the oldest record queued - the consumer's alone to call
+   *
+   * @method  front
+   *
+   * @return  The record, nullptr if none is queued
+   */
+  const Record *front();
+
+  /**
+   * Frees the slot of the record front() returned
+   *
+   * @method  pop
+   */
+  void pop();
+
+  /**
+   * Returns the number of records dropped for want of room
+   *
+   * @method  getDropped
+   *
+   * @return  Records dropped so far
+   */
+  inline uint64_t getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
 
-class VerbosityBuffer : public std::streambuf {
 private:
-  Output::Verbosity buffer_verbosity_;
-  std::string buffer_;
-  
+  std::unique_ptr<Record[]> records_;
+  size_t                    mask_;
+  std::atomic<size_t>       head_;
+  size_t                    tail_ = 0;
+  std::atomic<uint64_t>     dropped_;
+
+  /* No copy constructor, no = operator */
+  LogRing(const LogRing &);
+  LogRing &operator = (const LogRing &);
+};
+
+/**
+ * The log file's writer. Producers queue records on a LogRing, and never
+ * wait on the disk. A thread of the sink's own takes the records out in
+ * order, and writes each batch of them with one write(2), rotating the file
+ * once it grows past a size, or an interval passes.
+ */
+class LogSink {
 public:
-  explicit VerbosityBuffer(Output::Verbosity v = Output::Verbosity::kDefault) {
-    buffer_verbosity_ = v;
+  static const size_t   kDefaultRecords = 4096;
+  static const unsigned kPollInterval   = 50;  //milliseconds
+
+  /**
+   * When the file is rotated - to path.1, path.2 ... path.keep
+   */
+  struct Rotation {
+    Rotation() : max_size(4 * 1024 * 1024), interval(24 * 60 * 60), keep(5) {}
+
+    size_t   max_size;  //bytes, 0 - never
+    time_t   interval;  //seconds, 0 - never
+    unsigned keep;
+  };
+
+  /**
+   * Constructor for LogSink - opens (appends to) the file, and starts the
+   * writer. records is rounded up to a power of two.
+   */
+  LogSink(std::string path, Rotation rotation = Rotation(),
+          size_t records = kDefaultRecords);
+
+  /**
+   * Destructor for LogSink - writes out every record, and stops the writer
+   */
+  ~LogSink();
+
+  /**
+   * Queues a record - never blocks (see LogRing::push)
+   *
+   * @method  push
+   *
+   * @param   data        Text of the record
+   * @param   length      Its length
+   *
+   * @return              false if it was dropped, the ring full
+   */
+  inline bool push(const char *data, size_t length) {
+    return ring_.push(data, length);
   }
-  
-  virtual ~VerbosityBuffer() {
-    sync();
+
+  inline uint64_t getDropped() const {
+    return ring_.getDropped();
   }
 
+private:
+  void run();
+  bool collect(std::string &batch);
+  void write(const std::string &batch);
+  void open();
+  void rotate();
+  time_t age(time_t changed);
+
+  std::string path_;
+  Rotation    rotation_;
+
+  LogRing           ring_;
+  std::atomic<bool> running_;
+  std::thread       writer_;
+
+  int    fd_      = -1;
+  size_t written_ = 0;
+  time_t started_ = 0;  //When the file's first record was written
+
+  /* No copy constructor, no = operator */
+  LogSink(const LogSink &);
+  LogSink &operator = (const LogSink &);
+};
+
+/**
+ * Buffers output for the log file. Lines are filtered by LogLevel rather
+ * than OutputLevel, and each is pushed to the open sink as a record when
+ * the stream is flushed - they are lost if none is open.
+ */
+class FileLog : public VerbosityBuffer {
+public:
+  FileLog() = default;
+  virtual ~FileLog();
+
+  /**
+   * Opens the sink every FileLog writes to, closing any open before
+   *
+   * @method  Open
+   *
+   * @param   path        Log file
+   * @param   rotation    When to rotate it
+   */
+  static void Open(std::string path,
+                   LogSink::Rotation rotation = LogSink::Rotation());
+
+  /**
+   * Closes the sink, once every record queued is written
+   *
+   * @method  Close
+   */
+  static void Close();
+
 protected:
-  virtual int overflow(int c = EOF) {
-    if (c != EOF) {
-      buffer_ += static_cast<char>(c);
-    }
+  virtual bool emits(Output::Verbosity v) const;
+  virtual bool emit(const char *data, size_t length);
 
-    return c;
-  }
+private:
+  static std::atomic<LogSink *> sink_;
+};
 
-  virtual int sync() {
+class WRTlog : public std::ostream {
+public:
+  WRTlog() : std::ios(0), std::ostream(new FileLog()) {}
+  ~WRTlog() { delete rdbuf(); }
 
-    std::cout << std::flush;
-    
-    if (this->buffer_.length()) {
-      if (OutputLevel >= this->buffer_verbosity_) {
-        fputs(this->buffer_.c_str(), stdout);
-      }
-      
-      this->buffer_.erase();
-    }
+};
 
-    return 0;
+/**
+ * syslog's writer. Messages are queued on a LogRing, and passed to syslog()
+ * by a thread of the sink's own - so a slow syslogd holds up no one. That
+ * thread also keeps a burst from flooding syslogd: within each window, only
+ * the first kBurst of each kind of message (the same text but for numbers
+ * and quoted names - "push \"ap7\": set" is like "push \"ap9\": set") are
+ * passed on, and no more than kRate messages all told. Once the window is
+ * over, each kind held back is summed up as "N similar messages suppressed".
+ */
+class SyslogSink {
+public:
+  static const size_t   kDefaultRecords = 1024;
+  static const unsigned kPollInterval   = 50;  //milliseconds
+  static const unsigned kWindow         = 10;  //seconds
+  static const unsigned kBurst          = 5;
+  static const unsigned kRate           = 100;
+
+  /**
+   * Constructor for SyslogSink - opens syslog, and starts the writer
+   */
+  SyslogSink(std::string ident, int facility,
+             size_t records = kDefaultRecords);
+
+  /**
+   * Destructor for SyslogSink - passes on every message queued, sums up
+   * those held back, and closes syslog
+   */
+  ~SyslogSink();
+
+  /**
+   * Queues a message - never blocks. It is cut to LogRing::kRecordSize.
+   *
+   * @method  push
+   *
+   * @param   priority    syslog priority
+   * @param   data        Text of the message
+   * @param   length      Its length
+   *
+   * @return              false if it was dropped, the ring full
+   */
+  bool push(int priority, const char *data, size_t length);
+
+  inline uint64_t getDropped() const {
+    return ring_.getDropped();
   }
 
+  /**
+   * Returns the kind of a message - its text, numbers and quoted strings
+   * blanked out
+   *
+   * @method  Shape
+   *
+   * @param   data        Text of the message
+   * @param   length      Its length
+   *
+   * @return              The kind
+   */
+  static std::string Shape(const char *data, size_t length);
+
+private:
+  struct Similar {
+    int         priority   = 0;
+    unsigned    passed     = 0;
+    unsigned    suppressed = 0;
+    std::string last;
+  };
+
+  void run();
+  void forward(const LogRing::Record &record);
+  void summarize();
+
+  std::string ident_;  //syslog keeps the pointer openlog() is given
+
+  LogRing           ring_;
+  std::atomic<bool> running_;
+  std::thread       writer_;
+
+  std::unordered_map<std::string, Similar> similar_;
+  unsigned sent_   = 0;
+  time_t   window_ = 0;
+
+  /* No copy constructor, no = operator */
+  SyslogSink(const SyslogSink &);
+  SyslogSink &operator = (const SyslogSink &);
+};
+
+/**
+ * Buffers a message for syslog. The put area is one record long; each flush
+ * of the stream queues what it holds, at the priority last streamed in (and
+ * then LOG_INFO again), on the open sink - it is lost if none is open.
+ */
+class Syslog : public std::streambuf {
+public:
+  enum class LogLevel : int {
+      kSyslogPanic       = LOG_EMERG,
+      kSyslogAlert       = LOG_ALERT,
+      kSyslogCritical    = LOG_CRIT,
+      kSyslogError       = LOG_ERR,
+      kSyslogWarning     = LOG_WARNING,
+      kSyslogNotice      = LOG_NOTICE,
+      kSyslogInfo        = LOG_INFO,
+      kSyslogDebug       = LOG_DEBUG,
+  };
+
+  static const size_t kBufferSize = LogRing::kRecordSize;
+
+  Syslog();
+  virtual ~Syslog();
+
+  /**
+   * Opens the sink every Syslog writes to, closing any open before
+   *
+   * @method  Open
+   *
+   * @param   ident       Name messages are logged under
+   * @param   facility    syslog facility
+   */
+  static void Open(std::string ident, int facility);
+
+  /**
+   * Closes the sink, once every message queued is passed on
+   *
+   * @method  Close
+   */
+  static void Close();
+
+protected:
+  int sync();
+  int overflow(int c);
+
 private:
   friend std::ostream& operator<< (std::ostream& os,
-    const Output::Verbosity& v);
+    const Syslog::LogLevel& l);
+
+  bool send();
+
+  LogLevel syslog_priority_;
+  char     buffer_[kBufferSize];
+
+  static std::atomic<SyslogSink *> sink_;
 };
 
-class WRTout : public std::ostream {
+class WRTsyslog : public std::ostream {
 public:
-  WRTout() : std::ostream(new VerbosityBuffer()), std::ios(0) {}
-  ~WRTout() { delete rdbuf(); }
+  WRTsyslog() : std::ios(0), std::ostream(new Syslog()) {}
+  ~WRTsyslog() { delete rdbuf(); }
 
 };
 
 std::ostream& operator<< (std::ostream& os, const Syslog::LogLevel&  l);
+
 std::ostream& operator<< (std::ostream& os, const Output::Verbosity& v);
 
+/**
+ * Level tags - "wout << level::kDebug1 << ..." is "wout <<
+ * Output::Verbosity::kDebug1 << ...", unless kDebug1 is above
+ * WRT_MAX_VERBOSITY. Then the whole statement is compiled out: what follows
+ * the tag is streamed into an Output::Discard. Operands are still evaluated,
+ * so one with side effects keeps them.
+ */
+template <Output::Verbosity V>
+inline typename std::enable_if<Output::Compiled(V), std::ostream &>::type
+operator<< (std::ostream& os, Output::Level<V>) {
+  return os << V;
+}
+
+template <Output::Verbosity V>
+inline typename std::enable_if<!Output::Compiled(V), Output::Discard>::type
+operator<< (std::ostream&, Output::Level<V>) {
+  return Output::Discard();
+}
+
+namespace level {
+const Output::Level<Output::Verbosity::kVerbose>     kVerbose     = {};
+const Output::Level<Output::Verbosity::kVeryVerbose> kVeryVerbose = {};
+const Output::Level<Output::Verbosity::kDebug>       kDebug       = {};
+const Output::Level<Output::Verbosity::kDebug1>      kDebug1      = {};
+const Output::Level<Output::Verbosity::kDebug2>      kDebug2      = {};
+const Output::Level<Output::Verbosity::kDebug3>      kDebug3      = {};
+}
+
 };
 
 #endif
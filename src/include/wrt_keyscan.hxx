@@ -0,0 +1,134 @@
+/******************************************************************************
+ * wrt_keyscan.hxx                                                            *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT host key scanner. It does the job of         *
+ * ssh-keyscan in process, through the ssh wrapper library: a pool of worker  *
+ * threads performs the key exchange with many APs at once and collects each  *
+ * host key, ready to be written to known_hosts.                              *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_KEYSCAN_HXX_
+#define LIBWRT_KEYSCAN_HXX_
+
+#include <string>
+#include <vector>
+
+namespace wrt
+{
+
+/**
+ * Host key types scanned for by default (as in ssh-keyscan -t)
+ */
+const std::vector<std::string> kDefaultKeyTypes = {
+  "ecdsa-sha2-nistp256",
+  "ssh-rsa",
+  "ssh-dss",
+};
+
+class KeyScanner
+{
+public:
+  /**
+   * Default number of key exchanges performed at once
+   */
+  static const int kDefaultConcurrency = 32;
+
+  /**
+   * Default seconds to wait on an unresponsive AP
+   */
+  static const long kDefaultTimeout = 10;
+
+  /**
+   * Result of scanning a single host for a single key type
+   *
+   * host  - Host as written to known_hosts
+   * type  - Key type, as written to known_hosts (e.g. "ssh-rsa")
+   * key   - Base64 encoded public key
+   * error - Reason the scan failed, empty on success
+   */
+  struct HostKey
+  {
+    std::string host;
+    std::string type;
+    std::string key;
+    std::string error;
+
+    /**
+     * Returns whether the key was collected
+     */
+    inline bool ok() const
+    {
+      return error.empty();
+    }
+
+    /**
+     * Returns the key as a line of known_hosts (without a newline)
+     */
+    inline std::string getKnownHostsEntry() const
+    {
+      return host + ' ' + type + ' ' + key;
+    }
+  };
+
+  explicit KeyScanner(int concurrency = kDefaultConcurrency);
+
+  /**
+   * Sets the seconds to wait on an unresponsive AP
+   *
+   * @method  setTimeout
+   *
+   * @param   seconds     Connection timeout
+   */
+  inline void setTimeout(long seconds)
+  {
+    timeout_ = seconds;
+  }
+
+  /**
+   * Sets the host key types to scan each host for
+   *
+   * @method  setKeyTypes
+   *
+   * @param   types       Key types, as named by ssh (e.g. "ssh-rsa")
+   */
+  inline void setKeyTypes(std::vector<std::string> types)
+  {
+    key_types_ = types;
+  }
+
+  /**
+   * Queues a host to be scanned
+   *
+   * @method  add
+   *
+   * @param   host        Address (or name) of the host to scan
+   */
+  void add(std::string host);
+
+  /**
+   * Scans every queued host for every key type, several hosts at a time.
+   * Host key types a host does not offer are left out of the result. A
+   * host which offers none of them is reported once, with an error.
+   *
+   * @method  scan
+   *
+   * @return              Keys collected (and hosts which failed)
+   */
+  std::vector<HostKey> scan();
+
+private:
+  HostKey scanOne(const std::string &host, const std::string &type);
+
+  int  concurrency_;
+  long timeout_ = kDefaultTimeout;
+
+  std::vector<std::string> key_types_ = kDefaultKeyTypes;
+  std::vector<std::string> hosts_;
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+/******************************************************************************
+ * wrt_known_hosts.hxx                                                        *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT known_hosts store. The file is read once,    *
+ * its entries are indexed by host, additions and removals are applied in     *
+ * memory, and the result is written back once - atomically, so a kill can   *
+ * never leave known_hosts half written.                                      *
+ *                                                                            *
+ * Hashed host names, @markers and comments are kept as they are, but cannot  *
+ * be looked up by host.                                                      *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_KNOWN_HOSTS_HXX_
+#define LIBWRT_KNOWN_HOSTS_HXX_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wrt
+{
+
+class KnownHosts
+{
+public:
+  /**
+   * Constructor for KnownHosts - takes the path of the known_hosts file
+   */
+  explicit KnownHosts(std::string path);
+
+  /**
+   * Reads and indexes the known_hosts file. A missing file is empty.
+   *
+   * @method  load
+   */
+  void load();
+
+  /**
+   * Writes the store back to disk, if it changed since it was loaded. The
+   * file is written beside the original, synced, and renamed over it.
+   *
+   * @method  write
+   */
+  void write();
+
+  /**
+   * Returns whether any entry is known for a host
+   *
+   * @method  has
+   *
+   * @param   host        Host to look up
+   *
+   * @return              true if known, else false
+   */
+  bool has(const std::string &host) const;
+
+  /**
+   * Adds a key for a host, replacing any key of the same type it had
+   *
+   * @method  add
+   *
+   * @param   host        Host the key belongs to
+   * @param   type        Key type (e.g. "ssh-rsa")
+   * @param   key         Base64 encoded public key
+   */
+  void add(const std::string &host,
+           const std::string &type,
+           const std::string &key);
+
+  /**
+   * Removes every entry naming a host
+   *
+   * @method  remove
+   *
+   * @param   host        Host to remove
+   *
+   * @return              Number of entries removed
+   */
+  size_t remove(const std::string &host);
+
+  /**
+   * Returns the number of entries in the store
+   *
+   * @method  size
+   *
+   * @return  Entries held (including unindexed lines)
+   */
+  inline size_t size() const
+  {
+    return entries_.size() - removed_;
+  }
+
+private:
+  /**
+   * A single line of known_hosts
+   *
+   * hosts   - Host names the line applies to (empty if not indexed)
+   * type    - Key type of the line
+   * line    - The line as it is written back
+   * removed - Set once the line has been removed
+   */
+  struct Entry
+  {
+    std::vector<std::string> hosts;
+    std::string type;
+    std::string line;
+    bool removed = false;
+  };
+
+  void insert(const std::string &line);
+  void erase(size_t entry);
+
+  std::string path_;
+  std::vector<Entry> entries_;
+  std::unordered_multimap<std::string, size_t> index_;
+
+  size_t removed_ = 0;
+  bool   dirty_   = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,142 @@
+/******************************************************************************
+ * wrt_mac.hxx                                                                *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes WRT's MAC address conversions - MACs to and from     *
+ * 48 bit integers, and MACs to and from EUI64 link local IPv6 addresses      *
+ * (RFC 4291). Nothing here allocates: text is read from, and written to,     *
+ * buffers the caller owns, so whole inventories can be converted at once.    *
+ *                                                                            *
+ * A MAC is accepted in the forms in common use, and no others:               *
+ *   x. 00:11:22:AA:BB:CC or 00-11-22-aa-bb-cc (one separator throughout)     *
+ *   x. 0011.22aa.bbcc                                                        *
+ *   x. 001122AABBCC                                                          *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_MAC_HXX_
+#define LIBWRT_MAC_HXX_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace wrt
+{
+
+namespace mac
+{
+
+/**
+ * Lengths of the text forms written, not counting the NUL
+ *
+ * kLength      - 00:11:22:AA:BB:CC
+ * kEUI64Length - fe80::0211:22ff:feaa:bbcc
+ */
+const size_t kLength      = 17;
+const size_t kEUI64Length = 25;
+
+/**
+ * Parses a MAC address
+ *
+ * @method  Parse
+ *
+ * @param   text        MAC to parse
+ * @param   length      Characters in text
+ * @param   mac         Set to the 48 bit MAC, if it parses
+ *
+ * @return              true if text is a MAC address
+ */
+bool Parse(const char *text, size_t length, uint64_t &mac);
+
+inline bool Parse(const std::string &text, uint64_t &mac)
+{
+  return Parse(text.data(), text.size(), mac);
+}
+
+/**
+ * Writes a MAC in canonical form (upper case, colon separated)
+ *
+ * @method  Format
+ *
+ * @param   mac         48 bit MAC
+ * @param   out         Buffer of at least kLength + 1 characters
+ *
+ * @return              out, NUL terminated
+ */
+char *Format(uint64_t mac, char *out);
+
+/**
+ * Parses an EUI64 link local IPv6 address (any zone is ignored) back into
+ * the MAC it was derived from
+ *
+ * @method  ParseEUI64
+ *
+ * @param   text        Address to parse
+ * @param   length      Characters in text
+ * @param   mac         Set to the 48 bit MAC, if it parses
+ *
+ * @return              true if text is an EUI64 link local address
+ */
+bool ParseEUI64(const char *text, size_t length, uint64_t &mac);
+
+inline bool ParseEUI64(const std::string &text, uint64_t &mac)
+{
+  return ParseEUI64(text.data(), text.size(), mac);
+}
+
+/**
+ * Writes the EUI64 link local IPv6 address of a MAC
+ *
+ * @method  FormatEUI64
+ *
+ * @param   mac         48 bit MAC
+ * @param   out         Buffer of at least kEUI64Length + 1 characters
+ *
+ * @return              out, NUL terminated
+ */
+char *FormatEUI64(uint64_t mac, char *out);
+
+/**
+ * Parses a list of MACs
+ *
+ * @method  ParseAll
+ *
+ * @param   texts       MACs to parse
+ * @param   count       Number of MACs
+ * @param   macs        Set to each MAC in turn - 0 where one does not parse
+ *
+ * @return              Number of MACs which parsed
+ */
+size_t ParseAll(const std::string *texts, size_t count, uint64_t *macs);
+
+/**
+ * Writes a list of MACs, each in kLength + 1 characters (NUL terminated)
+ *
+ * @method  FormatAll
+ *
+ * @param   macs        48 bit MACs
+ * @param   count       Number of MACs
+ * @param   out         Buffer of at least count * (kLength + 1) characters
+ */
+void FormatAll(const uint64_t *macs, size_t count, char *out);
+
+/**
+ * Writes the EUI64 link local address of a list of MACs, each in
+ * kEUI64Length + 1 characters (NUL terminated)
+ *
+ * @method  FormatEUI64All
+ *
+ * @param   macs        48 bit MACs
+ * @param   count       Number of MACs
+ * @param   out         Buffer of at least count * (kEUI64Length + 1)
+ *                      characters
+ */
+void FormatEUI64All(const uint64_t *macs, size_t count, char *out);
+
+}
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+/******************************************************************************
+ * wrt_maintenance.hxx                                                        *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT maintenance policy. Restarting the wireless  *
+ * on an AP drops every client associated with it, so the disruptive step of  *
+ * a push is held back until the AP is quiet (few stations, little traffic)   *
+ * or until a configured maintenance window opens.                            *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_MAINTENANCE_HXX_
+#define LIBWRT_MAINTENANCE_HXX_
+
+#include <ctime>
+#include <string>
+
+namespace wrt
+{
+
+class MaintenancePolicy
+{
+public:
+  /**
+   * Load measured on a single AP
+   *
+   * stations   - Associated stations (-1 if unknown)
+   * throughput - Wireless traffic in bytes per second (-1 if unknown)
+   */
+  struct Load
+  {
+    int    stations   = -1;
+    double throughput = -1;
+  };
+
+  /**
+   * Seconds the remote load command samples traffic over
+   */
+  static const int kSampleSeconds = 2;
+
+  MaintenancePolicy() = default;
+
+  /**
+   * Sets the maintenance window, given as "HH:MM-HH:MM" in local time. A
+   * window may wrap past midnight. An empty string clears the window.
+   *
+   * @method  setWindow
+   *
+   * @param   window      Window to set
+   *
+   * @return              false if the window could not be parsed
+   */
+  bool setWindow(std::string window);
+
+  /**
+   * Sets the most stations an AP may have to be restarted outside a window.
+   * A negative value disables the station check.
+   *
+   * @method  setMaxStations
+   *
+   * @param   stations    Station threshold
+   */
+  inline void setMaxStations(int stations)
+  {
+    max_stations_ = stations;
+  }
+
+  /**
+   * Sets the most traffic (bytes per second) an AP may carry to be restarted
+   * outside a window. A negative value disables the traffic check.
+   *
+   * @method  setMaxThroughput
+   *
+   * @param   throughput  Traffic threshold
+   */
+  inline void setMaxThroughput(double throughput)
+  {
+    max_throughput_ = throughput;
+  }
+
+  /**
+   * Returns whether a maintenance window is configured
+   *
+   * @method  hasWindow
+   *
+   * @return  true if specified, else false
+   */
+  inline bool hasWindow() const
+  {
+    return window_start_ != window_end_;
+  }
+
+  /**
+   * Returns whether a station or traffic threshold is configured
+   *
+   * @method  hasThresholds
+   *
+   * @return  true if specified, else false
+   */
+  inline bool hasThresholds() const
+  {
+    return max_stations_ >= 0 || max_throughput_ >= 0;
+  }
+
+  /**
+   * Returns whether disruptive steps are restricted at all
+   *
+   * @method  isRestricted
+   *
+   * @return  true if a window or a threshold is configured
+   */
+  inline bool isRestricted() const
+  {
+    return hasWindow() || hasThresholds();
+  }
+
+  /**
+   * Returns whether the given time falls inside the maintenance window
+   *
+   * @method  inWindow
+   *
+   * @param   when        Time to check
+   *
+   * @return              true if inside the window
+   */
+  bool inWindow(time_t when) const;
+
+  /**
+   * Returns whether the given load is below every configured threshold.
+   * An unknown load is never quiet.
+   *
+   * @method  isQuiet
+   *
+   * @param   load        Load measured on an AP
+   *
+   * @return              true if the AP may be disrupted
+   */
+  bool isQuiet(const Load &load) const;
+
+  /**
+   * Returns whether a disruptive step may run now on an AP with this load
+   *
+   * @method  allowsRestart
+   *
+   * @param   load        Load measured on an AP
+   * @param   when        Current time
+   *
+   * @return              true if inside the window, or the AP is quiet
+   *                      (or no window or threshold is configured at all)
+   */
+  inline bool allowsRestart(const Load &load, time_t when) const
+  {
+    if (!isRestricted()) {
+      return true;
+    }
+
+    return inWindow(when) || (hasThresholds() && isQuiet(load));
+  }
+
+  /**
+   * Returns the remote shell command which measures the load on an AP
+   *
+   * @method  LoadCommand
+   *
+   * @param   interface   Wireless interface to measure
+   *
+   * @return              Shell command, whose output ParseLoad reads
+   */
+  static std::string LoadCommand(std::string interface);
+
+  /**
+   * Parses the output of the command given by LoadCommand
+   *
+   * @method  ParseLoad
+   *
+   * @param   reply       Output of the load command
+   * @param   load        Load to fill in
+   *
+   * @return              false if the output was malformed
+   */
+  static bool ParseLoad(const std::string &reply, Load &load);
+
+private:
+  /**
+   * Window bounds, in minutes past midnight
+   */
+  int window_start_ = 0;
+  int window_end_   = 0;
+
+  int    max_stations_   = -1;
+  double max_throughput_ = -1;
+};
+
+}
+
+#endif
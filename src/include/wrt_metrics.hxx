@@ -0,0 +1,252 @@
+/******************************************************************************
+ * wrt_metrics.hxx                                                            *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT push metrics - how long each phase of a      *
+ * push took, AP by AP, kept as latency histograms with counters beside them: *
+ *                                                                            *
+ *   x. transfer  copying the configuration files over                        *
+ *   x. set       uci set of the wireless configuration                       *
+ *   x. commit    uci commit                                                  *
+ *   x. restart   wifi down; wifi up                                          *
+ *                                                                            *
+ * Each phase is a run of ssh, and is timed whole - ssh connects and          *
+ * authenticates on its own, so those are not told apart from the command.    *
+ *                                                                            *
+ * The histograms are HDR style - exact below 128us, and from there on 64     *
+ * buckets to every doubling - so a percentile is off by under 1/64 of its    *
+ * value, whatever the range. They are written out as a Prometheus textfile   *
+ * (for node_exporter's textfile collector) and as a JSON summary, which also *
+ * names the slowest APs.                                                     *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_METRICS_HXX_
+#define LIBWRT_METRICS_HXX_
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace wrt
+{
+
+class LatencyHistogram
+{
+public:
+  /**
+   * Values below 2^kSubBits are counted exactly - above, each doubling is
+   * split into 2^(kSubBits - 1) buckets
+   */
+  static const int kSubBits = 7;
+
+  /**
+   * Largest value tracked (in microseconds, about 12 days) - any longer is
+   * counted as this
+   */
+  static const uint64_t kMaxValue = (1ULL << 40) - 1;
+
+  /**
+   * Counts a value
+   *
+   * @method  record
+   *
+   * @param   value       Value, in microseconds
+   */
+  void record(uint64_t value);
+
+  /**
+   * Returns the value a fraction of those counted are at or below
+   *
+   * @method  percentile
+   *
+   * @param   fraction    Fraction, from 0 to 1 (0.99 - the 99th percentile)
+   *
+   * @return              The highest value in the bucket the percentile
+   *                      falls in (0 if nothing was counted)
+   */
+  uint64_t percentile(double fraction) const;
+
+  /**
+   * Returns how many values counted are at or below a bound, to within the
+   * histogram's precision
+   *
+   * @method  countAtOrBelow
+   *
+   * @param   bound       Bound, in microseconds
+   *
+   * @return              Values in the buckets wholly at or below the bound
+   */
+  uint64_t countAtOrBelow(uint64_t bound) const;
+
+  inline uint64_t getCount() const
+  {
+    return count_;
+  }
+
+  inline uint64_t getSum() const
+  {
+    return sum_;
+  }
+
+  inline uint64_t getMin() const
+  {
+    return count_ ? min_ : 0;
+  }
+
+  inline uint64_t getMax() const
+  {
+    return max_;
+  }
+
+private:
+  static size_t   Index(uint64_t value);
+  static uint64_t Highest(size_t index);
+
+  std::vector<uint64_t> counts_;  //Grown to the highest bucket counted
+  uint64_t count_ = 0;
+  uint64_t sum_   = 0;
+  uint64_t min_   = UINT64_MAX;
+  uint64_t max_   = 0;
+};
+
+class PushMetrics
+{
+public:
+  /**
+   * Phases of a push, in the order an AP goes through them
+   */
+  enum class Phase : int
+  {
+    kTransfer = 0,
+    kSet      = 1,
+    kCommit   = 2,
+    kRestart  = 3,
+  };
+
+  static const int kPhases = 4;
+
+  /**
+   * Number of the slowest APs the summary names
+   */
+  static const size_t kSlowest = 20;
+
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * Returns the name of a phase ("connect", "transfer", ...)
+   *
+   * @method  PhaseToString
+   *
+   * @param   phase       Phase to name
+   *
+   * @return              Its name
+   */
+  static const char *PhaseToString(Phase phase);
+
+  /**
+   * Constructor for PushMetrics - the run starts now
+   */
+  PushMetrics();
+
+  /**
+   * Records a phase an AP went through
+   *
+   * @method  record
+   *
+   * @param   AP          Name of the AP
+   * @param   phase       Phase it went through
+   * @param   start       When the phase started - it ends now
+   * @param   ok          false if the phase failed
+   */
+  void record(const std::string &AP, Phase phase, Clock::time_point start,
+              bool ok = true);
+
+  /**
+   * Counts how a push left an AP
+   *
+   * @method  outcome
+   *
+   * @param   result      "complete", "incomplete" or "skipped"
+   */
+  void outcome(const std::string &result);
+
+  /**
+   * Writes the metrics as a Prometheus textfile. The file is replaced at
+   * once, so a scrape never reads half of it.
+   *
+   * @method  writePrometheus
+   *
+   * @param   path        File to write (named *.prom for node_exporter)
+   */
+  void writePrometheus(const std::string &path);
+
+  /**
+   * Writes a JSON summary of the metrics, replacing the file at once
+   *
+   * @method  writeJSON
+   *
+   * @param   path        File to write
+   */
+  void writeJSON(const std::string &path);
+
+  /**
+   * Returns true if nothing has been recorded
+   *
+   * @method  empty
+   *
+   * @return  true if no phase or outcome was recorded
+   */
+  bool empty();
+
+  const LatencyHistogram &getHistogram(Phase phase) const
+  {
+    return phases_[static_cast<int>(phase)].latency;
+  }
+
+private:
+  struct PhaseMetrics
+  {
+    LatencyHistogram latency;
+    uint64_t failures = 0;
+  };
+
+  /**
+   * Time an AP took over every phase recorded for it, and its slowest
+   */
+  struct APTime
+  {
+    std::string name;
+    uint64_t total   = 0;
+    uint64_t slowest = 0;
+    Phase    phase   = Phase::kTransfer;
+  };
+
+  void retire();
+
+  std::mutex lock_;
+  time_t     started_;
+  Clock::time_point start_;
+
+  PhaseMetrics phases_[kPhases];
+  std::vector<std::pair<std::string, uint64_t>> outcomes_;
+
+  /**
+   * The AP whose phases are being recorded, and the slowest of those done
+   * (most first) - only kSlowest APs are ever held, whatever the fleet
+   */
+  APTime current_;
+  std::vector<APTime> slowest_;
+
+  /* No copy constructor, no = operator */
+  PushMetrics(const PushMetrics &);
+  PushMetrics &operator = (const PushMetrics &);
+};
+
+}
+
+#endif
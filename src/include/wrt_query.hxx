@@ -0,0 +1,205 @@
+/******************************************************************************
+ * wrt_query.hxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT fleet query engine. A selector names a set   *
+ * of APs as comma separated terms, every one of which must match; a term is  *
+ * KEY=VALUE, and VALUE may list alternatives separated by '|':               *
+ *                                                                            *
+ *   x. name=bldg7-*     names, as a glob ([...], ? and *)                    *
+ *   x. type=TL-MR3020   types, by any name wrt_types.hxx knows               *
+ *   x. net=10.4.0.0/16  IPv4 or IPv6 addresses within a prefix               *
+ *   x. push=committed   progress of the current push - none, transferred,    *
+ *                       set, committed, restarted, or pending (any but       *
+ *                       restarted)                                           *
+ *                                                                            *
+ * e.g. "type=TL-MR3020,net=10.4.0.0/16" or "name=bldg7-*,push=pending".      *
+ *                                                                            *
+ * Names, addresses and types are indexed - by a path compressed trie, a      *
+ * crit-bit (radix) tree over 128 bit addresses (IPv4 mapped into ::ffff:0:0/ *
+ * 96), and a bucket per type - so a selector costs the size of its smallest  *
+ * indexed term, not of the fleet. Push terms are not indexed; the caller    *
+ * checks them against the APs the indexes give.                              *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_QUERY_HXX_
+#define LIBWRT_QUERY_HXX_
+
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <wrt_ap.hxx>
+
+namespace wrt
+{
+
+class FleetIndex
+{
+public:
+  /**
+   * A parsed selector
+   */
+  class Selector
+  {
+  public:
+    /**
+     * A term - its key, and the values any one of which may match
+     */
+    struct Term
+    {
+      std::string key;
+      std::vector<std::string> values;
+    };
+
+    /**
+     * Parses a selector
+     *
+     * @method  Parse
+     *
+     * @param   text        Selector, e.g. "type=TL-MR3020,name=bldg7-*"
+     *
+     * @return              The selector (std::runtime_error if malformed)
+     */
+    static Selector Parse(const std::string &text);
+
+    /**
+     * Returns the terms the indexes cannot answer (push)
+     *
+     * @method  getStatus
+     *
+     * @return  Those terms
+     */
+    inline const std::vector<Term> &getStatus() const
+    {
+      return status_;
+    }
+
+    inline const std::string &getText() const
+    {
+      return text_;
+    }
+
+  private:
+    friend class FleetIndex;
+
+    /**
+     * An address prefix, as 128 bits
+     */
+    struct Prefix
+    {
+      uint8_t bytes[16];
+      unsigned length;
+    };
+
+    std::string text_;
+
+    std::vector<std::vector<std::string>>       names_;
+    std::vector<std::vector<AccessPoint::Type>> types_;
+    std::vector<std::vector<Prefix>>            nets_;
+    std::vector<Term>                           status_;
+  };
+
+  /**
+   * Reads the AP indexed under an id - its position, from 0
+   */
+  typedef std::function<AccessPoint (size_t id)> Reader;
+
+  /**
+   * Constructor for FleetIndex - indexes the APs a reader gives for ids 0
+   * to count - 1, only the index itself being held. The reader must give
+   * the same AP for an id while the index is used.
+   */
+  FleetIndex(size_t count, Reader read);
+
+  /**
+   * Returns the APs a selector's name, type and net terms match
+   *
+   * @method  select
+   *
+   * @param   selector    Selector to match
+   *
+   * @return              The APs, in the order of their ids
+   */
+  std::vector<AccessPoint> select(const Selector &selector) const;
+
+  /**
+   * Returns the number of APs indexed
+   *
+   * @method  size
+   *
+   * @return  APs in the index
+   */
+  inline size_t size() const
+  {
+    return count_;
+  }
+
+private:
+  typedef std::vector<uint32_t> IDs;
+  typedef Selector::Prefix Prefix;
+
+  /**
+   * Path compressed trie of names - each edge holds a run of characters
+   */
+  struct TrieNode
+  {
+    std::string edge;
+    std::vector<uint32_t> children;
+    IDs ids;
+  };
+
+  /**
+   * Crit-bit tree of addresses - a branch tests one bit, and children below
+   * zero are leaves (~index)
+   */
+  struct Branch
+  {
+    unsigned bit;
+    int32_t  child[2];
+  };
+
+  struct Leaf
+  {
+    uint8_t bytes[16];
+    IDs ids;
+  };
+
+  void insertName(const std::string &name, uint32_t id);
+  void findNames(const std::string &prefix, bool exact, IDs &ids) const;
+  void collectNames(uint32_t node, IDs &ids) const;
+
+  void insertAddress(const uint8_t bytes[16], uint32_t id);
+  void findAddresses(const Prefix &prefix, IDs &ids) const;
+  void collectAddresses(int32_t node, IDs &ids) const;
+
+  IDs  candidates(const std::vector<std::string> &names) const;
+  IDs  candidates(const std::vector<AccessPoint::Type> &types) const;
+  IDs  candidates(const std::vector<Prefix> &nets) const;
+  bool matches(const AccessPoint &AP, const Selector &selector) const;
+
+  static bool Within(const uint8_t bytes[16], const Prefix &prefix);
+  static void Map(const in_addr &address, uint8_t bytes[16]);
+
+  size_t                count_;
+  Reader                read_;
+
+  std::vector<TrieNode> trie_;
+  std::vector<Branch>   branches_;
+  std::vector<Leaf>     leaves_;
+  int32_t               root_ = 0;
+  std::vector<IDs>      types_;
+
+  /* No copy constructor, no = operator */
+  FleetIndex(const FleetIndex &);
+  FleetIndex &operator = (const FleetIndex &);
+};
+
+}
+
+#endif
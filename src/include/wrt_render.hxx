@@ -0,0 +1,166 @@
+/******************************************************************************
+ * wrt_render.hxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT record renderer - machine readable output of *
+ * flat records (an AP, or how a push left one) in one of three formats:      *
+ *                                                                            *
+ *   x. json    a single array of objects,                                    *
+ *   x. ndjson  one object per line, each complete as soon as it is written,  *
+ *   x. csv     a header row (the first record's keys), then a row a record.  *
+ *                                                                            *
+ * Records are built straight into a block sized buffer, which is written to  *
+ * the file descriptor only once full (or finished) - one write(2) for many   *
+ * records, and no iostream or verbosity check on the way.                    *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_RENDER_HXX_
+#define LIBWRT_RENDER_HXX_
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace wrt
+{
+
+class Renderer
+{
+public:
+  /**
+   * Output formats - kText is WRT's own, which the renderer does not write
+   */
+  enum class Format : int
+  {
+    kText   = 0,
+    kJSON   = 1,
+    kNDJSON = 2,
+    kCSV    = 3,
+  };
+
+  static const size_t kDefaultBlock = 64 * 1024;
+
+  /**
+   * Returns the format a name (text, json, ndjson or csv) stands for
+   *
+   * @method  FormatFromString
+   *
+   * @param   name        Name of the format
+   *
+   * @return              The format (std::runtime_error if unknown)
+   */
+  static Format FormatFromString(const std::string &name);
+
+  /**
+   * Constructor for Renderer - takes the format, the file descriptor to
+   * write to, and how much to buffer between writes
+   */
+  Renderer(Format format, int fd = STDOUT_FILENO,
+           size_t block = kDefaultBlock);
+
+  /**
+   * Destructor for Renderer - finishes the output
+   */
+  ~Renderer();
+
+  /**
+   * Starts a record
+   *
+   * @method  begin
+   */
+  void begin();
+
+  /**
+   * Adds a field to the record begun
+   *
+   * @method  field
+   *
+   * @param   key         Name of the field (the same, in the same order, for
+   *                      every record - csv has a column per key)
+   * @param   value       Value of the field
+   */
+  void field(const char *key, const std::string &value);
+  void field(const char *key, const char *value);
+  void field(const char *key, long long value);
+  void field(const char *key, bool value);
+
+  /**
+   * Adds a field without a value (null in json, an empty csv cell)
+   *
+   * @method  null
+   *
+   * @param   key         Name of the field
+   */
+  void null(const char *key);
+
+  /**
+   * Ends the record begun
+   *
+   * @method  end
+   */
+  void end();
+
+  /**
+   * Closes the output (the json array), and writes whatever is buffered. No
+   * record may follow.
+   *
+   * @method  finish
+   */
+  void finish();
+
+  /**
+   * Writes whatever is buffered
+   *
+   * @method  flush
+   */
+  void flush();
+
+  /**
+   * Returns the number of records rendered
+   *
+   * @method  size
+   *
+   * @return  Records ended so far
+   */
+  inline size_t size() const
+  {
+    return records_;
+  }
+
+  inline Format getFormat() const
+  {
+    return format_;
+  }
+
+private:
+  std::string &target();
+  void key(const char *key);
+  void quoted(std::string &to, const char *data, size_t length);
+
+  Format format_;
+  int    fd_;
+  size_t block_;
+
+  std::string buffer_;
+  size_t records_  = 0;
+  size_t fields_   = 0;
+  bool   finished_ = false;
+
+  /**
+   * csv only - the first record's keys, and its row until the header is out
+   */
+  std::vector<std::string> header_;
+  std::string first_;
+
+  /* No copy constructor, no = operator */
+  Renderer(const Renderer &);
+  Renderer &operator = (const Renderer &);
+};
+
+}
+
+#endif
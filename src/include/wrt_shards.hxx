@@ -0,0 +1,198 @@
+/******************************************************************************
+ * wrt_shards.hxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT inventory shards - a directory of inventory  *
+ * files (one per site, say), each holding an Access_Points list laid out as  *
+ * wrt.cfg's is. Every *.cfg file in the directory is a shard:                *
+ *                                                                            *
+ *   x. shards are parsed in parallel, each into its own settings, so a large *
+ *      inventory loads in about the time of its largest file, and            *
+ *   x. each shard is written through its own ConfigStore, so a change only   *
+ *      rewrites (and locks) the shards it touches.                           *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_SHARDS_HXX_
+#define LIBWRT_SHARDS_HXX_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <libconfig.h++>
+
+#include <wrt_ap.hxx>
+#include <wrt_config.hxx>
+
+namespace wrt
+{
+
+class InventoryShards
+{
+public:
+  /**
+   * Constructor for InventoryShards - takes the path of the directory
+   */
+  InventoryShards(std::string directory);
+  ~InventoryShards();
+
+  /**
+   * Returns the shards in the directory, sorted (none if it does not exist)
+   *
+   * @method  list
+   *
+   * @return              Path of each shard
+   */
+  std::vector<std::string> list() const;
+
+  /**
+   * Reads shards, in parallel
+   *
+   * @method  load
+   *
+   * @param   paths       Shards to read
+   * @param   threads     Most to read at once (0 - one per core)
+   */
+  void load(const std::vector<std::string> &paths, unsigned threads = 0);
+
+  /**
+   * Returns the number of shards read or written
+   *
+   * @method  size
+   *
+   * @return  Shards held
+   */
+  inline size_t size() const
+  {
+    return shards_.size();
+  }
+
+  /**
+   * Returns the path of a shard
+   *
+   * @method  getPath
+   *
+   * @param   index       Index of the shard
+   *
+   * @return              Its path
+   */
+  const std::string &getPath(size_t index) const;
+
+  /**
+   * Returns the APs of a shard, in the order it lists them
+   *
+   * @method  getAPs
+   *
+   * @param   index       Index of the shard
+   *
+   * @return              Its APs
+   */
+  std::vector<AccessPoint> &getAPs(size_t index);
+
+  /**
+   * Returns the APs of a shard with a malformed MAC or address
+   *
+   * @method  getMalformed
+   *
+   * @param   index       Index of the shard
+   *
+   * @return              Their names
+   */
+  const std::vector<std::string> &getMalformed(size_t index) const;
+
+  /**
+   * Returns the store of a shard - one not yet read is read before it is
+   * written
+   *
+   * @method  getStore
+   *
+   * @param   path        Path of the shard
+   *
+   * @return              Its store
+   */
+  ConfigStore &getStore(const std::string &path);
+
+  /**
+   * Returns the path of a shard, by name
+   *
+   * @method  pathOf
+   *
+   * @param   name        Name of the shard, without ".cfg"
+   *
+   * @return              Its path
+   */
+  std::string pathOf(const std::string &name) const;
+
+  /**
+   * Writes every shard with changes queued
+   *
+   * @method  flush
+   *
+   * @return  Shards written
+   */
+  size_t flush();
+
+  /**
+   * Forgets every shard held - settings, APs and any changes not flushed
+   *
+   * @method  clear
+   */
+  void clear();
+
+  inline const std::string &getDirectory() const
+  {
+    return directory_;
+  }
+
+  /**
+   * Reads the Access_Points list of a file's settings
+   *
+   * @method  ReadAPs
+   *
+   * @param   config      Settings read from the file
+   * @param   APs         APs read, appended
+   * @param   malformed   Names of APs with a malformed MAC or address
+   */
+  static void ReadAPs(libconfig::Config &config,
+                      std::vector<AccessPoint> &APs,
+                      std::vector<std::string> &malformed);
+
+  /**
+   * Returns a change which drops every AP with one of the names or MACs
+   * given from a file's Access_Points list, then appends APs
+   *
+   * @method  Replace
+   *
+   * @param   names       Names to drop
+   * @param   macs        MACs to drop, as Inventory::MACKey() gives them
+   * @param   added       APs to append
+   *
+   * @return              The change
+   */
+  static ConfigStore::Mutation Replace(
+    const std::unordered_set<std::string> &names,
+    const std::unordered_set<std::string> &macs,
+    const std::vector<AccessPoint> &added);
+
+private:
+  struct Shard;
+
+  Shard &find(const std::string &path);
+
+  std::string directory_;
+
+  std::vector<std::unique_ptr<Shard>>      shards_;
+  std::unordered_map<std::string, Shard *> index_;
+
+  /* No copy constructor, no = operator */
+  InventoryShards(const InventoryShards &);
+  InventoryShards &operator = (const InventoryShards &);
+};
+
+}
+
+#endif
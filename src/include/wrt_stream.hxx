@@ -0,0 +1,131 @@
+/******************************************************************************
+ * wrt_stream.hxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT inventory stream - the managed APs, handed   *
+ * out a window at a time. A window is only refilled once the one before it   *
+ * has been worked through, so however large the inventory, no more than a    *
+ * window of APs is held at once. Pulling, rather than having a reader push,  *
+ * keeps the pipeline single threaded - it forks.                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_STREAM_HXX_
+#define LIBWRT_STREAM_HXX_
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <wrt_ap.hxx>
+#include <wrt_image.hxx>
+
+namespace wrt
+{
+
+class InventoryStream
+{
+public:
+  /**
+   * Reads the next AP into AP, returning false once there are none left
+   */
+  typedef std::function<bool (AccessPoint &AP)> Source;
+
+  static const size_t kDefaultWindow = 256;
+
+  /**
+   * Constructor for InventoryStream - takes the source of the APs, and how
+   * many to hold at once
+   */
+  InventoryStream(Source source, size_t window = kDefaultWindow);
+
+  /**
+   * Replaces the window with the next APs
+   *
+   * @method  next
+   *
+   * @return  false once every AP has been handed out
+   */
+  bool next();
+
+  /**
+   * Reads the rest of the APs from another source - the window handed out
+   * already is kept, and position() counts on
+   *
+   * @method  reset
+   *
+   * @param   source      Source of the APs still to come
+   */
+  void reset(Source source);
+
+  /**
+   * Returns the APs of the current window
+   *
+   * @method  window
+   *
+   * @return  The window
+   */
+  inline std::vector<AccessPoint> &window()
+  {
+    return window_;
+  }
+
+  /**
+   * Returns the number of APs handed out so far
+   *
+   * @method  position
+   *
+   * @return  APs read from the source
+   */
+  inline size_t position() const
+  {
+    return position_;
+  }
+
+  /**
+   * Returns a source reading the APs of an open inventory image, in order
+   *
+   * @method  Of
+   *
+   * @param   image       Image to read (must stay open)
+   *
+   * @return              The source
+   */
+  static Source Of(InventoryImage &image);
+
+  /**
+   * Returns a source reading the APs of a list held in memory
+   *
+   * @method  Of
+   *
+   * @param   APs         APs to read (must not change meanwhile)
+   *
+   * @return              The source
+   */
+  static Source Of(APList &APs);
+
+  /**
+   * Returns a source reading the APs of a selection, in order
+   *
+   * @method  Of
+   *
+   * @param   APs         APs to read (the vector must stay put)
+   *
+   * @return              The source
+   */
+  static Source Of(std::vector<AccessPoint> &APs);
+
+private:
+  Source source_;
+
+  size_t size_;
+  size_t position_ = 0;
+  bool   done_     = false;
+
+  std::vector<AccessPoint> window_;
+};
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+/******************************************************************************
+ * wrt_trace.hxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header describes the WRT tracer - a timeline of a run, written as     *
+ * Chrome trace-event JSON (chrome://tracing, or ui.perfetto.dev). A span is  *
+ * a named stretch of time, on the lane of the thread it ran on; a child      *
+ * process (ssh, mostly) gets a lane of its own, from fork to reaping, so     *
+ * children running at once are seen side by side.                           *
+ *                                                                            *
+ * Each thread records into a buffer of its own, under a lock no other thread *
+ * takes until the trace is closed - and nothing is recorded, or copied, at   *
+ * all unless a trace is open.                                                *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_TRACE_HXX_
+#define LIBWRT_TRACE_HXX_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace wrt
+{
+
+class Trace
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * Records a span for as long as it is in scope
+   */
+  class Span
+  {
+  public:
+    /**
+     * Constructor for Span - takes the span's name and category (literals,
+     * which must outlive the trace), and what it concerns - an AP, a
+     * file - if anything
+     */
+    Span(const char *name, const char *category,
+         const std::string &target = std::string());
+
+    /**
+     * Destructor for Span - the span ends
+     */
+    ~Span();
+
+  private:
+    const char *name_;
+    const char *category_;
+    std::string target_;
+    Clock::time_point start_;
+    bool recording_;
+
+    /* No copy constructor, no = operator */
+    Span(const Span &);
+    Span &operator = (const Span &);
+  };
+
+  /**
+   * Opens a trace - spans are recorded from now on, until it is closed
+   *
+   * @method  Open
+   *
+   * @param   path        File the trace is written to once closed
+   */
+  static void Open(const std::string &path);
+
+  /**
+   * Writes the trace out and closes it. Threads which recorded spans must
+   * be done with them.
+   *
+   * @method  Close
+   */
+  static void Close();
+
+  /**
+   * Returns true if a trace is open
+   *
+   * @method  Enabled
+   *
+   * @return  true if spans are recorded
+   */
+  static inline bool Enabled()
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Records a span on the calling thread's lane
+   *
+   * @method  Complete
+   *
+   * @param   name        Name of the span (a literal)
+   * @param   category    Category of the span (a literal)
+   * @param   start       When the span started - it ends now
+   * @param   target      What the span concerns (an AP, say), if anything
+   */
+  static void Complete(const char *name, const char *category,
+                       Clock::time_point start,
+                       const std::string &target = std::string());
+
+  /**
+   * Starts the span of a child process, on a lane of its own
+   *
+   * @method  Started
+   *
+   * @param   PID         PID of the child
+   * @param   name        Name of the span (a literal)
+   * @param   target      What the child works on (an AP), if anything
+   */
+  static void Started(long PID, const char *name,
+                      const std::string &target = std::string());
+
+  /**
+   * Ends the span of a child process, once it is reaped
+   *
+   * @method  Exited
+   *
+   * @param   PID         PID of the child
+   */
+  static void Exited(long PID);
+
+  /**
+   * Names the calling thread's lane
+   *
+   * @method  NameThread
+   *
+   * @param   name        Name shown for the lane
+   */
+  static void NameThread(const std::string &name);
+
+private:
+  static std::atomic<bool> enabled_;
+};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+/******************************************************************************
+ * wrt_types.hxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * This header is the registry of AP types WRT knows - every spelling of each *
+ * type's name, and the profile the push pipeline uses for it:                *
+ *   x. radio - its /etc/config/wireless template, a file under               *
+ *      Config_Dir/radio/ (the examples are in examples/radio)                *
+ *   x. ciphers, kex and macs - its SSH algorithm preferences                 *
+ *                                                                            *
+ * It is all constexpr: names are matched case insensitively ('-' and '_'    *
+ * alike) through a perfect hash, with no allocation, and a profile is an     *
+ * array index away from its type.                                            *
+ *                                                                            *
+ * Adding a type: append its profile to kProfiles (in enum order), its names *
+ * to kAliases, and give each name the slot Hash() picks for it in kSlots -   *
+ * the static_asserts below refuse a table which does not add up. Should two  *
+ * names want one slot, change kSeed until none do.                           *
+ *                                                                            *
+ ******************************************************************************/
+
+#ifndef LIBWRT_TYPES_HXX_
+#define LIBWRT_TYPES_HXX_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <wrt_ap.hxx>
+
+namespace wrt
+{
+
+/**
+ * Everything the push pipeline needs to know about a type of AP
+ */
+struct TypeProfile
+{
+  AccessPoint::Type type;
+  const char *name;         //Canonical name, as written to wrt.cfg
+  const char *radio;        //Template under Config_Dir/radio/ ("" - none)
+  const char *ciphers;      //SSH preferences, comma separated ("" - default)
+  const char *kex;
+  const char *macs;
+};
+
+/**
+ * A name a type is known by
+ */
+struct TypeAlias
+{
+  const char *name;
+  AccessPoint::Type type;
+};
+
+namespace types
+{
+
+/**
+ * Profiles, in AccessPoint::Type order. The small MIPS boards do an elliptic
+ * curve exchange in a fraction of the time of a 2048 bit Diffie-Hellman, and
+ * stream AES-128 fastest.
+ */
+constexpr TypeProfile kProfiles[] = {
+  { AccessPoint::Type::none,         "none",         "",
+    "", "", "" },
+  { AccessPoint::Type::tl_wr703n,    "TL-WR703N",    "wr703n",
+    "aes128-ctr,aes256-ctr",
+    "curve25519-sha256@libssh.org,ecdh-sha2-nistp256,"
+    "diffie-hellman-group14-sha1",
+    "hmac-sha1" },
+  { AccessPoint::Type::tl_mr3020,    "TL-MR3020",    "mr3020",
+    "aes128-ctr,aes256-ctr",
+    "curve25519-sha256@libssh.org,ecdh-sha2-nistp256,"
+    "diffie-hellman-group14-sha1",
+    "hmac-sha1" },
+  { AccessPoint::Type::wrt54g,       "WRT54G",       "wrt54g",
+    "aes128-ctr,aes256-ctr",
+    "curve25519-sha256@libssh.org,ecdh-sha2-nistp256,"
+    "diffie-hellman-group14-sha1",
+    "hmac-sha1" },
+  { AccessPoint::Type::whr_hp_g300n, "WHR-HP-G300N", "whrhpg300n",
+    "aes128-ctr,aes256-ctr",
+    "curve25519-sha256@libssh.org,ecdh-sha2-nistp256,"
+    "diffie-hellman-group14-sha1",
+    "hmac-sha1" },
+};
+
+constexpr size_t kProfileCount = sizeof(kProfiles) / sizeof(kProfiles[0]);
+
+/**
+ * Every accepted name - case, and '-' against '_', do not matter
+ */
+constexpr TypeAlias kAliases[] = {
+  { "none",         AccessPoint::Type::none },
+  { "TL-WR703N",    AccessPoint::Type::tl_wr703n },
+  { "TL-MR3020",    AccessPoint::Type::tl_mr3020 },
+  { "WRT54G",       AccessPoint::Type::wrt54g },
+  { "WHR-HP-G300N", AccessPoint::Type::whr_hp_g300n },
+  { "WR703N",       AccessPoint::Type::tl_wr703n },
+  { "MR3020",       AccessPoint::Type::tl_mr3020 },
+  { "HP-G300N",     AccessPoint::Type::whr_hp_g300n },
+  { "WHRHPG300N",   AccessPoint::Type::whr_hp_g300n },
+};
+
+constexpr size_t kAliasCount = sizeof(kAliases) / sizeof(kAliases[0]);
+
+/**
+ * The perfect hash - kSlots[Hash(name) % kSlotCount] is the index of name in
+ * kAliases, or -1 where no name hashes
+ */
+constexpr uint32_t kSeed      = 45;
+constexpr size_t   kSlotCount = 16;
+
+constexpr int8_t kSlots[kSlotCount] = {
+  -1,  6, -1, -1,  3,  1, -1,  2,  0,  7,  4, -1, -1,  5,  8, -1,
+};
+
+/**
+ * Folds a character for matching - lower case, '_' as '-'
+ */
+constexpr char Fold(char c)
+{
+  return c == '_' ? '-' : (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+/**
+ * FNV-1a over the folded name, then mixed so the low bits spread
+ */
+constexpr uint32_t Mix(uint32_t hash, int round = 0)
+{
+  return round == 0 ? Mix(hash ^ (hash >> 16), 1) :
+         round == 1 ? Mix(hash * 0x7FEB352DU, 2) :
+                      hash ^ (hash >> 15);
+}
+
+constexpr uint32_t Hash(const char *name, uint32_t hash = 2166136261U ^ kSeed)
+{
+  return *name ? Hash(name + 1, (hash ^ static_cast<uint8_t>(Fold(*name))) *
+                                16777619U)
+               : Mix(hash);
+}
+
+/**
+ * Compares two names as folded
+ */
+constexpr bool Equal(const char *a, const char *b)
+{
+  return Fold(*a) == Fold(*b) && (!*a || Equal(a + 1, b + 1));
+}
+
+/**
+ * Returns the type a name refers to - Type::none if it is unknown
+ *
+ * @method  Find
+ *
+ * @param   name        Name of a type, in any case
+ *
+ * @return              The type
+ */
+constexpr AccessPoint::Type Find(const char *name)
+{
+  return kSlots[Hash(name) % kSlotCount] >= 0 &&
+         Equal(name, kAliases[kSlots[Hash(name) % kSlotCount]].name)
+         ? kAliases[kSlots[Hash(name) % kSlotCount]].type
+         : AccessPoint::Type::none;
+}
+
+inline AccessPoint::Type Find(const std::string &name)
+{
+  return Find(name.c_str());
+}
+
+/**
+ * Returns the profile of a type
+ *
+ * @method  Profile
+ *
+ * @param   type        Type of AP
+ *
+ * @return              Its profile (that of Type::none, if out of range)
+ */
+constexpr const TypeProfile &Profile(AccessPoint::Type type)
+{
+  return kProfiles[static_cast<size_t>(type) < kProfileCount ?
+                   static_cast<size_t>(type) : 0];
+}
+
+/**
+ * Returns the canonical name of a type
+ *
+ * @method  Name
+ *
+ * @param   type        Type of AP
+ *
+ * @return              Its name
+ */
+constexpr const char *Name(AccessPoint::Type type)
+{
+  return Profile(type).name;
+}
+
+/**
+ * Checks, at compile time, that the tables agree with each other
+ */
+constexpr bool InOrder(size_t i = 0)
+{
+  return i == kProfileCount ||
+         (static_cast<size_t>(kProfiles[i].type) == i && InOrder(i + 1));
+}
+
+constexpr bool Placed(size_t i = 0)
+{
+  return i == kAliasCount ||
+         (kSlots[Hash(kAliases[i].name) % kSlotCount] == static_cast<int>(i) &&
+          Placed(i + 1));
+}
+
+constexpr bool Canonical(size_t i = 0)
+{
+  return i == kProfileCount ||
+         (Find(kProfiles[i].name) == kProfiles[i].type && Canonical(i + 1));
+}
+
+static_assert(InOrder(),   "kProfiles must follow AccessPoint::Type order");
+static_assert(Placed(),    "kSlots does not match Hash() - see the header");
+static_assert(Canonical(), "every canonical name must be in kAliases");
+static_assert(Find("tl_wr703n") == AccessPoint::Type::tl_wr703n &&
+              Find("wr703") == AccessPoint::Type::none,
+              "names must match case and separator insensitively, exactly");
+
+}
+
+}
+
+#endif
@@ -0,0 +1,122 @@
+/***********************************************************************
+ * ssh_channel.cxx                                                     *
+ *                                                                     *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>        *
+ *                                                                     *
+ * The ssh::Channel class wraps a libssh channel - a command running   *
+ * on the remote host, and the streams to and from it.                 *
+ *                                                                     *
+ **********************************************************************/
+
+#include <ssh_channel.hxx>
+
+namespace ssh {
+
+Channel::Channel(Session &session)
+  : c_channel_(ssh_channel_new(session.c_session_)),
+    c_session_(session.c_session_) {
+  if (!c_channel_) {
+    throw SshException(c_session_);
+  }
+}
+
+Channel::~Channel() {
+  ssh_channel_free(c_channel_);
+  c_channel_ = nullptr;
+}
+
+  /**
+   * Opens a session channel (for a shell or a command)
+   * throws: SshException on error
+   **/
+  void Channel::openSession() {
+    if (ssh_channel_open_session(c_channel_) != SSH_OK) {
+      throw SshException(c_session_);
+    }
+  }
+
+  /**
+   * Runs a command on the channel
+   * param:  command to run on the remote host
+   * throws: SshException on error
+   **/
+  void Channel::requestExec(std::string command) {
+    if (ssh_channel_request_exec(c_channel_, command.c_str()) != SSH_OK) {
+      throw SshException(c_session_);
+    }
+  }
+
+  /**
+   * Writes data to the remote command's stdin - blocks until all is sent
+   * param:   data to write, and its length
+   * throws:  SshException on error
+   * returns: bytes written
+   **/
+  size_t Channel::write(const void *data, size_t length) {
+    const char *next = static_cast<const char *>(data);
+    size_t left = length;
+
+    while (left) {
+      int written = ssh_channel_write(c_channel_, next, left);
+
+      if (written == SSH_ERROR) {
+        throw SshException(c_session_);
+      }
+
+      next += written;
+      left -= written;
+    }
+
+    return length;
+  }
+
+  /**
+   * Reads from the remote command's stdout
+   * param:   buffer to read into, and its length
+   * throws:  SshException on error
+   * returns: bytes read, 0 on EOF
+   **/
+  int Channel::read(void *data, size_t length) {
+    int rtn = ssh_channel_read(c_channel_, data, length, 0);
+
+    if (rtn == SSH_ERROR) {
+      throw SshException(c_session_);
+    }
+
+    return rtn;
+  }
+
+  /**
+   * Closes the remote command's stdin
+   * throws: SshException on error
+   **/
+  void Channel::sendEof() {
+    if (ssh_channel_send_eof(c_channel_) == SSH_ERROR) {
+      throw SshException(c_session_);
+    }
+  }
+
+  /**
+   * Closes the channel
+   **/
+  void Channel::close() {
+    ssh_channel_close(c_channel_);
+  }
+
+  bool Channel::isOpen() {
+    return ssh_channel_is_open(c_channel_);
+  }
+
+  bool Channel::isEof() {
+    return ssh_channel_is_eof(c_channel_);
+  }
+
+  /**
+   * Returns the exit status of the remote command (waits for it to exit)
+   * returns: exit status, or -1 if none was sent
+   **/
+  int Channel::getExitStatus() {
+    return ssh_channel_get_exit_status(c_channel_);
+  }
+
+} //namespace ssh
@@ -0,0 +1,59 @@
+/***********************************************************************
+ * ssh_channel.hxx                                                     *
+ *                                                                     *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>        *
+ *                                                                     *
+ * This file is a header file for a library that is a wrapper for the  *
+ * library libssh. The ssh::Channel class wraps a single channel of an *
+ * ssh::Session - enough to run a command and stream data to it.       *
+ *                                                                     *
+ **********************************************************************/
+
+#ifndef LIBSSH_CHANNEL_HPP_
+#define LIBSSH_CHANNEL_HPP_
+
+/* avoid using deprecated functions */
+#define LIBSSH_LEGACY_0_4
+
+#include <libssh/libssh.h>
+
+#include <cstdlib>
+#include <string>
+
+#include <ssh_exception.hxx>
+#include <ssh_session.hxx>
+
+namespace ssh {
+
+class Channel {
+
+public:
+  Channel() = delete;
+  explicit Channel(Session &session);
+  ~Channel();
+
+  void openSession();
+  void requestExec(std::string command);
+
+  size_t write(const void *data, size_t length);
+  int read(void *data, size_t length);
+
+  void sendEof();
+  void close();
+
+  bool isOpen();
+  bool isEof();
+  int getExitStatus();
+
+private:
+  ssh_channel  c_channel_;
+  ssh_session  c_session_;
+
+  /* No copy constructor, no = operator */
+  Channel(const Channel &);
+  Channel& operator = (const Channel &);
+}; //class Channel
+
+} //namespace ssh
+
+#endif
@@ -10,6 +10,8 @@
 
 #include <ssh_exception.hxx>
 
+namespace ssh {
+
 //Unrolls exceptions - WARNING: RECURSIVE
 void print_exception(const std::exception& exception, int depth) {
   std::cerr << std::string(depth, ' ')
@@ -25,3 +27,5 @@ void print_exception(const std::exception& exception, int depth) {
 
   return;
 }
+
+} //namespace ssh
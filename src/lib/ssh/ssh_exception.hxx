@@ -74,8 +74,8 @@ private:
 
 };
 
-}
-
 void print_exception(const std::exception& exception, int depth = 0);
 
+}
+
 #endif
@@ -10,15 +10,40 @@
 
 #include <ssh_keys.hxx>
 
+#include <cstring>
+
 namespace ssh {
-Key::Key(Session &session) {
-  ssh_get_publickey(session.c_session_, &c_key);
+
+/**
+ * Returns a key's type as named in known_hosts - older libssh names every
+ * ECDSA key "ssh-ecdsa", where known_hosts wants its curve
+ **/
+static std::string KnownHostsType(ssh_key c_key) {
+  const char *type = ssh_key_type_to_char(ssh_key_type(c_key));
+
+  if (type && !strcmp(type, "ssh-ecdsa")) {
+    type = ssh_pki_key_ecdsa_name(c_key);
+  }
+
+  return std::string(type ? type : "unknown");
+}
+
+Key::Key(Session &session)
+  : c_key(nullptr), c_hash(nullptr), c_hash_length(0) {
+  if (ssh_get_publickey(session.c_session_, &c_key) != SSH_OK) {
+    throw SshException(session.c_session_);
+  }
+
   c_hash_length = ssh_get_pubkey_hash(session.c_session_, &c_hash);
 }
 
-Key::Key(ssh_session c_session) {
-  ssh_get_publickey(c_session, &c_key);
-  ssh_get_pubkey_hash(c_session, &c_hash);    
+Key::Key(ssh_session c_session)
+  : c_key(nullptr), c_hash(nullptr), c_hash_length(0) {
+  if (ssh_get_publickey(c_session, &c_key) != SSH_OK) {
+    throw SshException(c_session);
+  }
+
+  c_hash_length = ssh_get_pubkey_hash(c_session, &c_hash);
 }
 
 Key::~Key() {
@@ -29,16 +54,97 @@ Key::~Key() {
   c_hash = nullptr;
 }
 
+/**
+ * Returns the public key hash as a hex string ("aa:bb:cc:...")
+ * returns: the hash, or an empty string if there is none
+ **/
 std::string Key::getHash() {
-  std::string CPPhexa = nullptr;
+  std::string CPPhexa;
 
-  if (c_hash) {
-    const char *hexa = ssh_get_hexa(c_hash, c_hash_length);
+  if (c_hash && c_hash_length > 0) {
+    char *hexa = ssh_get_hexa(c_hash, c_hash_length);
     CPPhexa = std::string(hexa);
-    free((void *)hexa);
+    free(hexa);
   }
 
   return CPPhexa;
 }
 
+/**
+ * Returns the public key hash as raw bytes
+ * returns: the hash, or an empty string if there is none
+ **/
+std::string Key::getRawHash() {
+  if (!c_hash || c_hash_length <= 0) {
+    return std::string();
+  }
+
+  return std::string(reinterpret_cast<const char *>(c_hash), c_hash_length);
+}
+
+/**
+ * Returns the key type, as named in known_hosts (e.g. "ssh-rsa")
+ **/
+std::string Key::getType() {
+  return KnownHostsType(c_key);
+}
+
+/**
+ * Returns the public key base64 encoded, as written in known_hosts
+ * throws: SshException on error
+ **/
+std::string Key::getBase64() {
+  char *base64 = nullptr;
+
+  if (ssh_pki_export_pubkey_base64(c_key, &base64) != SSH_OK) {
+    throw SshException("ssh_pki_export_pubkey_base64(): failed");
+  }
+
+  std::string CPPbase64(base64);
+  free(base64);
+
+  return CPPbase64;
+}
+
+/**
+ * Reads a private key from a file (which must not be passphrase protected)
+ * param:  file path of the private key
+ * throws: SshException if the key cannot be read
+ **/
+PrivateKey::PrivateKey(std::string file)
+  : c_key(nullptr), file_(file) {
+  if (ssh_pki_import_privkey_file(file.c_str(), NULL, NULL, NULL,
+                                  &c_key) != SSH_OK) {
+    std::string error = "ssh_pki_import_privkey_file(): cannot read " + file;
+    throw SshException(error);
+  }
+}
+
+PrivateKey::~PrivateKey() {
+  ssh_key_free(c_key);
+  c_key = nullptr;
+}
+
+/**
+ * Returns the path the key was read from
+ **/
+std::string PrivateKey::getFile() {
+  return file_;
+}
+
+/**
+ * Returns the key type (e.g. "ssh-rsa")
+ **/
+std::string PrivateKey::getType() {
+  return KnownHostsType(c_key);
+}
+
+/**
+ * Returns the libssh key, for use with Session::userauthPublickey
+ * returns: the key - owned by this object, do not free it
+ **/
+ssh_key PrivateKey::getCKey() {
+  return c_key;
+}
+
 } //namespace ssh
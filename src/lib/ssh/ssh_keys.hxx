@@ -23,6 +23,8 @@
 
 namespace ssh {
 
+class Session;
+
 class Key {
 
 public:
@@ -32,16 +34,41 @@ public:
   ~Key();
 
   std::string getHash();
+  std::string getRawHash();
+  std::string getType();
+  std::string getBase64();
 
 private:
   ssh_key        c_key;
   unsigned char *c_hash;
   int            c_hash_length;
-      
-  // Key(const Key &);
-  // Key& operator = (const Key &);
+
+  /* No copy constructor, no = operator */
+  Key(const Key &);
+  Key& operator = (const Key &);
+};
+
+/* A private key, read from a file once and kept for authentication */
+class PrivateKey {
+
+public:
+  PrivateKey() = delete;
+  explicit PrivateKey(std::string file);
+  ~PrivateKey();
+
+  std::string getFile();
+  std::string getType();
+  ssh_key getCKey();
+
+private:
+  ssh_key     c_key;
+  std::string file_;
+
+  /* No copy constructor, no = operator */
+  PrivateKey(const PrivateKey &);
+  PrivateKey& operator = (const PrivateKey &);
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
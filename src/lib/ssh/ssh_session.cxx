@@ -28,10 +28,12 @@
 
 #include <ssh_session.hxx>
 
+#include <mutex>
+
 namespace ssh {
 
 Session::Session() {
-  ssh_init();
+  Initialize();
   c_session_ = ssh_new();
   ssh_set_blocking(c_session_, 1);
   ssh_blocking_flush(c_session_, 1);
@@ -42,6 +44,16 @@ Session::~Session() {
   c_session_=NULL;
 }
 
+  /**
+   * Initializes libssh, once per process - ssh_init() itself is not safe
+   * to call from several threads at once in older libssh
+   **/
+void Session::Initialize() {
+  static std::once_flag initialized;
+
+  std::call_once(initialized, []() { ssh_init(); });
+}
+
   /**
    * Sets an SSH session options
    * param: type Type of option
@@ -90,14 +102,27 @@ void Session::setOption(enum ssh_options_e type, const char *option) {
     }
   }
 
+  /**
+   * Sets the check run on the host key, right after key exchange
+   * param: verifier function returning false to reject the host
+   **/
+  void Session::setHostVerifier(HostVerifier verifier) {
+    verifier_ = verifier;
+  }
+
   /* Connects to the remote host
-   * throws: SshException on error
+   * throws: SshException on error, or if the host verifier rejects the host
    * see ssh_connect
    */
   void Session::connect() {
     if(ssh_connect(c_session_) == SSH_ERROR) {
       throw SshException(c_session_);
     }
+
+    if(verifier_ && !verifier_(*this)) {
+      ssh_disconnect(c_session_);
+      throw SshException("Host key verification failed");
+    }
   }
 
   /* Authenticates automatically using public key
@@ -30,6 +30,7 @@
 #include <stdio.h>
 
 #include <cstdlib>
+#include <functional>
 #include <iostream>
 
 #include <ssh_exception.hxx>
@@ -44,14 +45,23 @@ class Session {
   friend class Channel;
 
 public:
+  /* Called right after key exchange - returning false rejects the host */
+  typedef std::function<bool (Session &)> HostVerifier;
+
   Session();
   ~Session();
+
+  /* Initializes libssh - once per process, whichever thread calls first.
+   * Call it before starting threads which open sessions. */
+  static void Initialize();
  
   void setOption(enum ssh_options_e type, std::string option);
   void setOption(enum ssh_options_e type, const char *option); //TODO DEPRICATE
   void setOption(enum ssh_options_e type, long int option); //TODO DEPRICATE
   void setOption(enum ssh_options_e type, void *option); //TODO DEPRICATE
   
+  void setHostVerifier(HostVerifier verifier);
+
   void optionsCopy(const Session &source);
   void optionsParseConfig(const char *file);
  
@@ -81,7 +91,8 @@ public:
   int writeKnownhost();
 
 private:
-  ssh_session c_session_;
+  ssh_session  c_session_;
+  HostVerifier verifier_;
   ssh_session getCSession();
 
   /* No copy constructor, no = operator */
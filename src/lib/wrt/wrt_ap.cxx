@@ -9,6 +9,14 @@
  ******************************************************************************/
 
 #include <wrt_ap.hxx>
+#include <wrt_mac.hxx>
+#include <wrt_types.hxx>
+
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
 
 namespace wrt
 {
@@ -18,13 +26,7 @@ namespace wrt
  */
 AccessPoint::AccessPoint(std::string MACAddress)
 {
-  ap_type_     = Type::none;
-
-  mac_address_ = MACAddress;
-  FormatMAC(MACAddress);
-
-  link_local_ipv6_address_ = mac_address_;
-  MACtoEUI64(link_local_ipv6_address_);
+  initialize(kNoName, MACAddress);
 }
 
 /**
@@ -32,13 +34,7 @@ AccessPoint::AccessPoint(std::string MACAddress)
  */
 AccessPoint::AccessPoint(const char *MACAddress)
 {
-  ap_type_     = Type::none;
-
-  mac_address_ = std::string(MACAddress);
-  FormatMAC(mac_address_);
-
-  link_local_ipv6_address_ = mac_address_;
-  MACtoEUI64(link_local_ipv6_address_);
+  initialize(kNoName, MACAddress);
 }
 
 /**
@@ -46,14 +42,7 @@ AccessPoint::AccessPoint(const char *MACAddress)
  */
 AccessPoint::AccessPoint(std::string Name, std::string MACAddress)
 {
-  ap_type_     = Type::none;
-  ap_name_     = Name;
-
-  mac_address_ = MACAddress;
-  FormatMAC(mac_address_);
-
-  link_local_ipv6_address_ = mac_address_;
-  MACtoEUI64(link_local_ipv6_address_);
+  initialize(Name, MACAddress);
 }
 
 /**
@@ -61,14 +50,7 @@ AccessPoint::AccessPoint(std::string Name, std::string MACAddress)
  */
 AccessPoint::AccessPoint(const char *Name, const char *MACAddress)
 {
-  ap_type_     = Type::none;
-  ap_name_     = std::string(Name);
-
-  mac_address_ = std::string(MACAddress);
-  FormatMAC(mac_address_);
-
-  link_local_ipv6_address_ = mac_address_;
-  MACtoEUI64(link_local_ipv6_address_);
+  initialize(Name, MACAddress);
 }
 
 /**
@@ -78,14 +60,8 @@ AccessPoint::AccessPoint(std::string Name,
                          std::string MACAddress,
                          std::string Type)
 {
-  ap_type_     = StringToType(Type);
-  ap_name_     = Name;
-
-  mac_address_ = MACAddress;
-  FormatMAC(mac_address_);
-
-  link_local_ipv6_address_ = mac_address_;
-  MACtoEUI64(link_local_ipv6_address_);
+  initialize(Name, MACAddress);
+  ap_type_ = types::Find(Type);
 }
 
 /**
@@ -95,17 +71,26 @@ AccessPoint::AccessPoint(const char *Name,
                          const char *MACAddress,
                          const char *Type)
 {
-  ap_type_     = StringToType(std::string(Type));
-  ap_name_     = std::string(Name);
+  initialize(Name, MACAddress);
+  ap_type_ = types::Find(Type);
+}
 
-  mac_address_ = std::string(MACAddress);
-  FormatMAC(mac_address_);
+/**
+ * Sets the name and MAC - shared by the constructors. A MAC which does not
+ * parse leaves the AP without one.
+ */
+void AccessPoint::initialize(const std::string &Name,
+                             const std::string &MACAddress)
+{
+  ap_name_ = Intern(Name);
 
-  link_local_ipv6_address_ = mac_address_;
-  MACtoEUI64(link_local_ipv6_address_);
+  if (ParseMAC(MACAddress, mac_address_) && mac_address_) {
+    present_ |= kHasMAC;
+  } else {
+    mac_address_ = 0;
+  }
 }
 
-
 /**
  * Comparator function for the AccessPoint class
  *
@@ -116,13 +101,89 @@ AccessPoint::AccessPoint(const char *Name,
  * @return           indicates whether this AP is greater than (>0),
  *                   less than (<0), or equal to (0) the given AP
  */
-int AccessPoint::compare(AccessPoint const &ap)
+int AccessPoint::compare(AccessPoint const &ap) const
 {
-  if (ap_name_ == mac_address_) {
-    return mac_address_.compare(ap.mac_address_);
+  //Names are pooled - the same pointer is the same name
+  if (ap_name_ == ap.ap_name_) {
+    if (ap_name_) {
+      return 0;
+    }
+
+    return (mac_address_ > ap.mac_address_) - (mac_address_ < ap.mac_address_);
   }
 
-  return ap_name_.compare(ap.ap_name_);
+  return getName().compare(ap.getName());
+}
+
+/**
+ * Compares every field of two APs
+ */
+bool AccessPoint::identical(AccessPoint const &ap) const
+{
+  return ap_name_ == ap.ap_name_ && ap_type_ == ap.ap_type_ &&
+         present_ == ap.present_ && mac_address_ == ap.mac_address_ &&
+         ipv4_address_.s_addr == ap.ipv4_address_.s_addr &&
+         link_local_ipv4_address_.s_addr ==
+           ap.link_local_ipv4_address_.s_addr &&
+         !memcmp(&ipv6_address_, &ap.ipv6_address_, sizeof(ipv6_address_));
+}
+
+/**
+ * Accessor to get the string type
+ */
+std::string AccessPoint::getType() const
+{
+  return types::Name(ap_type_);
+}
+
+/**
+ * AP mutator to set the type by string - unknown names set Type::none
+ */
+void AccessPoint::setType(const std::string &type)
+{
+  setType(types::Find(type));
+}
+
+/**
+ * Accessors to get the addresses in string form
+ */
+std::string AccessPoint::getIPv4() const
+{
+  char text[INET_ADDRSTRLEN];
+
+  if (!hasIPv4() || !inet_ntop(AF_INET, &ipv4_address_, text, sizeof(text))) {
+    return kNoIPv4;
+  }
+
+  return text;
+}
+
+std::string AccessPoint::getIPv6() const
+{
+  char text[INET6_ADDRSTRLEN];
+
+  if (!hasIPv6() || !inet_ntop(AF_INET6, &ipv6_address_, text, sizeof(text))) {
+    return kNoIPv6;
+  }
+
+  return text;
+}
+
+std::string AccessPoint::getLinkLocalIPv4() const
+{
+  char text[INET_ADDRSTRLEN];
+
+  if (!hasLinkLocalIPv4() ||
+      !inet_ntop(AF_INET, &link_local_ipv4_address_, text, sizeof(text))) {
+    return kNoIPv4;
+  }
+
+  return text;
+}
+
+std::string AccessPoint::getLinkLocalIPv6() const
+{
+  return hasMAC() ? MACToEUI64String(mac_address_) : kNoIPv6;
 }
 
 /**
@@ -132,7 +193,7 @@ int AccessPoint::compare(AccessPoint const &ap)
  *
  * @return  A typedef'd list of vector type containing all AP addresses
  */
-AddressList AccessPoint::getAddresses()
+AddressList AccessPoint::getAddresses() const
 {
   std::vector<std::string> addresses;
 
@@ -143,6 +204,53 @@ AddressList AccessPoint::getAddresses()
   return addresses;
 }
 
+/**
+ * AP mutator to set the IPv4 address by string - kNoIPv4 clears it
+ */
+bool AccessPoint::setIPv4(const std::string &address)
+{
+  present_ &= ~kHasIPv4;
+  ipv4_address_ = in_addr();
+
+  if (address.empty() || address == kNoIPv4) {
+    return true;
+  }
+
+  if (inet_pton(AF_INET, address.c_str(), &ipv4_address_) != 1) {
+    ipv4_address_ = in_addr();
+    return false;
+  }
+
+  present_ |= kHasIPv4;
+
+  return true;
+}
+
+/**
+ * AP mutator to set the IPv6 address by string - kNoIPv6 clears it
+ */
+bool AccessPoint::setIPv6(const std::string &address)
+{
+  present_ &= ~kHasIPv6;
+  ipv6_address_ = in6_addr();
+
+  if (address.empty()) {
+    return true;
+  }
+
+  if (inet_pton(AF_INET6, address.c_str(), &ipv6_address_) != 1) {
+    ipv6_address_ = in6_addr();
+    return false;
+  }
+
+  //The unspecified address (kNoIPv6, however written) is no address
+  if (!IN6_IS_ADDR_UNSPECIFIED(&ipv6_address_)) {
+    present_ |= kHasIPv6;
+  }
+
+  return true;
+}
+
 /**
  * Formats a MAC address to be properly formatted - mutates string given
  *
@@ -152,17 +260,19 @@ AddressList AccessPoint::getAddresses()
  */
 void AccessPoint::FormatMAC(std::string &MACtoFormat)
 {
-  if (MACtoFormat.empty()) {
-    MACtoFormat = std::string("00:00:00:00:00:00");
+  uint64_t mac;
 
-  } else {
+  if (MACtoFormat.empty()) {
+    MACtoFormat = kNoMAC;
 
-    //this is where the fun stops
-    std::stringstream ss(std::ios_base::in |
-                         std::ios_base::out | std::ios_base::ate);
+  } else if (ParseMAC(MACtoFormat, mac)) {
+    MACtoFormat = MACToString(mac);
 
-    ss << std::uppercase << MACtoFormat;
-    ss >> MACtoFormat;
+  } else {
+    std::transform(MACtoFormat.begin(),
+                   MACtoFormat.end(),
+                   MACtoFormat.begin(),
+                   (int (*)(int))std::toupper);
   }
 
   return;
@@ -178,111 +288,90 @@ void AccessPoint::FormatMAC(std::string &MACtoFormat)
  */
 void AccessPoint::MACtoEUI64(std::string &MACtoMutate)
 {
-  if (MACtoMutate.empty()) {
-    MACtoMutate = "fe80::0200:00ff:fe00:0000";
-  }
+  uint64_t mac = 0;
 
-  else {
-    //this is where the fun stops
-    std::stringstream ss(std::ios_base::in
-                         | std::ios_base::out
-                         | std::ios_base::ate);
-
-    /**
-     * What is being done here: the construction of a link-local
-     * IPv6 address from the MAC address of a given access point.
-     *
-     * To better understand stateless IPv6 link-local addressing,
-     * please read RFC 4291.
-     *
-     * These addresses are ideal because they cannot leave the local
-     * network - assuming sanity (RFC conformance).
-     **/
-
-    ss << "fe80::" << MACtoMutate.at(0) << std::hex
-       << (std::strtoul(MACtoMutate.c_str() + 1, NULL, 16) | 0x2)
-       << std::dec << std::nouppercase << MACtoMutate.substr(3, 5)
-       << "ff:fe" << MACtoMutate.substr(9, 5)
-       << MACtoMutate.substr(15, 2);
-
-    ss >> MACtoMutate;
-
-    /* Convert all letters to lower case in the
-     * ipv6 link local address */
-    std::transform(MACtoMutate.begin(),
-                   MACtoMutate.end(),
-                   MACtoMutate.begin(),
-                   (int (*)(int))std::tolower);
-  }
+  ParseMAC(MACtoMutate, mac);
+  MACtoMutate = MACToEUI64String(mac);
 
   return;
 }
 
 /**
- * Returns a AccessPoint::Type in string form
- *
- * @method  TypeToString
- *
- * @param   Type          Enum to return in string form
- *
- * @return                String form of enum given
+ * Parses a MAC address - 12 hex digits, optionally separated
  */
-std::string AccessPoint::TypeToString(AccessPoint::Type Type)
+bool AccessPoint::ParseMAC(const std::string &text, uint64_t &mac)
 {
-  switch (Type) {
-  case AccessPoint::Type::none:
-    return "none";
-
-  case AccessPoint::Type::tl_wr703n:
-    return "TL-WR703N";
-
-  case AccessPoint::Type::tl_mr3020:
-    return "TL-MR3020";
+  return mac::Parse(text, mac);
+}
 
-  case AccessPoint::Type::wrt54g:
-    return "WRT54G";
+/**
+ * Returns a 48 bit MAC in string form (upper case, colon separated)
+ */
+std::string AccessPoint::MACToString(uint64_t mac)
+{
+  char text[mac::kLength + 1];
 
-  case AccessPoint::Type::whr_hp_g300n:
-    return "WHR-HP-G300N";
+  return std::string(mac::Format(mac, text), mac::kLength);
+}
 
-  default:
-    return "unknown";
-  }
+/**
+ * Returns the EUI64 link local IPv6 address of a 48 bit MAC, in string form
+ */
+std::string AccessPoint::MACToEUI64String(uint64_t mac)
+{
+  /**
+   * What is being done here: the construction of a link-local
+   * IPv6 address from the MAC address of a given access point.
+   *
+   * To better understand stateless IPv6 link-local addressing,
+   * please read RFC 4291.
+   *
+   * These addresses are ideal because they cannot leave the local
+   * network - assuming sanity (RFC conformance).
+   **/
+  char text[mac::kEUI64Length + 1];
+
+  return std::string(mac::FormatEUI64(mac, text), mac::kEUI64Length);
 }
 
 /**
- * Returns a AccessPoint::Type in enum form
- *
- * @method  StringToType
- *
- * @param   type          String type to return in enum form
- *
- * @return                Enum form of given string
+ * Returns the pooled copy of a name - equal names share one string
  */
-AccessPoint::Type AccessPoint::StringToType(std::string type)
+std::shared_ptr<const std::string> AccessPoint::Intern(const std::string &name)
 {
-  static std::unordered_map<std::string, AccessPoint::Type> getEnum = {
-    {"none",         AccessPoint::Type::none},
-    {"TL-WR703N",    AccessPoint::Type::tl_wr703n},
-    {"tl-wr703n",    AccessPoint::Type::tl_wr703n},
-    {"TL_WR703N",    AccessPoint::Type::tl_wr703n},
-    {"tl_wr703n",    AccessPoint::Type::tl_wr703n},
-    {"wr703n",       AccessPoint::Type::tl_wr703n},
-    {"TL-MR3020",    AccessPoint::Type::tl_mr3020},
-    {"TL_MR3020",    AccessPoint::Type::tl_mr3020},
-    {"tl_mr3020",    AccessPoint::Type::tl_mr3020},
-    {"mr3020",       AccessPoint::Type::tl_mr3020},
-    {"WHR-HP-G300N", AccessPoint::Type::whr_hp_g300n},
-    {"whr-hp-g300n", AccessPoint::Type::whr_hp_g300n},
-    {"WHR_HP_G300N", AccessPoint::Type::whr_hp_g300n},
-    {"whr_hp_g300n", AccessPoint::Type::whr_hp_g300n},
-    {"hp_g300n",     AccessPoint::Type::whr_hp_g300n},
-    {"hp_g300n",     AccessPoint::Type::whr_hp_g300n},
-    {"WRT54G",       AccessPoint::Type::wrt54g},
-    {"wrt54g",       AccessPoint::Type::wrt54g}
-  };
-
-  return getEnum[type];
+  //Never destroyed - an AP may outlive any static
+  static auto *pool =
+    new std::unordered_map<std::string, std::weak_ptr<const std::string> >();
+  static auto *mutex = new std::mutex();
+
+  if (name == kNoName) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> guard(*mutex);
+  std::weak_ptr<const std::string> &pooled = (*pool)[name];
+  std::shared_ptr<const std::string> shared = pooled.lock();
+
+  if (shared) {
+    return shared;
+  }
+
+  //The last AP to let go of a name takes it out of the pool - unless the
+  //name was pooled again meanwhile
+  shared.reset(new std::string(name), [](const std::string *released) {
+    std::lock_guard<std::mutex> guard(*mutex);
+    auto entry = pool->find(*released);
+
+    if (entry != pool->end() && entry->second.expired()) {
+      pool->erase(entry);
+    }
+
+    delete released;
+  });
+
+  pooled = shared;
+
+  return shared;
 }
 
 } //namespace wrt
@@ -0,0 +1,330 @@
+/******************************************************************************
+ * wrt_checkpoint.cxx                                                         *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT push journal. The journal is a plain text file   *
+ * of tab separated records, appended (and synced) as each step completes:    *
+ *                                                                            *
+ *   G <generation>             - configuration the journal belongs to        *
+ *   S <ap> <step>              - step completed on an AP                     *
+ *   F <ap> <file> <offset>     - transfer started at offset (-1 = complete)  *
+ *                                                                            *
+ * A record without its trailing newline was torn by a kill, and is ignored.  *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_checkpoint.hxx>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace wrt
+{
+
+/**
+ * Constructor for Checkpoint - takes the path of the journal file
+ */
+Checkpoint::Checkpoint(std::string path)
+  : path_(path) {}
+
+Checkpoint::~Checkpoint()
+{
+  if (journal_ != -1) {
+    close(journal_);
+  }
+}
+
+/**
+ * Replays the journal on disk. A journal written for a different
+ * generation (i.e. the local configuration changed since) is discarded.
+ *
+ * @method  load
+ *
+ * @param   generation  Identifies the configuration being pushed
+ */
+void Checkpoint::load(std::string generation)
+{
+  std::string::size_type complete, size;
+
+  generation_ = generation;
+
+  bool current = scan(complete, size);
+
+  if (journal_ != -1) {
+    close(journal_);
+  }
+
+  //Drop a torn record, so the next append starts on a line of its own
+  if (current && complete < size) {
+    if (truncate(path_.c_str(), complete) == -1) {
+      current = false;
+    }
+  }
+
+  int flags = O_WRONLY | O_APPEND | O_CREAT | (current ? 0 : O_TRUNC);
+
+  if ((journal_ = open(path_.c_str(), flags, S_IRUSR | S_IWUSR)) == -1) {
+    throw std::runtime_error("open(): cannot open journal \"" + path_ + "\"");
+  }
+
+  if (!current) {
+    progress_.clear();
+    append("G\t" + generation_);
+  }
+}
+
+/**
+ * Replays the journal on disk, without opening it for writing
+ *
+ * @method  read
+ *
+ * @param   generation  Identifies the configuration being pushed
+ */
+void Checkpoint::read(std::string generation)
+{
+  std::string::size_type complete, size;
+
+  if (journal_ != -1) {
+    close(journal_);
+    journal_ = -1;
+  }
+
+  generation_ = generation;
+
+  scan(complete, size);
+}
+
+/**
+ * Removes the journal from disk and forgets all progress
+ *
+ * @method  clear
+ */
+void Checkpoint::clear()
+{
+  if (journal_ != -1) {
+    close(journal_);
+    journal_ = -1;
+  }
+
+  unlink(path_.c_str());
+  progress_.clear();
+}
+
+/**
+ * Returns whether the given step has been completed for an AP
+ */
+bool Checkpoint::isComplete(const std::string &ap, Step step)
+{
+  auto entry = progress_.find(ap);
+
+  if (entry == progress_.end()) {
+    return step == Step::kNone;
+  }
+
+  return static_cast<int>(entry->second.step) >= static_cast<int>(step);
+}
+
+/**
+ * Journals the completion of a step for an AP
+ */
+void Checkpoint::mark(const std::string &ap, Step step)
+{
+  std::stringstream record;
+  record << "S\t" << ap << '\t' << static_cast<int>(step);
+
+  append(record.str());
+  replay(record.str());
+}
+
+/**
+ * Returns whether a file transfer to an AP was started by a prior run
+ */
+bool Checkpoint::isStarted(const std::string &ap, const std::string &file)
+{
+  auto entry = progress_.find(ap);
+
+  return entry != progress_.end() && entry->second.files.count(file);
+}
+
+/**
+ * Returns whether a file transfer to an AP was completed
+ */
+bool Checkpoint::isTransferred(const std::string &ap, const std::string &file)
+{
+  if (isComplete(ap, Step::kTransferred)) {
+    return true;
+  }
+
+  return isStarted(ap, file) &&
+         progress_[ap].files[file] == kTransferComplete;
+}
+
+/**
+ * Journals the offset a file transfer to an AP is (re)started from
+ */
+void Checkpoint::setOffset(const std::string &ap,
+                           const std::string &file,
+                           off_t offset)
+{
+  std::stringstream record;
+  record << "F\t" << ap << '\t' << file << '\t' << offset;
+
+  append(record.str());
+  replay(record.str());
+}
+
+/**
+ * Journals the completion of a file transfer to an AP
+ */
+void Checkpoint::markTransferred(const std::string &ap,
+                                 const std::string &file)
+{
+  setOffset(ap, file, kTransferComplete);
+}
+
+/**
+ * Returns a Checkpoint::Step in string form
+ *
+ * @method  StepToString
+ *
+ * @param   step        Enum to return in string form
+ *
+ * @return              String form of enum given
+ */
+std::string Checkpoint::StepToString(Step step)
+{
+  switch (step) {
+  case Step::kNone:
+    return "none";
+
+  case Step::kTransferred:
+    return "transferred";
+
+  case Step::kSet:
+    return "set";
+
+  case Step::kCommitted:
+    return "committed";
+
+  case Step::kRestarted:
+    return "restarted";
+
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * Appends a single record to the journal, and syncs it to disk
+ */
+void Checkpoint::append(const std::string &record)
+{
+  std::string line = record + '\n';
+  const char *data = line.data();
+  size_t      left = line.size();
+
+  if (journal_ == -1) {
+    throw std::runtime_error("Checkpoint: journal \"" + path_ +
+                             "\" is not loaded");
+  }
+
+  while (left) {
+    ssize_t written = write(journal_, data, left);
+
+    if (written == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      throw std::runtime_error("write(): cannot append to journal \"" +
+                               path_ + "\"");
+    }
+
+    data += written;
+    left -= written;
+  }
+
+  fdatasync(journal_);
+}
+
+/**
+ * Reads the journal and replays its records, if it belongs to the current
+ * generation - complete is set to the length of its complete records, size
+ * to the length of the file
+ */
+bool Checkpoint::scan(std::string::size_type &complete,
+                      std::string::size_type &size)
+{
+  std::ifstream journal(path_.c_str());
+  std::string   contents;
+
+  progress_.clear();
+
+  if (journal) {
+    std::stringstream ss;
+    ss << journal.rdbuf();
+    contents = ss.str();
+  }
+
+  std::string::size_type begin = 0, end;
+  bool current = false;
+
+  while ((end = contents.find('\n', begin)) != std::string::npos) {
+    std::string record = contents.substr(begin, end - begin);
+    begin = end + 1;
+
+    if (!current) {
+      current = (record == "G\t" + generation_);
+
+      if (!current) {
+        break;
+      }
+
+    } else {
+      replay(record);
+    }
+  }
+
+  complete = begin;
+  size     = contents.size();
+
+  return current;
+}
+
+/**
+ * Applies a single (complete) journal record to the in memory progress
+ */
+void Checkpoint::replay(const std::string &record)
+{
+  std::stringstream ss(record);
+  std::string type, ap, file, value;
+
+  std::getline(ss, type, '\t');
+  std::getline(ss, ap, '\t');
+
+  if (type == "S") {
+    std::getline(ss, value, '\t');
+
+    Step step = static_cast<Step>(std::atoi(value.c_str()));
+
+    if (static_cast<int>(step) > static_cast<int>(progress_[ap].step)) {
+      progress_[ap].step = step;
+    }
+
+  } else if (type == "F") {
+    std::getline(ss, file, '\t');
+    std::getline(ss, value, '\t');
+
+    progress_[ap].files[file] = std::strtoll(value.c_str(), NULL, 10);
+  }
+}
+
+} //namespace wrt
@@ -0,0 +1,329 @@
+/******************************************************************************
+ * wrt_config.cxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT configuration store. The lock is taken on a      *
+ * file beside wrt.cfg (wrt.cfg.lock) rather than on wrt.cfg itself, as every *
+ * write replaces wrt.cfg with a new file.                                    *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_config.hxx>
+#include <wrt_file.hxx>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace wrt
+{
+
+/**
+ * Constructor for ConfigStore - takes the path of the configuration file
+ * and the settings it is read into
+ */
+ConfigStore::ConfigStore(std::string path, libconfig::Config &config)
+  : path_(path), lock_path_(path + ".lock"), config_(config) {}
+
+/**
+ * Reads the configuration file into the settings
+ */
+libconfig::Config &ConfigStore::read(const std::string &skip)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  //Readers only lock if they can - the file is always replaced whole
+  int file = lock(LOCK_SH);
+
+  try {
+    load(skip);
+
+  } catch (...) {
+    unlock(file);
+    throw;
+  }
+
+  unlock(file);
+
+  return config_;
+}
+
+/**
+ * Applies a change to the settings, and queues it to be written
+ */
+void ConfigStore::mutate(Mutation mutation)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  mutation(config_);
+  pending_.push_back(mutation);
+}
+
+/**
+ * Writes every queued change in a single, atomic write
+ */
+bool ConfigStore::flush()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  char *text = nullptr;
+  size_t length = 0;
+  FILE *output;
+  int file;
+
+  if (pending_.empty()) {
+    return false;
+  }
+
+  if ((file = lock(LOCK_EX)) == -1) {
+    throw std::runtime_error("open(): cannot open lock file \"" +
+                             lock_path_ + "\"");
+  }
+
+  try {
+    //Another writer got in first - build on its file, not on ours. Settings
+    //read in part are never written back as they are.
+    if (partial_ || !(StampOf(path_) == stamp_)) {
+      load();
+
+      for (auto &mutation : pending_) {
+        mutation(config_);
+      }
+    }
+
+    //libconfig writes only to a FILE - one over memory, here
+    if (!(output = open_memstream(&text, &length))) {
+      throw std::runtime_error("open_memstream(): cannot write \"" +
+                               path_ + "\"");
+    }
+
+    config_.write(output);
+
+    if (fclose(output)) {
+      free(text);
+
+      throw std::runtime_error("write(): cannot write file \"" +
+                               path_ + "\"");
+    }
+
+    std::unique_ptr<char, void (*)(void *)> written(text, free);
+
+    file::Replace(path_, text, length,
+                  S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  } catch (...) {
+    unlock(file);
+    throw;
+  }
+
+  stamp_ = StampOf(path_);
+  pending_.clear();
+
+  unlock(file);
+
+  return true;
+}
+
+/**
+ * Returns the number of changes waiting to be written
+ */
+size_t ConfigStore::pending()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  return pending_.size();
+}
+
+/**
+ * Returns whether the settings were read with a setting left out
+ */
+bool ConfigStore::partial()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  return partial_;
+}
+
+/**
+ * Compares two file identities
+ */
+bool ConfigStore::Stamp::operator == (const Stamp &other) const
+{
+  return device == other.device && inode == other.inode &&
+         size == other.size && modified == other.modified;
+}
+
+/**
+ * Returns the identity of a file (all zero if it does not exist)
+ */
+ConfigStore::Stamp ConfigStore::StampOf(const std::string &path)
+{
+  struct stat info;
+  Stamp stamp;
+
+  if (!stat(path.c_str(), &info)) {
+    stamp.device   = info.st_dev;
+    stamp.inode    = info.st_ino;
+    stamp.size     = info.st_size;
+    stamp.modified = info.st_mtime;
+  }
+
+  return stamp;
+}
+
+/**
+ * Takes the advisory lock, waiting for it if need be. Returns -1 if the lock
+ * file cannot be opened (e.g. the directory is read only).
+ */
+int ConfigStore::lock(int operation)
+{
+  int file = open(lock_path_.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+
+  if (file == -1) {
+    return -1;
+  }
+
+  while (flock(file, operation) == -1) {
+    if (errno != EINTR) {
+      close(file);
+
+      throw std::runtime_error("flock(): cannot lock \"" + lock_path_ + "\"");
+    }
+  }
+
+  return file;
+}
+
+/**
+ * Releases the advisory lock
+ */
+void ConfigStore::unlock(int file)
+{
+  if (file == -1) {
+    return;
+  }
+
+  flock(file, LOCK_UN);
+  close(file);
+}
+
+/**
+ * Cuts a top level setting, and its value, out of the text of a
+ * configuration. What is cut is blanked rather than removed, so the lines
+ * of any parse error stay where they were.
+ */
+void ConfigStore::Cut(std::string &text, const std::string &name)
+{
+  size_t depth = 0, start = std::string::npos, i = 0;
+
+  auto word = [&text](size_t at) {
+    return isalnum(static_cast<unsigned char>(text[at])) ||
+           text[at] == '_' || text[at] == '-' || text[at] == '*';
+  };
+
+  while (i < text.size()) {
+    char c = text[i];
+
+    //Strings and comments may hold anything - brackets, or the name
+    if (c == '"') {
+      for (++i; i < text.size() && text[i] != '"'; ++i) {
+        i += text[i] == '\\';
+      }
+
+    } else if (c == '#' || !text.compare(i, 2, "//")) {
+      i = text.find('\n', i);
+      i = i == std::string::npos ? text.size() : i;
+
+    } else if (!text.compare(i, 2, "/*")) {
+      i = text.find("*/", i + 2);
+      i = i == std::string::npos ? text.size() : i + 1;
+
+    } else if (c == '(' || c == '[' || c == '{') {
+      depth++;
+
+    } else if (c == ')' || c == ']' || c == '}') {
+      depth -= depth > 0;
+
+      //A list or group ends the value, whether or not a ; follows
+      if (start != std::string::npos && !depth) {
+        size_t next = text.find_first_not_of(" \t\r\n", i + 1);
+
+        if (next != std::string::npos &&
+            (text[next] == ';' || text[next] == ',')) {
+          i = next;
+        }
+
+        break;
+      }
+
+    } else if (start != std::string::npos && !depth &&
+               (c == ';' || c == ',')) {
+      break;
+
+    } else if (start == std::string::npos && !depth &&
+               !text.compare(i, name.size(), name) &&
+               (!i || !word(i - 1)) && !word(i + name.size())) {
+      size_t next = text.find_first_not_of(" \t\r\n", i + name.size());
+
+      if (next != std::string::npos &&
+          (text[next] == '=' || text[next] == ':')) {
+        start = i;
+        i     = next;
+      }
+    }
+
+    ++i;
+  }
+
+  if (start == std::string::npos) {
+    return;
+  }
+
+  for (size_t j = start; j < i + 1 && j < text.size(); ++j) {
+    if (text[j] != '\n') {
+      text[j] = ' ';
+    }
+  }
+}
+
+/**
+ * Reads the file into the settings, and notes which file it was
+ */
+void ConfigStore::load(const std::string &skip)
+{
+  Stamp stamp = StampOf(path_);
+
+  if (skip.empty()) {
+    config_.readFile(path_.c_str());
+
+  } else {
+    std::ifstream file(path_.c_str());
+    std::stringstream text;
+
+    if (!file) {
+      throw libconfig::FileIOException();
+    }
+
+    text << file.rdbuf();
+
+    std::string contents = text.str();
+
+    Cut(contents, skip);
+    config_.readString(contents);
+  }
+
+  stamp_   = stamp;
+  partial_ = !skip.empty();
+}
+
+} //namespace wrt
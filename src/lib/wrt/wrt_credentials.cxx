@@ -0,0 +1,200 @@
+/******************************************************************************
+ * wrt_credentials.cxx                                                        *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT credential manager. The keys are only read from  *
+ * disk in load(); authenticate() may be called from many threads at once.    *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_credentials.hxx>
+#include <wrt_file.hxx>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace wrt
+{
+
+/**
+ * Constructor for Credentials - takes the directory holding the identity
+ * files, and the file the key each AP accepted is remembered in
+ */
+Credentials::Credentials(std::string directory, std::string accepted)
+  : directory_(directory), accepted_path_(accepted)
+{
+  if (!directory_.empty() && directory_[directory_.size() - 1] != '/') {
+    directory_ += '/';
+  }
+}
+
+/**
+ * Reads every identity file present, and the keys APs accepted before
+ */
+size_t Credentials::load(const std::vector<std::string> &identities)
+{
+  loadAccepted();
+
+  std::lock_guard<std::mutex> guard(lock_);
+
+  keys_.clear();
+  names_.clear();
+
+  for (auto &identity : identities) {
+    std::string file = directory_ + identity;
+
+    if (access(file.c_str(), R_OK)) {
+      continue;
+    }
+
+    try {
+      keys_.push_back(std::unique_ptr<ssh::PrivateKey>(
+                        new ssh::PrivateKey(file)));
+      names_.push_back(identity);
+
+    } catch (const std::exception &) {
+      //A key we cannot read (e.g. one with a passphrase) is not offered
+    }
+  }
+
+  return keys_.size();
+}
+
+/**
+ * Reads only the keys APs accepted before
+ */
+void Credentials::loadAccepted()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  std::ifstream accepted(accepted_path_.c_str());
+  std::string ap, name;
+
+  accepted_.clear();
+
+  while (accepted >> ap >> name) {
+    accepted_[ap] = name;
+  }
+
+  dirty_ = false;
+}
+
+/**
+ * Authenticates a connected session, offering the key the AP accepted last
+ * time first
+ */
+bool Credentials::authenticate(ssh::Session &session, const std::string &ap)
+{
+  std::vector<size_t> order;
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    auto known = accepted_.find(ap);
+
+    for (size_t i = 0; i < names_.size(); ++i) {
+      if (known != accepted_.end() && names_[i] == known->second) {
+        order.insert(order.begin(), i);
+      } else {
+        order.push_back(i);
+      }
+    }
+  }
+
+  //The keys never change after load(), so they are used without the lock
+  for (auto key : order) {
+    if (session.userauthPublickey(keys_[key]->getCKey()) != SSH_AUTH_SUCCESS) {
+      continue;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    std::string &accepted = accepted_[ap];
+
+    if (accepted != names_[key]) {
+      accepted = names_[key];
+      dirty_   = true;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+/**
+ * Returns the identity file an AP accepted
+ */
+std::string Credentials::getIdentityFile(const std::string &ap)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  auto known = accepted_.find(ap);
+
+  if (known == accepted_.end()) {
+    return std::string();
+  }
+
+  return directory_ + known->second;
+}
+
+/**
+ * Returns the identity files present in the directory
+ */
+std::vector<std::string> Credentials::available(
+  const std::vector<std::string> &identities) const
+{
+  std::vector<std::string> present;
+
+  for (auto &identity : identities) {
+    std::string file = directory_ + identity;
+
+    if (!access(file.c_str(), R_OK)) {
+      present.push_back(file);
+    }
+  }
+
+  return present;
+}
+
+/**
+ * Remembers the identity an AP accepted a connection made by ssh with
+ */
+void Credentials::accept(const std::string &ap, const std::string &identity)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  std::string name = identity.substr(identity.rfind('/') + 1);
+  std::string &accepted = accepted_[ap];
+
+  if (accepted != name) {
+    accepted = name;
+    dirty_   = true;
+  }
+}
+
+/**
+ * Writes the keys APs accepted back to disk, if any changed
+ */
+void Credentials::write()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+  std::stringstream contents;
+
+  if (!dirty_) {
+    return;
+  }
+
+  for (auto &entry : accepted_) {
+    contents << entry.first << ' ' << entry.second << '\n';
+  }
+
+  file::Replace(accepted_path_, contents.str(), S_IRUSR | S_IWUSR);
+
+  dirty_ = false;
+}
+
+} //namespace wrt
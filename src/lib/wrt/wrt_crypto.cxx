@@ -0,0 +1,230 @@
+/******************************************************************************
+ * wrt_crypto.cxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of WRT SSH crypto profiles, and of the benchmark that picks *
+ * them.                                                                      *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_crypto.hxx>
+#include <wrt_types.hxx>
+#include <wrt_trace.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <exception>
+
+#include <ssh_session.hxx>
+#include <ssh_channel.hxx>
+
+namespace wrt
+{
+
+namespace
+{
+const size_t kChunkSize = 32768;
+
+/**
+ * Seconds since a point in time
+ */
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start).count();
+}
+
+/**
+ * Puts an algorithm at the head of a preference list - the rest stay behind
+ * it, as fallbacks
+ */
+std::string Prefer(const std::string &first, const std::string &list)
+{
+  std::stringstream algorithms(list);
+  std::string preferred(first), algorithm;
+
+  while (std::getline(algorithms, algorithm, ',')) {
+    if (!algorithm.empty() && algorithm != first) {
+      preferred += ',' + algorithm;
+    }
+  }
+
+  return preferred;
+}
+}
+
+/**
+ * Returns the built in profile for a type of AP
+ */
+CryptoProfile CryptoProfile::Default(AccessPoint::Type type)
+{
+  const TypeProfile &profile = types::Profile(type);
+
+  return CryptoProfile { profile.ciphers, profile.kex, profile.macs };
+}
+
+/**
+ * Applies the profile to a session, before it connects
+ */
+void CryptoProfile::apply(ssh::Session &session) const
+{
+  if (!ciphers.empty()) {
+    session.setOption(SSH_OPTIONS_CIPHERS_C_S, ciphers);
+    session.setOption(SSH_OPTIONS_CIPHERS_S_C, ciphers);
+  }
+
+  if (!kex.empty()) {
+    session.setOption(SSH_OPTIONS_KEY_EXCHANGE, kex);
+  }
+
+  if (!macs.empty()) {
+    session.setOption(SSH_OPTIONS_HMAC_C_S, macs);
+    session.setOption(SSH_OPTIONS_HMAC_S_C, macs);
+  }
+}
+
+/**
+ * Returns the profile as arguments to the ssh binary
+ */
+std::vector<std::string> CryptoProfile::getSSHArguments() const
+{
+  std::vector<std::string> arguments;
+
+  if (!ciphers.empty()) {
+    arguments.push_back("-c");
+    arguments.push_back(ciphers);
+  }
+
+  if (!kex.empty()) {
+    arguments.push_back("-o");
+    arguments.push_back("KexAlgorithms=" + kex);
+  }
+
+  if (!macs.empty()) {
+    arguments.push_back("-m");
+    arguments.push_back(macs);
+  }
+
+  return arguments;
+}
+
+/**
+ * Constructor for CryptoBenchmark - takes the function connecting a session
+ * to the AP being measured
+ */
+CryptoBenchmark::CryptoBenchmark(Connector connect)
+  : connect_(connect) {}
+
+/**
+ * Measures a single profile - the best of several rounds
+ */
+CryptoBenchmark::Result CryptoBenchmark::measure(const CryptoProfile &profile,
+                                                 bool bulk)
+{
+  std::string chunk(kChunkSize, '\0');
+  Result best;
+
+  best.profile = profile;
+
+  for (int round = 0; round < rounds_; ++round) {
+    try {
+      ssh::Session session;
+
+      auto start = std::chrono::steady_clock::now();
+      connect_(session, profile);
+      double handshake = SecondsSince(start);
+
+      if (!best.ok() || handshake < best.handshake) {
+        best.handshake = handshake;
+      }
+
+      if (bulk) {
+        Trace::Span traced("channel", "session");
+        ssh::Channel channel(session);
+
+        channel.openSession();
+        channel.requestExec("cat >/dev/null");
+
+        start = std::chrono::steady_clock::now();
+
+        for (size_t sent = 0; sent < bytes_; sent += chunk.size()) {
+          channel.write(chunk.data(), std::min(chunk.size(), bytes_ - sent));
+        }
+
+        channel.sendEof();
+        channel.getExitStatus();
+
+        double throughput = bytes_ / SecondsSince(start);
+
+        if (throughput > best.throughput) {
+          best.throughput = throughput;
+        }
+
+        channel.close();
+      }
+
+      session.disconnect();
+
+    } catch (const std::exception &) {
+      //The AP refused the profile (or went away) - this round is lost
+    }
+  }
+
+  return best;
+}
+
+/**
+ * Finds the fastest profile which worked
+ */
+CryptoProfile CryptoBenchmark::run(const CryptoProfile &base,
+                                   std::vector<Result> *results)
+{
+  CryptoProfile fastest = base;
+  Result best_kex, best_cipher;
+
+  for (auto &kex : kKexCandidates) {
+    CryptoProfile candidate = base;
+    candidate.kex = kex;
+
+    Result result = measure(candidate, false);
+
+    if (results) {
+      results->push_back(result);
+    }
+
+    if (result.ok() &&
+        (!best_kex.ok() || result.handshake < best_kex.handshake)) {
+      best_kex = result;
+    }
+  }
+
+  if (best_kex.ok()) {
+    fastest.kex = Prefer(best_kex.profile.kex, base.kex);
+  }
+
+  for (auto &cipher : kCipherCandidates) {
+    CryptoProfile candidate = fastest;
+    candidate.kex     = best_kex.ok() ? best_kex.profile.kex : base.kex;
+    candidate.ciphers = cipher;
+
+    Result result = measure(candidate, true);
+
+    if (results) {
+      results->push_back(result);
+    }
+
+    if (result.ok() && result.throughput > best_cipher.throughput) {
+      best_cipher = result;
+    }
+  }
+
+  if (best_cipher.ok()) {
+    fastest.ciphers = Prefer(best_cipher.profile.ciphers, base.ciphers);
+  }
+
+  return fastest;
+}
+
+} //namespace wrt
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * wrt_file.cxx                                                               *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of WRT's file replacement. The rename is made durable too,  *
+ * by syncing the directory it was made in.                                   *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_file.hxx>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+namespace wrt
+{
+
+namespace file
+{
+
+/**
+ * Replaces a file with the given contents, at once
+ */
+void Replace(const std::string &path, const char *data, size_t length,
+             mode_t mode, const std::string &suffix)
+{
+  std::string temporary = path + suffix;
+  struct stat info;
+  bool existing = !stat(path.c_str(), &info);
+  int file;
+
+  file = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+              mode);
+
+  if (file == -1) {
+    throw std::runtime_error("open(): cannot open file \"" + temporary + "\"");
+  }
+
+  //The file replaced keeps its mode, whatever the umask
+  if (existing) {
+    fchmod(file, info.st_mode & 07777);
+  }
+
+  const char *next = data;
+  size_t      left = length;
+
+  while (left) {
+    ssize_t written = write(file, next, left);
+
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (written == -1) {
+      close(file);
+      unlink(temporary.c_str());
+
+      throw std::runtime_error("write(): cannot write file \"" +
+                               temporary + "\"");
+    }
+
+    next += written;
+    left -= written;
+  }
+
+  if (fsync(file) == -1 || close(file) == -1 ||
+      rename(temporary.c_str(), path.c_str()) == -1) {
+    unlink(temporary.c_str());
+
+    throw std::runtime_error("rename(): cannot replace file \"" + path + "\"");
+  }
+
+  //Make the rename itself durable
+  std::string directory = path.substr(0, path.rfind('/') + 1);
+  int parent = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+
+  if (parent != -1) {
+    fsync(parent);
+    close(parent);
+  }
+}
+
+}
+
+}
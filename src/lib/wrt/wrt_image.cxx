@@ -0,0 +1,481 @@
+/******************************************************************************
+ * wrt_image.cxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT inventory image. The file is laid out as:        *
+ *                                                                            *
+ *   x. a header - magic, the identity of its sources, the section sizes, and *
+ *      the sources themselves (a newline separated string),                  *
+ *   x. one record per AP - offsets of its strings, and the next record in    *
+ *      its hash bucket,                                                      *
+ *   x. a power of two number of buckets, each the first record hashed there, *
+ *   x. the strings, each NUL terminated, and each stored once.               *
+ *                                                                            *
+ * Record and bucket links are stored plus one, so that zero ends a chain.    *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_image.hxx>
+#include <wrt_file.hxx>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace wrt
+{
+
+namespace
+{
+const char kMagic[8] = { 'W', 'R', 'T', 'I', 'N', 'V', '2', '\0' };
+}
+
+struct InventoryImage::Header
+{
+  char     magic[8];
+  uint64_t device;
+  uint64_t inode;
+  int64_t  size;
+  int64_t  modified;
+  int64_t  nanos;
+  uint32_t count;
+  uint32_t buckets;
+  uint32_t strings;
+  uint32_t sources;
+};
+
+struct InventoryImage::Record
+{
+  uint32_t name;
+  uint32_t type;
+  uint32_t mac;
+  uint32_t ipv4;
+  uint32_t ipv6;
+  uint32_t origin;
+  uint32_t next;
+};
+
+/**
+ * Compares two file identities
+ */
+bool InventoryImage::Stamp::operator == (const Stamp &other) const
+{
+  return device == other.device && inode == other.inode &&
+         size == other.size && modified == other.modified &&
+         nanos == other.nanos;
+}
+
+/**
+ * Folds the identity of another file into this one. A file which does not
+ * exist still changes the result, so files coming and going are noticed.
+ */
+InventoryImage::Stamp &InventoryImage::Stamp::fold(const Stamp &other)
+{
+  const uint64_t kPrime = 1099511628211ULL;
+
+  device   = (device * kPrime) ^ other.device;
+  inode    = (inode * kPrime) ^ other.inode;
+  modified = static_cast<int64_t>((static_cast<uint64_t>(modified) * kPrime) ^
+                                  static_cast<uint64_t>(other.modified));
+  nanos    = static_cast<int64_t>((static_cast<uint64_t>(nanos) * kPrime) ^
+                                  static_cast<uint64_t>(other.nanos));
+
+  //Size stays -1 only if the first file is missing
+  if (size >= 0) {
+    size = static_cast<int64_t>(((static_cast<uint64_t>(size) * kPrime) ^
+                                 static_cast<uint64_t>(other.size + 1)) &
+                                0x7FFFFFFFFFFFFFFFULL);
+  }
+
+  return *this;
+}
+
+/**
+ * Returns the identity of a file (size -1 if it does not exist)
+ */
+InventoryImage::Stamp InventoryImage::Stamp::Of(const std::string &path)
+{
+  struct stat info;
+  Stamp stamp;
+
+  if (!stat(path.c_str(), &info)) {
+    stamp.device   = info.st_dev;
+    stamp.inode    = info.st_ino;
+    stamp.size     = info.st_size;
+    stamp.modified = info.st_mtim.tv_sec;
+    stamp.nanos    = info.st_mtim.tv_nsec;
+  }
+
+  return stamp;
+}
+
+/**
+ * Returns the identity of a set of files, folded in order
+ */
+InventoryImage::Stamp InventoryImage::Stamp::Of(
+  const std::vector<std::string> &paths)
+{
+  Stamp stamp;
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!i) {
+      stamp = Of(paths[i]);
+    } else {
+      stamp.fold(Of(paths[i]));
+    }
+  }
+
+  return stamp;
+}
+
+/**
+ * Returns the AP as an AccessPoint
+ */
+AccessPoint InventoryImage::View::toAccessPoint() const
+{
+  AccessPoint AP(name, mac, type);
+
+  AP.setIPv4(ipv4);
+  AP.setIPv6(ipv6);
+
+  return AP;
+}
+
+/**
+ * Constructor for InventoryImage - takes the path of the image
+ */
+InventoryImage::InventoryImage(std::string path)
+  : path_(path) {}
+
+InventoryImage::~InventoryImage()
+{
+  close();
+}
+
+/**
+ * Maps the image, if the files it was compiled from are unchanged
+ */
+bool InventoryImage::open()
+{
+  return map(nullptr);
+}
+
+/**
+ * Maps the image, if it was compiled from files with the identity given
+ */
+bool InventoryImage::open(const Stamp &source)
+{
+  return map(&source);
+}
+
+/**
+ * Maps and checks the image - against the identity given or, if none is, the
+ * identity its sources have now
+ */
+bool InventoryImage::map(const Stamp *source)
+{
+  struct stat info;
+  int file;
+
+  close();
+
+  if (source && source->size < 0) {
+    return false;
+  }
+
+  if ((file = ::open(path_.c_str(), O_RDONLY)) == -1) {
+    return false;
+  }
+
+  if (fstat(file, &info) || info.st_size < (off_t) sizeof(Header)) {
+    ::close(file);
+    return false;
+  }
+
+  length_ = info.st_size;
+  map_    = mmap(NULL, length_, PROT_READ, MAP_SHARED, file, 0);
+  ::close(file);
+
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    length_ = 0;
+    return false;
+  }
+
+  const Header *header = static_cast<const Header *>(map_);
+  Stamp compiled;
+
+  compiled.device   = header->device;
+  compiled.inode    = header->inode;
+  compiled.size     = header->size;
+  compiled.modified = header->modified;
+  compiled.nanos    = header->nanos;
+
+  //Refuse anything which is not exactly an image this code wrote
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) ||
+      !header->buckets || !header->strings ||
+      (header->buckets & (header->buckets - 1)) ||
+      length_ != sizeof(Header) + header->count * sizeof(Record) +
+                 header->buckets * sizeof(uint32_t) + header->strings) {
+    close();
+    return false;
+  }
+
+  const Record   *records = reinterpret_cast<const Record *>(header + 1);
+  const uint32_t *buckets = reinterpret_cast<const uint32_t *>(records +
+                                                               header->count);
+  const char     *strings = reinterpret_cast<const char *>(buckets +
+                                                           header->buckets);
+
+  if (strings[header->strings - 1] || header->sources >= header->strings) {
+    close();
+    return false;
+  }
+
+  //...nor anything stale
+  if (!source) {
+    std::vector<std::string> sources;
+    std::string list(strings + header->sources);
+    size_t start = 0, end;
+
+    while ((end = list.find('\n', start)) != std::string::npos) {
+      sources.push_back(list.substr(start, end - start));
+      start = end + 1;
+    }
+
+    sources.push_back(list.substr(start));
+
+    if (!(compiled == Stamp::Of(sources))) {
+      close();
+      return false;
+    }
+
+  } else if (!(compiled == *source)) {
+    close();
+    return false;
+  }
+
+  //A bad offset or link would otherwise be followed out of the mapping
+  for (size_t i = 0; i < header->count; ++i) {
+    const Record &record = records[i];
+
+    if (record.name >= header->strings || record.type >= header->strings ||
+        record.mac  >= header->strings || record.ipv4 >= header->strings ||
+        record.ipv6 >= header->strings || record.origin >= header->strings ||
+        record.next > header->count) {
+      close();
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < header->buckets; ++i) {
+    if (buckets[i] > header->count) {
+      close();
+      return false;
+    }
+  }
+
+  header_  = header;
+  records_ = records;
+  buckets_ = buckets;
+  strings_ = strings;
+
+  return true;
+}
+
+/**
+ * Unmaps the image
+ */
+void InventoryImage::close()
+{
+  if (map_) {
+    munmap(map_, length_);
+  }
+
+  map_     = nullptr;
+  length_  = 0;
+  header_  = nullptr;
+  records_ = nullptr;
+  buckets_ = nullptr;
+  strings_ = nullptr;
+}
+
+/**
+ * Returns the number of APs in the image
+ */
+size_t InventoryImage::size() const
+{
+  return header_ ? header_->count : 0;
+}
+
+/**
+ * Returns an AP by its position in the image
+ */
+InventoryImage::View InventoryImage::get(size_t index) const
+{
+  const Record &record = records_[index];
+  View view;
+
+  view.name = strings_ + record.name;
+  view.type = strings_ + record.type;
+  view.mac  = strings_ + record.mac;
+  view.ipv4 = strings_ + record.ipv4;
+  view.ipv6 = strings_ + record.ipv6;
+  view.origin = strings_ + record.origin;
+
+  return view;
+}
+
+/**
+ * Finds an AP by name, without reading any other
+ */
+bool InventoryImage::find(const std::string &name, View &view) const
+{
+  if (!header_) {
+    return false;
+  }
+
+  uint32_t link = buckets_[Hash(name.data(), name.size()) &
+                           (header_->buckets - 1)];
+
+  //Chains are bounded by the record count, however the links were written
+  for (size_t hops = 0; link && hops < header_->count; ++hops) {
+    const Record &record = records_[link - 1];
+
+    if (name == strings_ + record.name) {
+      view = get(link - 1);
+      return true;
+    }
+
+    link = record.next;
+  }
+
+  return false;
+}
+
+/**
+ * Compiles an image of a list of APs, atomically replacing any image
+ */
+void InventoryImage::Write(const std::string &path,
+                           const std::vector<std::string> &sources,
+                           const Stamp &source,
+                           APList &APs,
+                           const Origins &origins)
+{
+  std::unordered_map<std::string, uint32_t> interned;
+  std::vector<Record> records;
+  std::string strings(1, '\0');
+  std::string list;
+  uint32_t buckets = 16;
+
+  //Store each distinct string once - types, at least, repeat a great deal
+  auto intern = [&interned, &strings](const std::string &value) -> uint32_t {
+    auto found = interned.find(value);
+
+    if (found != interned.end()) {
+      return found->second;
+    }
+
+    uint32_t offset = strings.size();
+
+    strings.append(value);
+    strings.push_back('\0');
+
+    return interned[value] = offset;
+  };
+
+  interned[std::string()] = 0;
+
+  //Record the files read, so open() can tell whether any has since changed
+  for (auto &file : sources) {
+    list += (list.empty() ? "" : "\n") + file;
+  }
+
+  uint32_t recorded = intern(list);
+
+  for (auto &entry : APs) {
+    AccessPoint &AP = entry.second;
+    auto origin = origins.find(entry.first);
+    Record record;
+
+    record.name = intern(AP.getName());
+    record.type = intern(AP.getType());
+    record.mac  = intern(AP.getMAC());
+    record.ipv4 = intern(AP.getIPv4());
+    record.ipv6 = intern(AP.getIPv6());
+    record.origin = origin == origins.end() ? 0 : intern(origin->second);
+    record.next = 0;
+
+    records.push_back(record);
+  }
+
+  while (buckets < records.size()) {
+    buckets <<= 1;
+  }
+
+  std::vector<uint32_t> heads(buckets, 0);
+
+  for (size_t i = 0; i < records.size(); ++i) {
+    const char *name  = strings.data() + records[i].name;
+    uint32_t   bucket = Hash(name, strlen(name)) & (buckets - 1);
+
+    records[i].next = heads[bucket];
+    heads[bucket]   = i + 1;
+  }
+
+  Header header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.device   = source.device;
+  header.inode    = source.inode;
+  header.size     = source.size;
+  header.modified = source.modified;
+  header.nanos    = source.nanos;
+  header.count    = records.size();
+  header.buckets  = buckets;
+  header.strings  = strings.size();
+  header.sources  = recorded;
+
+  std::vector<char> image(sizeof(Header) + records.size() * sizeof(Record) +
+                          buckets * sizeof(uint32_t) + strings.size());
+  char *cursor = image.data();
+
+  memcpy(cursor, &header, sizeof(header));
+  cursor += sizeof(header);
+  memcpy(cursor, records.data(), records.size() * sizeof(Record));
+  cursor += records.size() * sizeof(Record);
+  memcpy(cursor, heads.data(), buckets * sizeof(uint32_t));
+  cursor += buckets * sizeof(uint32_t);
+  memcpy(cursor, strings.data(), strings.size());
+
+  //Two processes may both find the image stale - each writes its own file
+  file::Replace(path, image.data(), image.size(),
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH,
+                ".tmp." + std::to_string(getpid()));
+}
+
+/**
+ * Hashes an AP name into a bucket (FNV-1a)
+ */
+uint32_t InventoryImage::Hash(const char *name, size_t length)
+{
+  uint32_t hash = 2166136261U;
+
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619U;
+  }
+
+  return hash;
+}
+
+} //namespace wrt
@@ -0,0 +1,272 @@
+/******************************************************************************
+ * wrt_inventory.cxx                                                          *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT inventory. APs are stored by name; the MAC and   *
+ * address indexes map back to that name.                                     *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_inventory.hxx>
+#include <wrt_mac.hxx>
+
+#include <cctype>
+#include <unordered_set>
+
+namespace wrt
+{
+
+namespace
+{
+/**
+ * A key is free if nothing holds it, or its holder is being removed
+ */
+template <typename Key>
+bool Taken(const std::unordered_map<Key, std::string> &index, const Key &key,
+           const std::unordered_set<std::string> &removed)
+{
+  auto holder = index.find(key);
+  return holder != index.end() && !removed.count(holder->second);
+}
+}
+
+/**
+ * Queues an AP to be added
+ */
+void Inventory::Batch::add(AccessPoint AP)
+{
+  added_.push_back(AP);
+}
+
+/**
+ * Queues an AP to be removed
+ */
+void Inventory::Batch::remove(std::string key)
+{
+  removed_.push_back(key);
+}
+
+/**
+ * Adds an AP as it is loaded from the configuration
+ */
+bool Inventory::insert(AccessPoint AP)
+{
+  std::string name = AP.getName();
+
+  if (aps_.count(name) || (AP.hasMAC() && macs_.count(AP.getMACValue()))) {
+    return false;
+  }
+
+  for (auto &address : AP.getAddresses()) {
+    if (addresses_.count(address)) {
+      return false;
+    }
+  }
+
+  index(aps_[name] = AP);
+
+  return true;
+}
+
+/**
+ * Finds a managed AP by name, MAC or address
+ */
+AccessPoint *Inventory::find(const std::string &key)
+{
+  std::string name = resolve(key);
+
+  if (name.empty()) {
+    return nullptr;
+  }
+
+  return &aps_.find(name)->second;
+}
+
+/**
+ * Checks a batch against the inventory, and against itself
+ */
+std::vector<std::string> Inventory::validate(const Batch &batch) const
+{
+  std::unordered_set<std::string> removed, names, addresses;
+  std::unordered_set<uint64_t> macs;
+  std::vector<std::string> conflicts;
+
+  for (auto &key : batch.removed_) {
+    std::string name = resolve(key);
+
+    if (name.empty()) {
+      conflicts.push_back('"' + key + "\" is not managed");
+    } else {
+      removed.insert(name);
+    }
+  }
+
+  for (auto &AP : batch.added_) {
+    const std::string &name = AP.getName();
+    uint64_t mac = AP.getMACValue();
+
+    if ((aps_.count(name) && !removed.count(name)) ||
+        !names.insert(name).second) {
+      conflicts.push_back('"' + name + "\" already exists");
+      continue;
+    }
+
+    if (AP.hasMAC() &&
+        (Taken(macs_, mac, removed) || !macs.insert(mac).second)) {
+      conflicts.push_back('"' + name + "\": MAC " + AP.getMAC() +
+                          " already managed");
+      continue;
+    }
+
+    for (auto &address : AP.getAddresses()) {
+      if (Taken(addresses_, address, removed) ||
+          !addresses.insert(address).second) {
+        conflicts.push_back('"' + name + "\": address " + address +
+                            " already managed");
+        break;
+      }
+    }
+  }
+
+  return conflicts;
+}
+
+/**
+ * Applies a batch - nothing is applied unless the whole batch is valid
+ */
+std::vector<std::string> Inventory::apply(const Batch &batch)
+{
+  std::vector<std::string> conflicts = validate(batch);
+
+  if (!conflicts.empty()) {
+    return conflicts;
+  }
+
+  for (auto &key : batch.removed_) {
+    std::string name = resolve(key);
+
+    //Two keys in the batch may name the same AP
+    if (name.empty()) {
+      continue;
+    }
+
+    unindex(aps_.find(name)->second);
+    aps_.erase(name);
+  }
+
+  for (auto &AP : batch.added_) {
+    index(aps_[AP.getName()] = AP);
+  }
+
+  return conflicts;
+}
+
+/**
+ * Returns the batch which turns this inventory into another
+ */
+Inventory::Batch Inventory::diff(const Inventory &other) const
+{
+  Batch batch;
+
+  for (auto &entry : aps_) {
+    auto fresh = other.aps_.find(entry.first);
+
+    if (fresh == other.aps_.end() || !fresh->second.identical(entry.second)) {
+      batch.remove(entry.first);
+    }
+  }
+
+  for (auto &entry : other.aps_) {
+    auto live = aps_.find(entry.first);
+
+    if (live == aps_.end() || !live->second.identical(entry.second)) {
+      batch.add(entry.second);
+    }
+  }
+
+  return batch;
+}
+
+/**
+ * Returns the form a MAC is indexed under (upper case, colon separated)
+ */
+std::string Inventory::MACKey(std::string mac)
+{
+  char canonical[mac::kLength + 1];
+  uint64_t value;
+
+  if (mac::Parse(mac, value)) {
+    return mac::Format(value, canonical);
+  }
+
+  for (auto &c : mac) {
+    c = (c == '-') ? ':' : std::toupper(c);
+  }
+
+  return mac;
+}
+
+/**
+ * Returns the name of the AP a key (name, MAC or address) refers to
+ */
+std::string Inventory::resolve(const std::string &key) const
+{
+  if (aps_.count(key)) {
+    return key;
+  }
+
+  uint64_t value;
+
+  if (AccessPoint::ParseMAC(key, value)) {
+    auto mac = macs_.find(value);
+
+    if (mac != macs_.end()) {
+      return mac->second;
+    }
+  }
+
+  auto address = addresses_.find(key);
+
+  if (address != addresses_.end()) {
+    return address->second;
+  }
+
+  return std::string();
+}
+
+/**
+ * Adds an AP to the MAC and address indexes
+ */
+void Inventory::index(AccessPoint &AP)
+{
+  revision_++;
+
+  const std::string &name = AP.getName();
+
+  if (AP.hasMAC()) {
+    macs_[AP.getMACValue()] = name;
+  }
+
+  for (auto &address : AP.getAddresses()) {
+    addresses_[address] = name;
+  }
+}
+
+/**
+ * Drops an AP from the MAC and address indexes
+ */
+void Inventory::unindex(AccessPoint &AP)
+{
+  revision_++;
+
+  if (AP.hasMAC()) {
+    macs_.erase(AP.getMACValue());
+  }
+
+  for (auto &address : AP.getAddresses()) {
+    addresses_.erase(address);
+  }
+}
+
+} //namespace wrt
@@ -11,9 +11,35 @@
 
 #include <wrt_io.hxx>
 
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <ctime>
+
 namespace wrt {
 
 Output::Verbosity OutputLevel(Output::Verbosity::kDefault);
+Output::Verbosity LogLevel(Output::Verbosity::kDefault);
+
+const size_t VerbosityBuffer::kBufferSize;
+
+const size_t   LogRing::kRecordSize;
+const size_t   LogSink::kDefaultRecords;
+const unsigned LogSink::kPollInterval;
+const size_t   SyslogSink::kDefaultRecords;
+const unsigned SyslogSink::kPollInterval;
+const unsigned SyslogSink::kWindow;
+const unsigned SyslogSink::kBurst;
+const unsigned SyslogSink::kRate;
+const size_t   Syslog::kBufferSize;
+
+std::atomic<LogSink *>    FileLog::sink_(nullptr);
+std::atomic<SyslogSink *> Syslog::sink_(nullptr);
 
 std::string Output::EnumToString(Output::Verbosity v) {
   switch(v) {
@@ -47,47 +73,70 @@ std::string Output::EnumToString(Output::Verbosity v) {
   return std::string("Default case! IMPOSSIBLE!");
 }
 
-Syslog::Syslog(std::string ident, int facility) {
-  syslog_facility_ = facility;
-  syslog_priority_ = Syslog::LogLevel::kSyslogInfo;
-
+std::ostream& operator<< (std::ostream& os, const Syslog::LogLevel& l) {
+  static_cast<Syslog *>(os.rdbuf())->syslog_priority_ = l;
 
-  strncpy(syslog_ident_, ident.c_str(), sizeof(syslog_ident_));
-  syslog_ident_[sizeof(syslog_ident_) - 1] = '\0';
+  return os;
+}
 
-  openlog(syslog_ident_, LOG_PID, syslog_facility_);
+VerbosityBuffer::VerbosityBuffer(Output::Verbosity v)
+  : buffer_verbosity_(v) {
+  setp(buffer_, buffer_ + kBufferSize);
 }
 
-int Syslog::sync() {
-  if (buffer_.length()) {
-    syslog((int)syslog_priority_, buffer_.c_str());
-    buffer_.erase();
+VerbosityBuffer::~VerbosityBuffer() {
+  sync();
+}
 
-    // default to debug for each message
-    syslog_priority_ = LogLevel::kSyslogInfo;
+int VerbosityBuffer::overflow(int c) {
+  if (!drain()) {
+    return EOF;
   }
-  
-  return 0;
-}
 
-int Syslog::overflow(int c = EOF) {
   if (c != EOF) {
-    buffer_ += static_cast<char>(c);
-  } else {
-    sync();
+    *pptr() = static_cast<char>(c);
+    pbump(1);
   }
-    
-  return c;
+
+  return c == EOF ? 0 : c;
 }
 
-std::ostream& operator<< (std::ostream& os, const Syslog::LogLevel& l) {
-  static_cast<Syslog *>(os.rdbuf())->syslog_priority_ = l;
+int VerbosityBuffer::sync() {
+  return drain() ? 0 : -1;
+}
 
-  return os;
+/**
+ * Writes the put area to stdout - it only ever holds output that is to be
+ * written, as the verbosity was checked on the way in
+ */
+bool VerbosityBuffer::drain() {
+  size_t length = pptr() - pbase();
+
+  setp(buffer_, buffer_ + kBufferSize);
+
+  return !length || emit(buffer_, length);
+}
+
+bool VerbosityBuffer::emits(Output::Verbosity v) const {
+  return Output::Emits(v);
+}
+
+bool VerbosityBuffer::emit(const char *data, size_t length) {
+  return fwrite(data, 1, length, stdout) == length;
 }
 
 std::ostream& operator<< (std::ostream& os, const Output::Verbosity& v) {
-  static_cast<VerbosityBuffer *>(os.rdbuf())->buffer_verbosity_ = v;
+  VerbosityBuffer *buffer = static_cast<VerbosityBuffer *>(os.rdbuf());
+
+  buffer->buffer_verbosity_ = v;
+
+  //A bad stream formats nothing - so output which is not written costs no
+  //more than this check
+  if (buffer->emits(v)) {
+    os.clear();
+  } else {
+    os.setstate(std::ios::badbit);
+  }
 
   return os;
 }
@@ -108,4 +157,507 @@ Output::Verbosity operator++ (Output::Verbosity& v, int) {
   return old;
 }
 
+
+/**
+ * Constructor for LogRing - a slot is free when its sequence is the position
+ * it is next to be claimed at
+ */
+LogRing::LogRing(size_t records) : head_(0), dropped_(0) {
+  size_t size = 1;
+
+  while (size < records) {
+    size <<= 1;
+  }
+
+  records_.reset(new Record[size]);
+  mask_ = size - 1;
+
+  for (size_t i = 0; i < size; ++i) {
+    records_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Queues a record. A record longer than a slot takes several in a row,
+ * claimed with a single compare and swap, so no other record can come
+ * between its parts. The producer which wins the positions fills the slots,
+ * then hands them to the consumer by moving each sequence on one - the first
+ * last, so the consumer never sees a record before all of it is there.
+ */
+bool LogRing::push(const char *data, size_t length, int tag) {
+  time_t now = time(NULL);
+  size_t parts = length ? (length + kRecordSize - 1) / kRecordSize : 0,
+         position;
+
+  if (parts > mask_ + 1) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  if (!parts) {
+    return true;
+  }
+
+  position = head_.load(std::memory_order_relaxed);
+
+  for (;;) {
+    intptr_t lag = 0;
+
+    //Every slot must be free - the consumer past it - for a claim to hold
+    for (size_t i = 0; i < parts && !lag; ++i) {
+      size_t sequence = records_[(position + i) & mask_].sequence.load(
+                          std::memory_order_acquire);
+
+      lag = static_cast<intptr_t>(sequence) -
+            static_cast<intptr_t>(position + i);
+    }
+
+    if (!lag) {
+      if (head_.compare_exchange_weak(position, position + parts,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+
+    } else if (lag < 0) {
+      //The consumer has not reached these slots since it last went round
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+
+    } else {
+      position = head_.load(std::memory_order_relaxed);
+    }
+  }
+
+  for (size_t i = parts; i-- > 0;) {
+    Record &record = records_[(position + i) & mask_];
+    size_t offset  = i * kRecordSize,
+           part    = std::min(length - offset, kRecordSize);
+
+    record.time   = now;
+    record.tag    = tag;
+    record.length = part;
+    memcpy(record.text, data + offset, part);
+    record.sequence.store(position + i + 1, std::memory_order_release);
+  }
+
+  return true;
+}
+
+/**
+ * Returns the oldest record queued, if it has been filled
+ */
+const LogRing::Record *LogRing::front() {
+  Record &record = records_[tail_ & mask_];
+
+  if (record.sequence.load(std::memory_order_acquire) != tail_ + 1) {
+    return nullptr;
+  }
+
+  return &record;
+}
+
+/**
+ * Frees the front slot - for its next claim, once the ring has gone round
+ */
+void LogRing::pop() {
+  records_[tail_ & mask_].sequence.store(tail_ + mask_ + 1,
+                                         std::memory_order_release);
+  tail_++;
+}
+
+/**
+ * Constructor for LogSink - opens the file, and starts the writer
+ */
+LogSink::LogSink(std::string path, Rotation rotation, size_t records)
+  : path_(path), rotation_(rotation), ring_(records), running_(true) {
+  open();
+
+  writer_ = std::thread(&LogSink::run, this);
+}
+
+/**
+ * Destructor for LogSink - writes out every record, and stops the writer
+ */
+LogSink::~LogSink() {
+  running_.store(false);
+  writer_.join();
+
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+/**
+ * The writer - collects whatever records are queued, and writes them at
+ * once; sleeps only when there are none
+ */
+void LogSink::run() {
+  std::string batch;
+
+  batch.reserve(LogRing::kRecordSize * 64);
+
+  for (;;) {
+    bool stopping = !running_.load();
+
+    if (collect(batch)) {
+      write(batch);
+      batch.clear();
+
+    } else if (stopping) {
+      return;
+
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kPollInterval));
+    }
+
+    //Rotation by time does not wait on a record to come along
+    if (rotation_.interval && written_ &&
+        time(NULL) - started_ >= rotation_.interval) {
+      rotate();
+    }
+  }
+}
+
+/**
+ * Moves the queued records into a batch, each stamped with its time
+ */
+bool LogSink::collect(std::string &batch) {
+  char stamp[32];
+  time_t stamped = -1;
+  size_t prefix = 0;
+
+  const LogRing::Record *next;
+
+  while ((next = ring_.front())) {
+    const LogRing::Record &record = *next;
+
+    //A record continuing the last line is not stamped again
+    if (batch.empty() || batch.back() == '\n') {
+      if (record.time != stamped) {
+        struct tm local;
+
+        localtime_r(&record.time, &local);
+        prefix  = strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S ",
+                           &local);
+        stamped = record.time;
+      }
+
+      batch.append(stamp, prefix);
+    }
+
+    batch.append(record.text, record.length);
+    ring_.pop();
+
+    if (batch.size() >= LogRing::kRecordSize * 64) {
+      break;
+    }
+  }
+
+  return !batch.empty();
+}
+
+/**
+ * Writes a batch to the file, rotating it first if it is full
+ */
+void LogSink::write(const std::string &batch) {
+  if (rotation_.max_size && written_ &&
+      written_ + batch.size() > rotation_.max_size) {
+    rotate();
+  }
+
+  const char *data = batch.data();
+  size_t      left = batch.size();
+
+  if (!written_) {
+    started_ = time(NULL);
+  }
+
+  while (left && fd_ != -1) {
+    ssize_t written = ::write(fd_, data, left);
+
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+
+    //Nowhere to report it - the records are lost
+    if (written == -1) {
+      break;
+    }
+
+    data     += written;
+    left     -= written;
+    written_ += written;
+  }
+}
+
+/**
+ * Opens the file for appending, carrying on from its size and its age - a
+ * run far shorter than the interval still rotates a file once it is due
+ */
+void LogSink::open() {
+  struct stat status;
+
+  fd_ = ::open(path_.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+               S_IRUSR | S_IWUSR | S_IRGRP);
+
+  written_ = fd_ != -1 && !fstat(fd_, &status) ? status.st_size : 0;
+  started_ = written_ ? age(status.st_mtime) : time(NULL);
+}
+
+/**
+ * Returns when the file's first record was written, read from its stamp -
+ * the file's last change if it does not start with one
+ */
+time_t LogSink::age(time_t changed) {
+  char stamp[32] = {};
+  struct tm local = {};
+  int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd != -1) {
+    ssize_t got = pread(fd, stamp, sizeof(stamp) - 1, 0);
+
+    ::close(fd);
+
+    if (got > 0 && strptime(stamp, "%Y-%m-%d %H:%M:%S ", &local)) {
+      local.tm_isdst = -1;
+
+      time_t started = mktime(&local);
+
+      if (started != -1) {
+        return started;
+      }
+    }
+  }
+
+  return changed;
+}
+
+/**
+ * Moves path to path.1, path.1 to path.2 and so on - dropping path.keep -
+ * and opens path afresh
+ */
+void LogSink::rotate() {
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+
+  for (unsigned i = rotation_.keep; i > 0; --i) {
+    std::string from = i > 1 ? path_ + "." + std::to_string(i - 1) : path_;
+
+    rename(from.c_str(), (path_ + "." + std::to_string(i)).c_str());
+  }
+
+  if (!rotation_.keep) {
+    unlink(path_.c_str());
+  }
+
+  open();
+}
+
+FileLog::~FileLog() {
+  sync();
+}
+
+void FileLog::Open(std::string path, LogSink::Rotation rotation) {
+  delete sink_.exchange(new LogSink(path, rotation));
+}
+
+void FileLog::Close() {
+  delete sink_.exchange(nullptr);
+}
+
+bool FileLog::emits(Output::Verbosity v) const {
+  return static_cast<int>(LogLevel) >= static_cast<int>(v);
+}
+
+bool FileLog::emit(const char *data, size_t length) {
+  LogSink *sink = sink_.load();
+
+  if (sink) {
+    sink->push(data, length);
+  }
+
+  return true;
+}
+
+
+/**
+ * Constructor for SyslogSink - opens syslog, and starts the writer
+ */
+SyslogSink::SyslogSink(std::string ident, int facility, size_t records)
+  : ident_(ident), ring_(records), running_(true), window_(time(NULL)) {
+  openlog(ident_.c_str(), LOG_PID, facility);
+
+  writer_ = std::thread(&SyslogSink::run, this);
+}
+
+/**
+ * Destructor for SyslogSink - passes on every message queued, sums up those
+ * held back, and closes syslog
+ */
+SyslogSink::~SyslogSink() {
+  running_.store(false);
+  writer_.join();
+
+  summarize();
+  closelog();
+}
+
+/**
+ * Queues a message, cut to a single record
+ */
+bool SyslogSink::push(int priority, const char *data, size_t length) {
+  return ring_.push(data, std::min(length, LogRing::kRecordSize), priority);
+}
+
+/**
+ * Returns the kind of a message
+ */
+std::string SyslogSink::Shape(const char *data, size_t length) {
+  std::string shape;
+  bool quoted = false;
+
+  shape.reserve(length);
+
+  for (size_t i = 0; i < length; ++i) {
+    char c = data[i];
+
+    if (c == '"') {
+      quoted = !quoted;
+      shape += c;
+
+    } else if (quoted) {
+      continue;
+
+    } else if (isdigit(static_cast<unsigned char>(c))) {
+      if (shape.empty() || shape.back() != '#') {
+        shape += '#';
+      }
+
+    } else {
+      shape += c;
+    }
+  }
+
+  return shape;
+}
+
+/**
+ * The writer - passes on each message queued, unless its kind has had its
+ * burst (or the window its rate), and sums up each window as it ends
+ */
+void SyslogSink::run() {
+  for (;;) {
+    bool stopping = !running_.load();
+    const LogRing::Record *record = ring_.front();
+
+    if (time(NULL) - window_ >= static_cast<time_t>(kWindow)) {
+      summarize();
+    }
+
+    if (record) {
+      forward(*record);
+      ring_.pop();
+
+    } else if (stopping) {
+      return;
+
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(kPollInterval));
+    }
+  }
+}
+
+/**
+ * Passes a message on to syslog - or counts it against its kind
+ */
+void SyslogSink::forward(const LogRing::Record &record) {
+  std::string text(record.text, record.length);
+  Similar &similar = similar_[Shape(record.text, record.length)];
+
+  if (similar.passed < kBurst && sent_ < kRate) {
+    syslog(record.tag, "%s", text.c_str());
+
+    similar.passed++;
+    sent_++;
+
+  } else {
+    similar.priority = record.tag;
+    similar.suppressed++;
+    similar.last.swap(text);
+  }
+}
+
+/**
+ * Sums up each kind of message held back this window, and starts the next
+ */
+void SyslogSink::summarize() {
+  for (auto &kind : similar_) {
+    Similar &similar = kind.second;
+
+    if (similar.suppressed) {
+      syslog(similar.priority, "%u similar messages suppressed, the last: %s",
+             similar.suppressed, similar.last.c_str());
+    }
+  }
+
+  similar_.clear();
+  sent_   = 0;
+  window_ = time(NULL);
+}
+
+Syslog::Syslog() : syslog_priority_(LogLevel::kSyslogInfo) {
+  setp(buffer_, buffer_ + kBufferSize);
+}
+
+Syslog::~Syslog() {
+  sync();
+}
+
+void Syslog::Open(std::string ident, int facility) {
+  delete sink_.exchange(new SyslogSink(ident, facility));
+}
+
+void Syslog::Close() {
+  delete sink_.exchange(nullptr);
+}
+
+int Syslog::sync() {
+  send();
+
+  //Each message is LOG_INFO unless it says otherwise
+  syslog_priority_ = LogLevel::kSyslogInfo;
+
+  return 0;
+}
+
+int Syslog::overflow(int c) {
+  //A message longer than the buffer is sent in pieces
+  send();
+
+  if (c != EOF) {
+    *pptr() = static_cast<char>(c);
+    pbump(1);
+  }
+
+  return c == EOF ? 0 : c;
+}
+
+/**
+ * Queues what the put area holds as a message, less trailing newlines
+ */
+bool Syslog::send() {
+  SyslogSink *sink = sink_.load();
+  size_t length = pptr() - pbase();
+
+  setp(buffer_, buffer_ + kBufferSize);
+
+  while (length && buffer_[length - 1] == '\n') {
+    length--;
+  }
+
+  return !length || !sink ||
+         sink->push(static_cast<int>(syslog_priority_), buffer_, length);
+}
+
 }
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * wrt_keyscan.cxx                                                            *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT host key scanner. Every (host, key type) pair is *
+ * a job; worker threads pull jobs off a shared counter, so a slow AP only    *
+ * ever holds up a single worker.                                             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_keyscan.hxx>
+#include <wrt_trace.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include <ssh_session.hxx>
+#include <ssh_keys.hxx>
+
+namespace wrt
+{
+
+/**
+ * Constructor for KeyScanner - takes the number of scans to run at once
+ */
+KeyScanner::KeyScanner(int concurrency)
+  : concurrency_(concurrency > 0 ? concurrency : 1) {}
+
+/**
+ * Queues a host to be scanned
+ */
+void KeyScanner::add(std::string host)
+{
+  hosts_.push_back(host);
+}
+
+/**
+ * Scans every queued host for every key type, several hosts at a time
+ */
+std::vector<KeyScanner::HostKey> KeyScanner::scan()
+{
+  std::vector<HostKey> results(hosts_.size() * key_types_.size());
+  std::vector<std::thread> workers;
+  std::atomic<size_t> next(0);
+
+  auto worker = [&]() {
+    size_t job;
+
+    Trace::NameThread("keyscan");
+
+    while ((job = next++) < results.size()) {
+      results[job] = scanOne(hosts_[job / key_types_.size()],
+                             key_types_[job % key_types_.size()]);
+    }
+  };
+
+  size_t threads = std::min(results.size(),
+                            static_cast<size_t>(concurrency_));
+
+  //Once, before any worker opens a session
+  ssh::Session::Initialize();
+
+  for (size_t i = 0; i < threads; ++i) {
+    workers.push_back(std::thread(worker));
+  }
+
+  for (auto &thread : workers) {
+    thread.join();
+  }
+
+  //Keep what each host offered, or a single failure for hosts offering none
+  std::vector<HostKey> collected;
+
+  for (size_t host = 0; host < hosts_.size(); ++host) {
+    const HostKey *failure = nullptr;
+    bool any = false;
+
+    for (size_t type = 0; type < key_types_.size(); ++type) {
+      const HostKey &result = results[host * key_types_.size() + type];
+
+      if (result.ok()) {
+        collected.push_back(result);
+        any = true;
+
+      } else if (!failure) {
+        failure = &result;
+      }
+    }
+
+    if (!any && failure) {
+      collected.push_back(*failure);
+    }
+  }
+
+  hosts_.clear();
+
+  return collected;
+}
+
+/**
+ * Performs a single key exchange, offering only the given host key type
+ */
+KeyScanner::HostKey KeyScanner::scanOne(const std::string &host,
+                                        const std::string &type)
+{
+  Trace::Span traced("keyscan", "session", host);
+  HostKey result;
+
+  result.host = host;
+  result.type = type;
+
+  try {
+    ssh::Session session;
+
+    session.setOption(SSH_OPTIONS_HOST, host);
+    session.setOption(SSH_OPTIONS_TIMEOUT, timeout_);
+    session.setOption(SSH_OPTIONS_HOSTKEYS, type);
+    session.connect();
+
+    ssh::Key key(session);
+
+    result.type = key.getType();
+    result.key  = key.getBase64();
+
+    session.disconnect();
+
+  } catch (const std::exception &e) {
+    result.error = e.what();
+
+    if (result.error.empty()) {
+      result.error = "key exchange failed";
+    }
+  }
+
+  return result;
+}
+
+} //namespace wrt
@@ -0,0 +1,181 @@
+/******************************************************************************
+ * wrt_known_hosts.cxx                                                        *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT known_hosts store. Lines are kept in file order, *
+ * and removal only marks a line - so removing N hosts costs N index lookups  *
+ * rather than N rewrites of the file.                                        *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_known_hosts.hxx>
+#include <wrt_file.hxx>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace wrt
+{
+
+/**
+ * Constructor for KnownHosts - takes the path of the known_hosts file
+ */
+KnownHosts::KnownHosts(std::string path)
+  : path_(path) {}
+
+/**
+ * Reads and indexes the known_hosts file. A missing file is empty.
+ */
+void KnownHosts::load()
+{
+  std::ifstream known_hosts(path_.c_str());
+  std::string line;
+
+  entries_.clear();
+  index_.clear();
+  removed_ = 0;
+
+  while (std::getline(known_hosts, line)) {
+    insert(line);
+  }
+
+  dirty_ = false;
+}
+
+/**
+ * Writes the store back to disk, if it changed since it was loaded
+ */
+void KnownHosts::write()
+{
+  std::string contents;
+
+  if (!dirty_) {
+    return;
+  }
+
+  for (auto &entry : entries_) {
+    if (!entry.removed) {
+      contents += entry.line;
+      contents += '\n';
+    }
+  }
+
+  file::Replace(path_, contents, S_IRUSR | S_IWUSR);
+
+  dirty_ = false;
+}
+
+/**
+ * Returns whether any entry is known for a host
+ */
+bool KnownHosts::has(const std::string &host) const
+{
+  return index_.count(host);
+}
+
+/**
+ * Adds a key for a host, replacing any key of the same type it had
+ */
+void KnownHosts::add(const std::string &host,
+                     const std::string &type,
+                     const std::string &key)
+{
+  auto range = index_.equal_range(host);
+  std::vector<size_t> replaced;
+
+  for (auto entry = range.first; entry != range.second; ++entry) {
+    if (entries_[entry->second].type == type) {
+      replaced.push_back(entry->second);
+    }
+  }
+
+  for (auto entry : replaced) {
+    erase(entry);
+  }
+
+  insert(host + ' ' + type + ' ' + key);
+  dirty_ = true;
+}
+
+/**
+ * Removes every entry naming a host
+ */
+size_t KnownHosts::remove(const std::string &host)
+{
+  auto range = index_.equal_range(host);
+  std::vector<size_t> removed;
+
+  for (auto entry = range.first; entry != range.second; ++entry) {
+    removed.push_back(entry->second);
+  }
+
+  for (auto entry : removed) {
+    erase(entry);
+  }
+
+  return removed.size();
+}
+
+/**
+ * Appends a line to the store, indexing it by each host it names
+ */
+void KnownHosts::insert(const std::string &line)
+{
+  Entry entry;
+  entry.line = line;
+
+  std::stringstream fields(line);
+  std::string hosts, host;
+
+  fields >> hosts >> entry.type;
+
+  //Comments, blank lines, @markers and hashed hosts are kept, not indexed
+  if (!hosts.empty() && hosts[0] != '#' && hosts[0] != '@' &&
+      hosts[0] != '|') {
+    std::stringstream names(hosts);
+
+    while (std::getline(names, host, ',')) {
+      if (!host.empty()) {
+        entry.hosts.push_back(host);
+        index_.insert(std::make_pair(host, entries_.size()));
+      }
+    }
+  }
+
+  entries_.push_back(entry);
+}
+
+/**
+ * Marks a line removed, and drops it from the index
+ */
+void KnownHosts::erase(size_t entry)
+{
+  if (entries_[entry].removed) {
+    return;
+  }
+
+  for (auto &host : entries_[entry].hosts) {
+    auto range = index_.equal_range(host);
+
+    for (auto indexed = range.first; indexed != range.second; ++indexed) {
+      if (indexed->second == entry) {
+        index_.erase(indexed);
+        break;
+      }
+    }
+  }
+
+  entries_[entry].removed = true;
+  removed_++;
+  dirty_ = true;
+}
+
+} //namespace wrt
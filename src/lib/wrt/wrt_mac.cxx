@@ -0,0 +1,244 @@
+/******************************************************************************
+ * wrt_mac.cxx                                                                *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of WRT's MAC address conversions. Hex digits are decoded    *
+ * through a 256 entry table, and written from a 16 entry one.                *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_mac.hxx>
+
+#include <arpa/inet.h>
+
+#include <cstring>
+
+namespace wrt
+{
+
+namespace mac
+{
+
+namespace
+{
+/**
+ * Value of each character as a hex digit, -1 if it is not one
+ */
+const int8_t kHexValue[256] = {
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+   0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+const char kUpperDigits[] = "0123456789ABCDEF";
+const char kLowerDigits[] = "0123456789abcdef";
+
+/**
+ * Decodes hex digits in runs of group, separated by one separator - any
+ * other character, or a digit out of place, fails
+ */
+bool Decode(const char *text, size_t length, size_t group, char separator,
+            uint64_t &mac)
+{
+  uint64_t value = 0;
+  size_t   run   = 0;
+
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = text[i];
+
+    if (run == group) {
+      if (c != separator) {
+        return false;
+      }
+
+      run = 0;
+      continue;
+    }
+
+    int8_t digit = kHexValue[c];
+
+    if (digit < 0) {
+      return false;
+    }
+
+    value = (value << 4) | digit;
+    run++;
+  }
+
+  mac = value;
+
+  return true;
+}
+
+/**
+ * Writes the two hex digits of an octet
+ */
+inline char *Octet(unsigned value, const char *digits, char *out)
+{
+  out[0] = digits[(value >> 4) & 0xF];
+  out[1] = digits[value & 0xF];
+
+  return out + 2;
+}
+}
+
+/**
+ * Parses a MAC address
+ */
+bool Parse(const char *text, size_t length, uint64_t &mac)
+{
+  switch (length) {
+  case 12:
+    return Decode(text, length, 12, '\0', mac);
+
+  case 14:
+    return Decode(text, length, 4, '.', mac);
+
+  case 17:
+    return (text[2] == ':' || text[2] == '-') &&
+           Decode(text, length, 2, text[2], mac);
+
+  default:
+    return false;
+  }
+}
+
+/**
+ * Writes a MAC in canonical form (upper case, colon separated)
+ */
+char *Format(uint64_t mac, char *out)
+{
+  char *cursor = out;
+
+  for (int shift = 40; shift >= 0; shift -= 8) {
+    cursor = Octet(mac >> shift, kUpperDigits, cursor);
+    *cursor++ = shift ? ':' : '\0';
+  }
+
+  return out;
+}
+
+/**
+ * Parses an EUI64 link local IPv6 address back into its MAC
+ */
+bool ParseEUI64(const char *text, size_t length, uint64_t &mac)
+{
+  char address[INET6_ADDRSTRLEN];
+  struct in6_addr binary;
+  const char *zone = static_cast<const char *>(memchr(text, '%', length));
+
+  if (zone) {
+    length = zone - text;
+  }
+
+  if (length >= sizeof(address)) {
+    return false;
+  }
+
+  memcpy(address, text, length);
+  address[length] = '\0';
+
+  if (inet_pton(AF_INET6, address, &binary) != 1) {
+    return false;
+  }
+
+  const uint8_t *bytes = binary.s6_addr;
+  static const uint8_t kPrefix[8] = { 0xFE, 0x80, 0, 0, 0, 0, 0, 0 };
+
+  //fe80::/64, with ff:fe in the middle of the interface identifier
+  if (memcmp(bytes, kPrefix, sizeof(kPrefix)) ||
+      bytes[11] != 0xFF || bytes[12] != 0xFE) {
+    return false;
+  }
+
+  mac = (static_cast<uint64_t>(bytes[8] ^ 0x02) << 40) |
+        (static_cast<uint64_t>(bytes[9])  << 32) |
+        (static_cast<uint64_t>(bytes[10]) << 24) |
+        (static_cast<uint64_t>(bytes[13]) << 16) |
+        (static_cast<uint64_t>(bytes[14]) << 8)  |
+         static_cast<uint64_t>(bytes[15]);
+
+  return true;
+}
+
+/**
+ * Writes the EUI64 link local IPv6 address of a MAC - the MAC split around
+ * ff:fe, with the universal/local bit of its first octet inverted
+ */
+char *FormatEUI64(uint64_t mac, char *out)
+{
+  char *cursor = out;
+
+  memcpy(cursor, "fe80::", 6);
+  cursor += 6;
+
+  cursor = Octet((mac >> 40) ^ 0x02, kLowerDigits, cursor);
+  cursor = Octet(mac >> 32, kLowerDigits, cursor);
+  *cursor++ = ':';
+  cursor = Octet(mac >> 24, kLowerDigits, cursor);
+  memcpy(cursor, "ff:fe", 5);
+  cursor += 5;
+  cursor = Octet(mac >> 16, kLowerDigits, cursor);
+  *cursor++ = ':';
+  cursor = Octet(mac >> 8, kLowerDigits, cursor);
+  cursor = Octet(mac, kLowerDigits, cursor);
+  *cursor = '\0';
+
+  return out;
+}
+
+/**
+ * Parses a list of MACs
+ */
+size_t ParseAll(const std::string *texts, size_t count, uint64_t *macs)
+{
+  size_t parsed = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    if (Parse(texts[i], macs[i])) {
+      parsed++;
+    } else {
+      macs[i] = 0;
+    }
+  }
+
+  return parsed;
+}
+
+/**
+ * Writes a list of MACs
+ */
+void FormatAll(const uint64_t *macs, size_t count, char *out)
+{
+  for (size_t i = 0; i < count; ++i) {
+    Format(macs[i], out + i * (kLength + 1));
+  }
+}
+
+/**
+ * Writes the EUI64 link local address of a list of MACs
+ */
+void FormatEUI64All(const uint64_t *macs, size_t count, char *out)
+{
+  for (size_t i = 0; i < count; ++i) {
+    FormatEUI64(macs[i], out + i * (kEUI64Length + 1));
+  }
+}
+
+} //namespace mac
+
+} //namespace wrt
@@ -0,0 +1,140 @@
+/******************************************************************************
+ * wrt_maintenance.cxx                                                        *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT maintenance policy - window arithmetic, and the  *
+ * remote command (and its parser) used to measure load on an AP.             *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_maintenance.hxx>
+
+#include <cstdio>
+#include <sstream>
+
+namespace wrt
+{
+
+/**
+ * Sets the maintenance window, given as "HH:MM-HH:MM" in local time
+ */
+bool MaintenancePolicy::setWindow(std::string window)
+{
+  int start_hour, start_minute, end_hour, end_minute;
+  char trailing;
+
+  if (window.empty()) {
+    window_start_ = window_end_ = 0;
+    return true;
+  }
+
+  if (std::sscanf(window.c_str(), "%d:%d-%d:%d%c",
+                  &start_hour, &start_minute,
+                  &end_hour, &end_minute, &trailing) != 4) {
+    return false;
+  }
+
+  if (start_hour < 0 || start_hour > 24 || start_minute < 0 ||
+      start_minute > 59 || end_hour < 0 || end_hour > 24 ||
+      end_minute < 0 || end_minute > 59) {
+    return false;
+  }
+
+  //24:00 is midnight - there is no 24:01
+  if ((start_hour == 24 && start_minute) || (end_hour == 24 && end_minute)) {
+    return false;
+  }
+
+  window_start_ = (start_hour * 60 + start_minute) % (24 * 60);
+  window_end_   = (end_hour * 60 + end_minute) % (24 * 60);
+
+  return true;
+}
+
+/**
+ * Returns whether the given time falls inside the maintenance window
+ */
+bool MaintenancePolicy::inWindow(time_t when) const
+{
+  struct tm local;
+
+  if (!hasWindow() || !localtime_r(&when, &local)) {
+    return false;
+  }
+
+  int now = local.tm_hour * 60 + local.tm_min;
+
+  if (window_start_ < window_end_) {
+    return now >= window_start_ && now < window_end_;
+  }
+
+  //Window wraps past midnight
+  return now >= window_start_ || now < window_end_;
+}
+
+/**
+ * Returns whether the given load is below every configured threshold
+ */
+bool MaintenancePolicy::isQuiet(const Load &load) const
+{
+  if (max_stations_ >= 0 &&
+      (load.stations < 0 || load.stations > max_stations_)) {
+    return false;
+  }
+
+  if (max_throughput_ >= 0 &&
+      (load.throughput < 0 || load.throughput > max_throughput_)) {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Returns the remote shell command which measures the load on an AP. It
+ * prints the station count, then the interface byte counters before and
+ * after sampling for kSampleSeconds.
+ */
+std::string MaintenancePolicy::LoadCommand(std::string interface)
+{
+  std::stringstream command;
+  std::string statistics = "/sys/class/net/" + interface + "/statistics/";
+
+  command << "iw dev " << interface << " station dump 2>/dev/null"
+          << " | grep -c ^Station;"
+          << "cat " << statistics << "rx_bytes " << statistics << "tx_bytes;"
+          << "sleep " << kSampleSeconds << ';'
+          << "cat " << statistics << "rx_bytes " << statistics << "tx_bytes";
+
+  return command.str();
+}
+
+/**
+ * Parses the output of the command given by LoadCommand
+ */
+bool MaintenancePolicy::ParseLoad(const std::string &reply, Load &load)
+{
+  std::stringstream ss(reply);
+  unsigned long long rx_before, tx_before, rx_after, tx_after;
+  int stations;
+
+  if (!(ss >> stations >> rx_before >> tx_before >> rx_after >> tx_after)) {
+    return false;
+  }
+
+  load.stations = stations;
+
+  //Counters may wrap or reset (interface restarted) between samples
+  if (rx_after + tx_after < rx_before + tx_before) {
+    load.throughput = -1;
+  } else {
+    load.throughput = static_cast<double>((rx_after + tx_after) -
+                                          (rx_before + tx_before)) /
+                      kSampleSeconds;
+  }
+
+  return true;
+}
+
+} //namespace wrt
@@ -0,0 +1,534 @@
+/******************************************************************************
+ * wrt_metrics.cxx                                                            *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT push metrics. A histogram is a flat array of     *
+ * counts - a bucket is found from a value's top bits, with no search.        *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_metrics.hxx>
+#include <wrt_file.hxx>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace wrt
+{
+
+const int      LatencyHistogram::kSubBits;
+const uint64_t LatencyHistogram::kMaxValue;
+const int      PushMetrics::kPhases;
+const size_t   PushMetrics::kSlowest;
+
+namespace
+{
+
+/**
+ * Bounds of the Prometheus histogram buckets, in microseconds
+ */
+const uint64_t kBounds[] = {
+  10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+  10000000, 25000000, 60000000, 120000000, 300000000,
+};
+
+const char *const kBoundNames[] = {
+  "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10",
+  "25", "60", "120", "300",
+};
+
+const double kQuantiles[] = { 0.5, 0.9, 0.99 };
+
+const char *const kQuantileNames[] = { "0.5", "0.9", "0.99" };
+
+/**
+ * Appends microseconds as seconds
+ */
+void AppendSeconds(std::string &to, uint64_t micros)
+{
+  char number[32];
+  int  length = snprintf(number, sizeof(number), "%.6f", micros / 1e6);
+
+  to.append(number, length);
+}
+
+void AppendNumber(std::string &to, uint64_t value)
+{
+  char number[24];
+  int  length = snprintf(number, sizeof(number), "%llu",
+                         static_cast<unsigned long long>(value));
+
+  to.append(number, length);
+}
+
+/**
+ * Appends a Prometheus label value, escaped
+ */
+void AppendLabel(std::string &to, const std::string &value)
+{
+  to += '"';
+
+  for (char c : value) {
+    switch (c) {
+    case '\\': to += "\\\\";  break;
+    case '"':  to += "\\\"";  break;
+    case '\n': to += "\\n";   break;
+    default:   to += c;       break;
+    }
+  }
+
+  to += '"';
+}
+
+/**
+ * Appends a JSON string, quoted and escaped
+ */
+void AppendString(std::string &to, const std::string &value)
+{
+  to += '"';
+
+  for (char c : value) {
+    unsigned char byte = c;
+
+    if (byte == '"' || byte == '\\') {
+      to += '\\';
+      to += c;
+
+    } else if (byte < 0x20) {
+      char escaped[8];
+
+      snprintf(escaped, sizeof(escaped), "\\u%04x", byte);
+      to += escaped;
+
+    } else {
+      to += c;
+    }
+  }
+
+  to += '"';
+}
+
+}
+
+/**
+ * Returns the bucket a value is counted in
+ */
+size_t LatencyHistogram::Index(uint64_t value)
+{
+  const uint64_t half = 1ULL << (kSubBits - 1);
+
+  if (value < (1ULL << kSubBits)) {
+    return value;
+  }
+
+  //The value's top kSubBits bits pick the bucket within its doubling
+  int shift = 63 - __builtin_clzll(value) - (kSubBits - 1);
+
+  return (shift + 1) * half + (value >> shift) - half;
+}
+
+/**
+ * Returns the highest value a bucket counts
+ */
+uint64_t LatencyHistogram::Highest(size_t index)
+{
+  const uint64_t half = 1ULL << (kSubBits - 1);
+
+  if (index < (1ULL << kSubBits)) {
+    return index;
+  }
+
+  int      shift = index / half - 1;
+  uint64_t sub   = index % half + half;
+
+  return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Counts a value
+ */
+void LatencyHistogram::record(uint64_t value)
+{
+  size_t index;
+
+  value = std::min(value, kMaxValue);
+  index = Index(value);
+
+  if (index >= counts_.size()) {
+    counts_.resize(index + 1);
+  }
+
+  counts_[index]++;
+  count_++;
+  sum_ += value;
+  min_  = std::min(min_, value);
+  max_  = std::max(max_, value);
+}
+
+/**
+ * Returns the value a fraction of those counted are at or below
+ */
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+  uint64_t rank, seen = 0;
+
+  if (!count_) {
+    return 0;
+  }
+
+  fraction = std::max(0.0, std::min(fraction, 1.0));
+  rank     = std::max<uint64_t>(1, std::ceil(fraction * count_));
+
+  for (size_t i = 0; i < counts_.size(); ++i) {
+    seen += counts_[i];
+
+    if (seen >= rank) {
+      return std::min(Highest(i), max_);
+    }
+  }
+
+  return max_;
+}
+
+/**
+ * Returns how many values counted are at or below a bound
+ */
+uint64_t LatencyHistogram::countAtOrBelow(uint64_t bound) const
+{
+  uint64_t below = 0;
+
+  for (size_t i = 0; i < counts_.size() && Highest(i) <= bound; ++i) {
+    below += counts_[i];
+  }
+
+  return below;
+}
+
+/**
+ * Returns the name of a phase
+ */
+const char *PushMetrics::PhaseToString(Phase phase)
+{
+  switch (phase) {
+  case Phase::kTransfer:  return "transfer";
+  case Phase::kSet:       return "set";
+  case Phase::kCommit:    return "commit";
+  case Phase::kRestart:   return "restart";
+  }
+
+  return "unknown";
+}
+
+/**
+ * Constructor for PushMetrics - the run starts now
+ */
+PushMetrics::PushMetrics()
+  : started_(time(NULL)), start_(Clock::now()) {}
+
+/**
+ * Records a phase an AP went through
+ */
+void PushMetrics::record(const std::string &AP, Phase phase,
+                         Clock::time_point start, bool ok)
+{
+  auto took = std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - start).count();
+  uint64_t micros = took > 0 ? took : 0;
+
+  std::lock_guard<std::mutex> guard(lock_);
+  PhaseMetrics &metrics = phases_[static_cast<int>(phase)];
+
+  metrics.latency.record(micros);
+
+  if (!ok) {
+    metrics.failures++;
+  }
+
+  //An AP's phases are recorded one after another - once another AP's come,
+  //it is ranked
+  if (AP != current_.name) {
+    retire();
+    current_.name = AP;
+  }
+
+  current_.total += micros;
+
+  if (micros >= current_.slowest) {
+    current_.slowest = micros;
+    current_.phase   = phase;
+  }
+}
+
+/**
+ * Counts how a push left an AP
+ */
+void PushMetrics::outcome(const std::string &result)
+{
+  std::lock_guard<std::mutex> guard(lock_);
+
+  for (auto &counted : outcomes_) {
+    if (counted.first == result) {
+      counted.second++;
+      return;
+    }
+  }
+
+  outcomes_.push_back(std::make_pair(result, 1));
+}
+
+/**
+ * Returns true if nothing has been recorded
+ */
+bool PushMetrics::empty()
+{
+  std::lock_guard<std::mutex> guard(lock_);
+
+  for (auto &phase : phases_) {
+    if (phase.latency.getCount()) {
+      return false;
+    }
+  }
+
+  return outcomes_.empty();
+}
+
+/**
+ * Writes the metrics as a Prometheus textfile
+ */
+void PushMetrics::writePrometheus(const std::string &path)
+{
+  std::string data;
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    retire();
+
+    data += "# HELP wrt_phase_seconds Time a push phase took on an AP.\n"
+            "# TYPE wrt_phase_seconds histogram\n";
+
+    for (int i = 0; i < kPhases; ++i) {
+      const LatencyHistogram &latency = phases_[i].latency;
+      std::string label("phase=\"");
+
+      label += PhaseToString(static_cast<Phase>(i));
+      label += '"';
+
+      for (size_t b = 0; b < sizeof(kBounds) / sizeof(kBounds[0]); ++b) {
+        data += "wrt_phase_seconds_bucket{" + label + ",le=\"";
+        data += kBoundNames[b];
+        data += "\"} ";
+        AppendNumber(data, latency.countAtOrBelow(kBounds[b]));
+        data += '\n';
+      }
+
+      data += "wrt_phase_seconds_bucket{" + label + ",le=\"+Inf\"} ";
+      AppendNumber(data, latency.getCount());
+      data += "\nwrt_phase_seconds_sum{" + label + "} ";
+      AppendSeconds(data, latency.getSum());
+      data += "\nwrt_phase_seconds_count{" + label + "} ";
+      AppendNumber(data, latency.getCount());
+      data += '\n';
+    }
+
+    data += "# HELP wrt_phase_quantile_seconds Push phase latency"
+            " percentiles.\n"
+            "# TYPE wrt_phase_quantile_seconds gauge\n";
+
+    for (int i = 0; i < kPhases; ++i) {
+      for (size_t q = 0; q < sizeof(kQuantiles) / sizeof(kQuantiles[0]); ++q) {
+        data += "wrt_phase_quantile_seconds{phase=\"";
+        data += PhaseToString(static_cast<Phase>(i));
+        data += "\",quantile=\"";
+        data += kQuantileNames[q];
+        data += "\"} ";
+        AppendSeconds(data, phases_[i].latency.percentile(kQuantiles[q]));
+        data += '\n';
+      }
+    }
+
+    data += "# HELP wrt_phase_failures_total Push phases which failed.\n"
+            "# TYPE wrt_phase_failures_total counter\n";
+
+    for (int i = 0; i < kPhases; ++i) {
+      data += "wrt_phase_failures_total{phase=\"";
+      data += PhaseToString(static_cast<Phase>(i));
+      data += "\"} ";
+      AppendNumber(data, phases_[i].failures);
+      data += '\n';
+    }
+
+    data += "# HELP wrt_aps_total APs by how the push left them.\n"
+            "# TYPE wrt_aps_total counter\n";
+
+    for (auto &counted : outcomes_) {
+      data += "wrt_aps_total{result=";
+      AppendLabel(data, counted.first);
+      data += "} ";
+      AppendNumber(data, counted.second);
+      data += '\n';
+    }
+
+    data += "# HELP wrt_ap_seconds Time the slowest APs took, over every"
+            " phase.\n"
+            "# TYPE wrt_ap_seconds gauge\n";
+
+    for (auto &AP : slowest_) {
+      data += "wrt_ap_seconds{ap=";
+      AppendLabel(data, AP.name);
+      data += ",slowest_phase=\"";
+      data += PhaseToString(AP.phase);
+      data += "\"} ";
+      AppendSeconds(data, AP.total);
+      data += '\n';
+    }
+
+    data += "# HELP wrt_run_started_timestamp_seconds When the run"
+            " started.\n"
+            "# TYPE wrt_run_started_timestamp_seconds gauge\n"
+            "wrt_run_started_timestamp_seconds ";
+    AppendNumber(data, started_);
+    data += "\n# HELP wrt_run_elapsed_seconds How long the run has taken.\n"
+            "# TYPE wrt_run_elapsed_seconds gauge\n"
+            "wrt_run_elapsed_seconds ";
+    AppendSeconds(data, std::chrono::duration_cast<std::chrono::microseconds>(
+                          Clock::now() - start_).count());
+    data += '\n';
+  }
+
+  file::Replace(path, data, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+}
+
+/**
+ * Writes a JSON summary of the metrics
+ */
+void PushMetrics::writeJSON(const std::string &path)
+{
+  std::string data;
+
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    retire();
+
+    data += "{\n  \"started\": ";
+    AppendNumber(data, started_);
+    data += ",\n  \"updated\": ";
+    AppendNumber(data, time(NULL));
+    data += ",\n  \"elapsed_seconds\": ";
+    AppendSeconds(data, std::chrono::duration_cast<std::chrono::microseconds>(
+                          Clock::now() - start_).count());
+    data += ",\n  \"phases\": {";
+
+    for (int i = 0; i < kPhases; ++i) {
+      const LatencyHistogram &latency = phases_[i].latency;
+
+      data += i ? ",\n    \"" : "\n    \"";
+      data += PhaseToString(static_cast<Phase>(i));
+      data += "\": { \"count\": ";
+      AppendNumber(data, latency.getCount());
+      data += ", \"failures\": ";
+      AppendNumber(data, phases_[i].failures);
+      data += ", \"sum_seconds\": ";
+      AppendSeconds(data, latency.getSum());
+      data += ", \"min_seconds\": ";
+      AppendSeconds(data, latency.getMin());
+      data += ", \"mean_seconds\": ";
+      AppendSeconds(data, latency.getCount() ?
+                          latency.getSum() / latency.getCount() : 0);
+
+      for (size_t q = 0; q < sizeof(kQuantiles) / sizeof(kQuantiles[0]); ++q) {
+        char key[32];
+
+        snprintf(key, sizeof(key), ", \"p%d_seconds\": ",
+                 static_cast<int>(kQuantiles[q] * 100));
+        data += key;
+        AppendSeconds(data, latency.percentile(kQuantiles[q]));
+      }
+
+      data += ", \"max_seconds\": ";
+      AppendSeconds(data, latency.getMax());
+      data += " }";
+    }
+
+    data += "\n  },\n  \"outcomes\": {";
+
+    for (size_t i = 0; i < outcomes_.size(); ++i) {
+      data += i ? ", " : " ";
+      AppendString(data, outcomes_[i].first);
+      data += ": ";
+      AppendNumber(data, outcomes_[i].second);
+    }
+
+    data += outcomes_.empty() ? "}" : " }";
+    data += ",\n  \"slowest\": [";
+
+    for (size_t i = 0; i < slowest_.size(); ++i) {
+      data += i ? ",\n    { \"name\": " : "\n    { \"name\": ";
+      AppendString(data, slowest_[i].name);
+      data += ", \"seconds\": ";
+      AppendSeconds(data, slowest_[i].total);
+      data += ", \"slowest_phase\": \"";
+      data += PhaseToString(slowest_[i].phase);
+      data += "\", \"slowest_phase_seconds\": ";
+      AppendSeconds(data, slowest_[i].slowest);
+      data += " }";
+    }
+
+    data += slowest_.empty() ? "]\n}\n" : "\n  ]\n}\n";
+  }
+
+  file::Replace(path, data, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+}
+
+/**
+ * Ranks the AP whose phases were being recorded among the slowest. An AP
+ * recorded again later (a deferred restart) adds to the time it is ranked
+ * with.
+ */
+void PushMetrics::retire()
+{
+  auto ranked = slowest_.end();
+
+  if (current_.name.empty()) {
+    return;
+  }
+
+  for (auto AP = slowest_.begin(); AP != slowest_.end(); ++AP) {
+    if (AP->name == current_.name) {
+      ranked = AP;
+      break;
+    }
+  }
+
+  if (ranked == slowest_.end()) {
+    slowest_.push_back(current_);
+
+  } else {
+    ranked->total += current_.total;
+
+    if (current_.slowest >= ranked->slowest) {
+      ranked->slowest = current_.slowest;
+      ranked->phase   = current_.phase;
+    }
+  }
+
+  std::stable_sort(slowest_.begin(), slowest_.end(),
+                   [](const APTime &a, const APTime &b) {
+                     return a.total > b.total;
+                   });
+
+  if (slowest_.size() > kSlowest) {
+    slowest_.resize(kSlowest);
+  }
+
+  current_ = APTime();
+}
+
+}
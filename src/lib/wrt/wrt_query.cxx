@@ -0,0 +1,653 @@
+/******************************************************************************
+ * wrt_query.cxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT fleet query engine. Each indexed term gives a    *
+ * sorted list of candidates; the smallest is taken, and its APs checked      *
+ * against the other terms directly - which is cheaper than intersecting      *
+ * lists that may each be most of the fleet.                                  *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_query.hxx>
+#include <wrt_types.hxx>
+
+#include <arpa/inet.h>
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace wrt
+{
+
+namespace
+{
+const char kTermSeparator        = ',';
+const char kValueSeparator       = '|';
+const char kAssignment           = '=';
+const auto kGlobCharacters("*?[\\");
+
+const auto kNameKey("name");
+const auto kTypeKey("type");
+const auto kNetKey("net");
+const auto kPushKey("push");
+
+const std::vector<std::string> kPushStates = {
+  "none", "transferred", "set", "committed", "restarted", "pending",
+};
+
+/**
+ * Splits text at each separator
+ */
+std::vector<std::string> Split(const std::string &text, char separator)
+{
+  std::vector<std::string> parts;
+  size_t start = 0, end;
+
+  while ((end = text.find(separator, start)) != std::string::npos) {
+    parts.push_back(text.substr(start, end - start));
+    start = end + 1;
+  }
+
+  parts.push_back(text.substr(start));
+
+  return parts;
+}
+
+/**
+ * Returns bit i of a 128 bit address, most significant first
+ */
+inline int Bit(const uint8_t bytes[16], unsigned i)
+{
+  return (bytes[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+/**
+ * Sorts a candidate list and drops repeats - an AP may be reached by two
+ * values of a term
+ */
+void Normalize(std::vector<uint32_t> &ids)
+{
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+}
+
+/******************************************************************************
+ * Selector                                                                   *
+ ******************************************************************************/
+
+/**
+ * Parses a selector
+ */
+FleetIndex::Selector FleetIndex::Selector::Parse(const std::string &text)
+{
+  Selector selector;
+
+  selector.text_ = text;
+
+  for (auto &term : Split(text, kTermSeparator)) {
+    size_t assignment = term.find(kAssignment);
+
+    if (assignment == std::string::npos || !assignment ||
+        assignment + 1 == term.size()) {
+      throw std::runtime_error("\"" + term + "\" is not KEY=VALUE.");
+    }
+
+    std::string key = term.substr(0, assignment);
+    std::vector<std::string> values = Split(term.substr(assignment + 1),
+                                            kValueSeparator);
+
+    for (auto &value : values) {
+      if (value.empty()) {
+        throw std::runtime_error("\"" + term + "\" has an empty value.");
+      }
+    }
+
+    if (key == kNameKey) {
+      selector.names_.push_back(values);
+
+    } else if (key == kTypeKey) {
+      std::vector<AccessPoint::Type> types;
+
+      for (auto &value : values) {
+        AccessPoint::Type type = types::Find(value);
+
+        if (type == AccessPoint::Type::none &&
+            !types::Equal(value.c_str(), types::Name(type))) {
+          throw std::runtime_error("\"" + value + "\" is not a type of AP.");
+        }
+
+        types.push_back(type);
+      }
+
+      selector.types_.push_back(types);
+
+    } else if (key == kNetKey) {
+      std::vector<Prefix> nets;
+
+      for (auto &value : values) {
+        size_t slash = value.find('/');
+        std::string address = value.substr(0, slash);
+        Prefix prefix;
+        in_addr ipv4;
+        in6_addr ipv6;
+        char *end = nullptr;
+        long length;
+
+        if (inet_pton(AF_INET, address.c_str(), &ipv4) == 1) {
+          Map(ipv4, prefix.bytes);
+          length = 32;
+
+        } else if (inet_pton(AF_INET6, address.c_str(), &ipv6) == 1) {
+          memcpy(prefix.bytes, ipv6.s6_addr, sizeof(prefix.bytes));
+          length = 128;
+
+        } else {
+          throw std::runtime_error("\"" + value + "\" is not an address.");
+        }
+
+        //IPv4 prefixes count from the start of the mapped address
+        long offset = 128 - length;
+
+        if (slash != std::string::npos) {
+          long given = strtol(value.c_str() + slash + 1, &end, 10);
+
+          if (slash + 1 == value.size() || *end || given < 0 ||
+              given > length) {
+            throw std::runtime_error("\"" + value + "\" has a bad prefix"
+                                     " length.");
+          }
+
+          length = given;
+        }
+
+        prefix.length = offset + length;
+        nets.push_back(prefix);
+      }
+
+      selector.nets_.push_back(nets);
+
+    } else if (key == kPushKey) {
+      for (auto &value : values) {
+        if (std::find(kPushStates.begin(), kPushStates.end(), value) ==
+            kPushStates.end()) {
+          throw std::runtime_error("\"" + value + "\" is not a " + key +
+                                   ".");
+        }
+      }
+
+      selector.status_.push_back(Term { key, values });
+
+    } else {
+      throw std::runtime_error("\"" + key + "\" is not a selector key.");
+    }
+  }
+
+  return selector;
+}
+
+/******************************************************************************
+ * FleetIndex                                                                 *
+ ******************************************************************************/
+
+/**
+ * Constructor for FleetIndex - indexes the APs a reader gives
+ */
+FleetIndex::FleetIndex(size_t count, Reader read)
+  : count_(count), read_(read), trie_(1), types_(types::kProfileCount)
+{
+  for (uint32_t id = 0; id < count_; ++id) {
+    AccessPoint AP = read_(id);
+
+    insertName(AP.getName(), id);
+    types_[static_cast<size_t>(AP.getEnumType()) % types_.size()].push_back(id);
+
+    if (AP.hasIPv4()) {
+      uint8_t bytes[16];
+
+      Map(AP.getIPv4Address(), bytes);
+      insertAddress(bytes, id);
+    }
+
+    if (AP.hasIPv6()) {
+      insertAddress(AP.getIPv6Address().s6_addr, id);
+    }
+  }
+}
+
+/**
+ * Returns the APs a selector's name, type and net terms match
+ */
+std::vector<AccessPoint> FleetIndex::select(const Selector &selector) const
+{
+  std::vector<AccessPoint> selected;
+  std::vector<IDs> lists;
+
+  for (auto &names : selector.names_) {
+    lists.push_back(candidates(names));
+  }
+
+  for (auto &types : selector.types_) {
+    lists.push_back(candidates(types));
+  }
+
+  for (auto &nets : selector.nets_) {
+    lists.push_back(candidates(nets));
+  }
+
+  //Only a selector of push terms alone walks the whole fleet
+  if (lists.empty()) {
+    selected.reserve(count_);
+
+    for (uint32_t id = 0; id < count_; ++id) {
+      selected.push_back(read_(id));
+    }
+
+    return selected;
+  }
+
+  const IDs &smallest = *std::min_element(lists.begin(), lists.end(),
+                                          [](const IDs &a, const IDs &b) {
+                                            return a.size() < b.size();
+                                          });
+
+  for (auto id : smallest) {
+    AccessPoint AP = read_(id);
+
+    if (matches(AP, selector)) {
+      selected.push_back(AP);
+    }
+  }
+
+  return selected;
+}
+
+/**
+ * Adds a name to the trie - splitting the edge it diverges from, if any
+ */
+void FleetIndex::insertName(const std::string &name, uint32_t id)
+{
+  uint32_t node = 0;
+  size_t   at   = 0;
+
+  while (at < name.size()) {
+    uint32_t child = 0;
+    bool found = false;
+
+    for (auto next : trie_[node].children) {
+      if (trie_[next].edge[0] == name[at]) {
+        child = next;
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      TrieNode leaf;
+
+      leaf.edge = name.substr(at);
+      leaf.ids.push_back(id);
+
+      trie_.push_back(leaf);
+      trie_[node].children.push_back(trie_.size() - 1);
+      return;
+    }
+
+    const std::string &edge = trie_[child].edge;
+    size_t common = 0;
+
+    while (common < edge.size() && at + common < name.size() &&
+           edge[common] == name[at + common]) {
+      common++;
+    }
+
+    //The name leaves the edge part way along - split it there
+    if (common < edge.size()) {
+      TrieNode middle;
+
+      middle.edge = edge.substr(0, common);
+      middle.children.push_back(child);
+      trie_[child].edge.erase(0, common);
+
+      trie_.push_back(middle);
+      std::replace(trie_[node].children.begin(), trie_[node].children.end(),
+                   child, static_cast<uint32_t>(trie_.size() - 1));
+      child = trie_.size() - 1;
+    }
+
+    node = child;
+    at  += common;
+  }
+
+  trie_[node].ids.push_back(id);
+}
+
+/**
+ * Finds the names equal to, or starting with, a prefix
+ */
+void FleetIndex::findNames(const std::string &prefix, bool exact,
+                           IDs &ids) const
+{
+  uint32_t node = 0;
+  size_t   at   = 0;
+
+  while (at < prefix.size()) {
+    const TrieNode *child = nullptr;
+    uint32_t index = 0;
+
+    for (auto next : trie_[node].children) {
+      if (trie_[next].edge[0] == prefix[at]) {
+        child = &trie_[next];
+        index = next;
+        break;
+      }
+    }
+
+    if (!child) {
+      return;
+    }
+
+    size_t common = 0;
+
+    while (common < child->edge.size() && at + common < prefix.size() &&
+           child->edge[common] == prefix[at + common]) {
+      common++;
+    }
+
+    //The prefix ends inside the edge - everything below it matches
+    if (at + common == prefix.size() && common < child->edge.size()) {
+      if (!exact) {
+        collectNames(index, ids);
+      }
+
+      return;
+    }
+
+    if (common < child->edge.size()) {
+      return;
+    }
+
+    node = index;
+    at  += common;
+  }
+
+  if (exact) {
+    ids.insert(ids.end(), trie_[node].ids.begin(), trie_[node].ids.end());
+  } else {
+    collectNames(node, ids);
+  }
+}
+
+/**
+ * Collects every name at or below a node of the trie
+ */
+void FleetIndex::collectNames(uint32_t node, IDs &ids) const
+{
+  std::vector<uint32_t> pending(1, node);
+
+  while (!pending.empty()) {
+    const TrieNode &next = trie_[pending.back()];
+
+    pending.pop_back();
+    ids.insert(ids.end(), next.ids.begin(), next.ids.end());
+    pending.insert(pending.end(), next.children.begin(), next.children.end());
+  }
+}
+
+/**
+ * Adds an address to the crit-bit tree
+ */
+void FleetIndex::insertAddress(const uint8_t bytes[16], uint32_t id)
+{
+  Leaf leaf;
+
+  memcpy(leaf.bytes, bytes, sizeof(leaf.bytes));
+  leaf.ids.push_back(id);
+
+  if (leaves_.empty()) {
+    leaves_.push_back(leaf);
+    root_ = ~0;
+    return;
+  }
+
+  //The leaf the address would meet, and the first bit they differ at
+  int32_t node = root_;
+
+  while (node >= 0) {
+    node = branches_[node].child[Bit(bytes, branches_[node].bit)];
+  }
+
+  Leaf &nearest = leaves_[~node];
+  unsigned bit = 0;
+
+  while (bit < 128 && Bit(nearest.bytes, bit) == Bit(bytes, bit)) {
+    bit++;
+  }
+
+  if (bit == 128) {
+    nearest.ids.push_back(id);
+    return;
+  }
+
+  leaves_.push_back(leaf);
+
+  //The branch goes above the first node testing a later bit
+  int32_t parent = -1, side = 0;
+
+  node = root_;
+
+  while (node >= 0 && branches_[node].bit < bit) {
+    parent = node;
+    side   = Bit(bytes, branches_[node].bit);
+    node   = branches_[node].child[side];
+  }
+
+  Branch branch;
+
+  branch.bit = bit;
+  branch.child[Bit(bytes, bit)]  = ~static_cast<int32_t>(leaves_.size() - 1);
+  branch.child[!Bit(bytes, bit)] = node;
+
+  branches_.push_back(branch);
+
+  if (parent < 0) {
+    root_ = branches_.size() - 1;
+  } else {
+    branches_[parent].child[side] = branches_.size() - 1;
+  }
+}
+
+/**
+ * Finds the addresses within a prefix - the subtree below the last branch
+ * the prefix decides, if any leaf of it shares the prefix
+ */
+void FleetIndex::findAddresses(const Prefix &prefix, IDs &ids) const
+{
+  if (leaves_.empty()) {
+    return;
+  }
+
+  int32_t top = root_;
+
+  while (top >= 0 && branches_[top].bit < prefix.length) {
+    top = branches_[top].child[Bit(prefix.bytes, branches_[top].bit)];
+  }
+
+  int32_t leaf = top;
+
+  while (leaf >= 0) {
+    leaf = branches_[leaf].child[0];
+  }
+
+  if (Within(leaves_[~leaf].bytes, prefix)) {
+    collectAddresses(top, ids);
+  }
+}
+
+/**
+ * Collects every address at or below a node of the crit-bit tree
+ */
+void FleetIndex::collectAddresses(int32_t node, IDs &ids) const
+{
+  std::vector<int32_t> pending(1, node);
+
+  while (!pending.empty()) {
+    int32_t next = pending.back();
+
+    pending.pop_back();
+
+    if (next < 0) {
+      ids.insert(ids.end(), leaves_[~next].ids.begin(),
+                 leaves_[~next].ids.end());
+    } else {
+      pending.push_back(branches_[next].child[0]);
+      pending.push_back(branches_[next].child[1]);
+    }
+  }
+}
+
+/**
+ * Returns the APs with a name matching any of the globs given. The part of
+ * a glob before its first wildcard is looked up in the trie.
+ */
+FleetIndex::IDs FleetIndex::candidates(
+  const std::vector<std::string> &names) const
+{
+  IDs ids;
+
+  for (auto &name : names) {
+    size_t wildcard = name.find_first_of(kGlobCharacters);
+
+    if (wildcard == std::string::npos) {
+      findNames(name, true, ids);
+      continue;
+    }
+
+    IDs prefixed;
+
+    findNames(name.substr(0, wildcard), false, prefixed);
+
+    for (auto id : prefixed) {
+      if (!fnmatch(name.c_str(), read_(id).getName().c_str(), 0)) {
+        ids.push_back(id);
+      }
+    }
+  }
+
+  Normalize(ids);
+
+  return ids;
+}
+
+/**
+ * Returns the APs of any of the types given
+ */
+FleetIndex::IDs FleetIndex::candidates(
+  const std::vector<AccessPoint::Type> &types) const
+{
+  IDs ids;
+
+  for (auto type : types) {
+    const IDs &bucket = types_[static_cast<size_t>(type) % types_.size()];
+
+    ids.insert(ids.end(), bucket.begin(), bucket.end());
+  }
+
+  Normalize(ids);
+
+  return ids;
+}
+
+/**
+ * Returns the APs with an address within any of the prefixes given
+ */
+FleetIndex::IDs FleetIndex::candidates(const std::vector<Prefix> &nets) const
+{
+  IDs ids;
+
+  for (auto &net : nets) {
+    findAddresses(net, ids);
+  }
+
+  Normalize(ids);
+
+  return ids;
+}
+
+/**
+ * Checks an AP against every name, type and net term of a selector
+ */
+bool FleetIndex::matches(const AccessPoint &AP,
+                         const Selector &selector) const
+{
+  for (auto &names : selector.names_) {
+    bool any = false;
+
+    for (auto &name : names) {
+      any = any || !fnmatch(name.c_str(), AP.getName().c_str(), 0);
+    }
+
+    if (!any) {
+      return false;
+    }
+  }
+
+  for (auto &types : selector.types_) {
+    if (std::find(types.begin(), types.end(),
+                  AP.getEnumType()) == types.end()) {
+      return false;
+    }
+  }
+
+  for (auto &nets : selector.nets_) {
+    uint8_t ipv4[16];
+    bool any = false;
+
+    if (AP.hasIPv4()) {
+      Map(AP.getIPv4Address(), ipv4);
+    }
+
+    for (auto &net : nets) {
+      any = any || (AP.hasIPv4() && Within(ipv4, net)) ||
+            (AP.hasIPv6() && Within(AP.getIPv6Address().s6_addr, net));
+    }
+
+    if (!any) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Returns whether an address lies within a prefix
+ */
+bool FleetIndex::Within(const uint8_t bytes[16], const Prefix &prefix)
+{
+  unsigned whole = prefix.length / 8, rest = prefix.length % 8;
+
+  if (memcmp(bytes, prefix.bytes, whole)) {
+    return false;
+  }
+
+  return !rest ||
+         !((bytes[whole] ^ prefix.bytes[whole]) & (0xFF << (8 - rest)));
+}
+
+/**
+ * Maps an IPv4 address into ::ffff:0:0/96
+ */
+void FleetIndex::Map(const in_addr &address, uint8_t bytes[16])
+{
+  memset(bytes, 0, 10);
+  bytes[10] = bytes[11] = 0xFF;
+  memcpy(bytes + 12, &address.s_addr, 4);
+}
+
+}
@@ -0,0 +1,325 @@
+/******************************************************************************
+ * wrt_render.cxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT record renderer. Values are escaped as they are  *
+ * copied into the buffer - a run of plain characters is appended at once.    *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_render.hxx>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace wrt
+{
+
+const size_t Renderer::kDefaultBlock;
+
+/**
+ * Returns the format a name stands for
+ */
+Renderer::Format Renderer::FormatFromString(const std::string &name)
+{
+  if (name == "text") {
+    return Format::kText;
+  } else if (name == "json") {
+    return Format::kJSON;
+  } else if (name == "ndjson") {
+    return Format::kNDJSON;
+  } else if (name == "csv") {
+    return Format::kCSV;
+  }
+
+  throw std::runtime_error("\"" + name + "\" is not an output format"
+                           " (text, json, ndjson or csv).");
+}
+
+/**
+ * Constructor for Renderer - takes the format, the file descriptor to write
+ * to, and how much to buffer between writes
+ */
+Renderer::Renderer(Format format, int fd, size_t block)
+  : format_(format), fd_(fd), block_(block ? block : 1)
+{
+  buffer_.reserve(block_ + block_ / 4);
+
+  if (format_ == Format::kJSON) {
+    buffer_ += '[';
+  }
+}
+
+/**
+ * Destructor for Renderer - finishes the output
+ */
+Renderer::~Renderer()
+{
+  try {
+    finish();
+  } catch (...) {
+    //Nowhere left to report it
+  }
+}
+
+/**
+ * Starts a record
+ */
+void Renderer::begin()
+{
+  fields_ = 0;
+
+  switch (format_) {
+  case Format::kJSON:
+    buffer_ += records_ ? ",\n{" : "\n{";
+    break;
+
+  case Format::kNDJSON:
+    buffer_ += '{';
+    break;
+
+  default:
+    break;
+  }
+}
+
+/**
+ * Adds a string field to the record begun
+ */
+void Renderer::field(const char *key, const std::string &value)
+{
+  this->key(key);
+  quoted(target(), value.data(), value.size());
+}
+
+void Renderer::field(const char *key, const char *value)
+{
+  this->key(key);
+  quoted(target(), value, strlen(value));
+}
+
+/**
+ * Adds a number field to the record begun
+ */
+void Renderer::field(const char *key, long long value)
+{
+  char number[24];
+  int  length = snprintf(number, sizeof(number), "%lld", value);
+
+  this->key(key);
+  target().append(number, length);
+}
+
+/**
+ * Adds a true/false field to the record begun
+ */
+void Renderer::field(const char *key, bool value)
+{
+  this->key(key);
+
+  target() += value ? "true" : "false";
+}
+
+/**
+ * Adds a field without a value
+ */
+void Renderer::null(const char *key)
+{
+  this->key(key);
+
+  if (format_ != Format::kCSV) {
+    target() += "null";
+  }
+}
+
+/**
+ * Ends the record begun - the buffer is written once a block is full
+ */
+void Renderer::end()
+{
+  switch (format_) {
+  case Format::kJSON:
+    buffer_ += '}';
+    break;
+
+  case Format::kNDJSON:
+    buffer_ += "}\n";
+    break;
+
+  case Format::kCSV:
+    //The header is only known once the first record is complete
+    if (!records_) {
+      for (size_t i = 0; i < header_.size(); ++i) {
+        if (i) {
+          buffer_ += ',';
+        }
+
+        quoted(buffer_, header_[i].data(), header_[i].size());
+      }
+
+      buffer_ += '\n';
+      buffer_ += first_;
+
+      first_.clear();
+    }
+
+    buffer_ += '\n';
+    break;
+
+  default:
+    break;
+  }
+
+  records_++;
+
+  if (buffer_.size() >= block_) {
+    flush();
+  }
+}
+
+/**
+ * Closes the output, and writes whatever is buffered
+ */
+void Renderer::finish()
+{
+  if (finished_) {
+    return;
+  }
+
+  finished_ = true;
+
+  if (format_ == Format::kJSON) {
+    buffer_ += records_ ? "\n]\n" : "]\n";
+  }
+
+  flush();
+}
+
+/**
+ * Writes whatever is buffered
+ */
+void Renderer::flush()
+{
+  const char *data = buffer_.data();
+  size_t      left = buffer_.size();
+
+  while (left) {
+    ssize_t written = ::write(fd_, data, left);
+
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (written == -1) {
+      buffer_.clear();
+
+      throw std::runtime_error(std::string("write(): ") + strerror(errno));
+    }
+
+    data += written;
+    left -= written;
+  }
+
+  buffer_.clear();
+}
+
+/**
+ * Writes a field's key, and whatever separates it from the last
+ */
+void Renderer::key(const char *key)
+{
+  if (format_ == Format::kCSV) {
+    if (!records_) {
+      header_.push_back(key);
+    }
+
+    if (fields_++) {
+      target() += ',';
+    }
+
+    return;
+  }
+
+  if (fields_++) {
+    buffer_ += ',';
+  }
+
+  quoted(buffer_, key, strlen(key));
+  buffer_ += ':';
+}
+
+/**
+ * Returns where a value goes - in csv, the first row is held back until the
+ * header is out
+ */
+std::string &Renderer::target()
+{
+  return format_ == Format::kCSV && !records_ ? first_ : buffer_;
+}
+
+/**
+ * Appends a string, quoted and escaped for the format
+ */
+void Renderer::quoted(std::string &to, const char *data, size_t length)
+{
+  size_t plain = 0;
+
+  if (format_ == Format::kCSV) {
+    //A csv cell is only quoted if it has to be
+    if (strcspn(data, ",\"\r\n") >= length) {
+      to.append(data, length);
+      return;
+    }
+
+    to += '"';
+
+    for (size_t i = 0; i < length; ++i) {
+      if (data[i] == '"') {
+        to.append(data + plain, i + 1 - plain);
+        to += '"';
+        plain = i + 1;
+      }
+    }
+
+    to.append(data + plain, length - plain);
+    to += '"';
+    return;
+  }
+
+  to += '"';
+
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = data[i];
+
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    to.append(data + plain, i - plain);
+    plain = i + 1;
+
+    switch (c) {
+    case '"':  to += "\\\"";  break;
+    case '\\': to += "\\\\";  break;
+    case '\n': to += "\\n";   break;
+    case '\r': to += "\\r";   break;
+    case '\t': to += "\\t";   break;
+
+    default: {
+      char escaped[8];
+
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      to += escaped;
+      break;
+    }
+    }
+  }
+
+  to.append(data + plain, length - plain);
+  to += '"';
+}
+
+}
@@ -0,0 +1,331 @@
+/******************************************************************************
+ * wrt_shards.cxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT inventory shards. Loading hands shards to a few  *
+ * threads through a shared counter, so a thread which drew small files       *
+ * takes on more of them; each shard is only ever touched by one thread.      *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_shards.hxx>
+#include <wrt_inventory.hxx>
+#include <wrt_trace.hxx>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace wrt
+{
+
+namespace
+{
+const auto kShardSuffix(".cfg");
+const auto kAPList("Access_Points");
+const auto kAPName("Name");
+const auto kAPType("Type");
+const auto kAPMAC("MAC");
+const auto kAPIPv4("IPv4");
+const auto kAPIPv6("IPv6");
+}
+
+struct InventoryShards::Shard
+{
+  std::string path;
+  libconfig::Config config;
+  std::unique_ptr<ConfigStore> store;
+
+  std::vector<AccessPoint> APs;
+  std::vector<std::string> malformed;
+
+  Shard(const std::string &path)
+    : path(path), store(new ConfigStore(path, config)) {}
+};
+
+/**
+ * Constructor for InventoryShards - takes the path of the directory
+ */
+InventoryShards::InventoryShards(std::string directory)
+  : directory_(directory)
+{
+  //Shard paths are recorded as origins, so spell each one a single way
+  while (directory_.size() > 1 && directory_.back() == '/') {
+    directory_.pop_back();
+  }
+}
+
+InventoryShards::~InventoryShards() {}
+
+/**
+ * Returns the shards in the directory, sorted (none if it does not exist)
+ */
+std::vector<std::string> InventoryShards::list() const
+{
+  std::vector<std::string> paths;
+  const std::string suffix(kShardSuffix);
+  DIR *directory = opendir(directory_.c_str());
+  struct dirent *entry;
+  struct stat info;
+
+  if (!directory) {
+    return paths;
+  }
+
+  while ((entry = readdir(directory))) {
+    std::string name(entry->d_name);
+
+    //Hidden files are editors' - the store's own files end .lock and .tmp
+    if (name[0] == '.' || name.size() <= suffix.size() ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix)) {
+      continue;
+    }
+
+    std::string path = directory_ + "/" + name;
+
+    if (!stat(path.c_str(), &info) && S_ISREG(info.st_mode)) {
+      paths.push_back(path);
+    }
+  }
+
+  closedir(directory);
+
+  //Sorted, so which of two duplicates wins does not depend on the directory
+  std::sort(paths.begin(), paths.end());
+
+  return paths;
+}
+
+/**
+ * Reads shards, in parallel
+ */
+void InventoryShards::load(const std::vector<std::string> &paths,
+                           unsigned threads)
+{
+  std::vector<Shard *> loading;
+
+  for (auto &path : paths) {
+    loading.push_back(&find(path));
+  }
+
+  std::vector<std::exception_ptr> errors(loading.size());
+  std::atomic<size_t> next(0);
+
+  auto worker = [&loading, &errors, &next]() {
+    size_t i;
+
+    while ((i = next++) < loading.size()) {
+      Shard &shard = *loading[i];
+      Trace::Span traced("read shard", "inventory", shard.path);
+
+      try {
+        shard.store->read();
+        shard.APs.clear();
+        shard.malformed.clear();
+
+        ReadAPs(shard.config, shard.APs, shard.malformed);
+
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }
+  };
+
+  if (!threads) {
+    threads = std::max(1U, std::thread::hardware_concurrency());
+  }
+
+  threads = std::min<size_t>(threads, loading.size());
+
+  //The calling thread is one of the readers
+  std::vector<std::thread> readers;
+
+  for (unsigned i = 1; i < threads; ++i) {
+    readers.push_back(std::thread([&worker]() {
+      Trace::NameThread("shard reader");
+      worker();
+    }));
+  }
+
+  worker();
+
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  for (size_t i = 0; i < errors.size(); ++i) {
+    if (errors[i]) {
+      try {
+        std::rethrow_exception(errors[i]);
+
+      } catch (...) {
+        std::throw_with_nested(std::runtime_error("\"" + loading[i]->path +
+                                                  "\": could not be read."));
+      }
+    }
+  }
+}
+
+/**
+ * Returns the path of a shard
+ */
+const std::string &InventoryShards::getPath(size_t index) const
+{
+  return shards_.at(index)->path;
+}
+
+/**
+ * Returns the APs of a shard, in the order it lists them
+ */
+std::vector<AccessPoint> &InventoryShards::getAPs(size_t index)
+{
+  return shards_.at(index)->APs;
+}
+
+/**
+ * Returns the APs of a shard with a malformed MAC or address
+ */
+const std::vector<std::string> &InventoryShards::getMalformed(
+  size_t index) const
+{
+  return shards_.at(index)->malformed;
+}
+
+/**
+ * Returns the store of a shard
+ */
+ConfigStore &InventoryShards::getStore(const std::string &path)
+{
+  return *find(path).store;
+}
+
+/**
+ * Returns the path of a shard, by name
+ */
+std::string InventoryShards::pathOf(const std::string &name) const
+{
+  return directory_ + "/" + name + kShardSuffix;
+}
+
+/**
+ * Writes every shard with changes queued
+ */
+size_t InventoryShards::flush()
+{
+  size_t written = 0;
+
+  for (auto &shard : shards_) {
+    if (shard->store->flush()) {
+      written++;
+    }
+  }
+
+  return written;
+}
+
+/**
+ * Forgets every shard held
+ */
+void InventoryShards::clear()
+{
+  index_.clear();
+  shards_.clear();
+}
+
+/**
+ * Reads the Access_Points list of a file's settings
+ */
+void InventoryShards::ReadAPs(libconfig::Config &config,
+                              std::vector<AccessPoint> &APs,
+                              std::vector<std::string> &malformed)
+{
+  if (!config.exists(kAPList)) {
+    return;
+  }
+
+  libconfig::Setting &list = config.getRoot()[kAPList];
+
+  APs.reserve(APs.size() + list.getLength());
+
+  for (int i = 0; i < list.getLength(); ++i) {
+    std::string name = list[i][kAPName],
+                type = list[i][kAPType],
+                mac  = list[i][kAPMAC],
+                ipv4 = list[i][kAPIPv4],
+                ipv6 = list[i][kAPIPv6];
+
+    AccessPoint AP(name, mac, type);
+
+    if (!AP.hasMAC() || !AP.setIPv4(ipv4) || !AP.setIPv6(ipv6)) {
+      malformed.push_back(name);
+    }
+
+    APs.push_back(AP);
+  }
+}
+
+/**
+ * Returns a change which drops every AP with one of the names or MACs given
+ * from a file's Access_Points list, then appends APs. It gives the same
+ * result however often it is applied.
+ */
+ConfigStore::Mutation InventoryShards::Replace(
+  const std::unordered_set<std::string> &names,
+  const std::unordered_set<std::string> &macs,
+  const std::vector<AccessPoint> &added)
+{
+  return [names, macs, added](libconfig::Config &settings) {
+    libconfig::Setting &root = settings.getRoot();
+
+    if (!root.exists(kAPList)) {
+      root.add(kAPList, libconfig::Setting::TypeList);
+    }
+
+    libconfig::Setting &list = root[kAPList];
+
+    for (int i = list.getLength() - 1; i >= 0; --i) {
+      std::string name, mac;
+
+      list[i].lookupValue(kAPName, name);
+      list[i].lookupValue(kAPMAC,  mac);
+
+      if (names.count(name) || macs.count(Inventory::MACKey(mac))) {
+        list.remove(i);
+      }
+    }
+
+    for (auto AP : added) {
+      libconfig::Setting &entry = list.add(libconfig::Setting::TypeGroup);
+
+      entry.add(kAPName, libconfig::Setting::TypeString) = AP.getName();
+      entry.add(kAPType, libconfig::Setting::TypeString) = AP.getType();
+      entry.add(kAPMAC,  libconfig::Setting::TypeString) = AP.getMAC();
+      entry.add(kAPIPv4, libconfig::Setting::TypeString) = AP.getIPv4();
+      entry.add(kAPIPv6, libconfig::Setting::TypeString) = AP.getIPv6();
+    }
+  };
+}
+
+/**
+ * Returns a shard, held from now on (unread, if it was not before)
+ */
+InventoryShards::Shard &InventoryShards::find(const std::string &path)
+{
+  auto found = index_.find(path);
+
+  if (found != index_.end()) {
+    return *found->second;
+  }
+
+  shards_.push_back(std::unique_ptr<Shard>(new Shard(path)));
+
+  return *(index_[path] = shards_.back().get());
+}
+
+}
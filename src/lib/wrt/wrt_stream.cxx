@@ -0,0 +1,115 @@
+/******************************************************************************
+ * wrt_stream.cxx                                                             *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT inventory stream. The window's storage is kept   *
+ * from one fill to the next, so walking the inventory allocates nothing but  *
+ * the APs' own strings.                                                      *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_stream.hxx>
+
+namespace wrt
+{
+
+const size_t InventoryStream::kDefaultWindow;
+
+/**
+ * Constructor for InventoryStream - takes the source of the APs, and how
+ * many to hold at once
+ */
+InventoryStream::InventoryStream(Source source, size_t window)
+  : source_(source), size_(window ? window : 1)
+{
+  window_.reserve(size_);
+}
+
+/**
+ * Replaces the window with the next APs
+ */
+bool InventoryStream::next()
+{
+  window_.resize(size_);
+
+  size_t filled = 0;
+
+  while (!done_ && filled < size_) {
+    if (source_(window_[filled])) {
+      filled++;
+    } else {
+      done_ = true;
+    }
+  }
+
+  window_.resize(filled);
+  position_ += filled;
+
+  return filled > 0;
+}
+
+/**
+ * Reads the rest of the APs from another source
+ */
+void InventoryStream::reset(Source source)
+{
+  source_ = source;
+  done_   = false;
+}
+
+/**
+ * Returns a source reading the APs of an open inventory image
+ */
+InventoryStream::Source InventoryStream::Of(InventoryImage &image)
+{
+  size_t next = 0;
+
+  return [&image, next](AccessPoint &AP) mutable {
+    if (next >= image.size()) {
+      return false;
+    }
+
+    AP = image.get(next++).toAccessPoint();
+
+    return true;
+  };
+}
+
+/**
+ * Returns a source reading the APs of a list held in memory
+ */
+InventoryStream::Source InventoryStream::Of(APList &APs)
+{
+  auto next = APs.begin();
+
+  return [&APs, next](AccessPoint &AP) mutable {
+    if (next == APs.end()) {
+      return false;
+    }
+
+    AP = (next++)->second;
+
+    return true;
+  };
+}
+
+/**
+ * Returns a source reading the APs of a selection
+ */
+InventoryStream::Source InventoryStream::Of(std::vector<AccessPoint> &APs)
+{
+  size_t next = 0;
+
+  return [&APs, next](AccessPoint &AP) mutable {
+    if (next >= APs.size()) {
+      return false;
+    }
+
+    AP = APs[next++];
+
+    return true;
+  };
+}
+
+}
@@ -0,0 +1,411 @@
+/******************************************************************************
+ * wrt_trace.cxx                                                              *
+ *                                                                            *
+ * Copyright 2013 William Patrick Millard <wmillard1@gmail.com>               *
+ *                                                                            *
+ * Implementation of the WRT tracer. Buffers are kept (emptied) once a trace  *
+ * is closed - a thread holds on to its buffer for as long as it lives.       *
+ *                                                                            *
+ ******************************************************************************/
+
+#include <wrt_trace.hxx>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace wrt
+{
+
+std::atomic<bool> Trace::enabled_(false);
+
+namespace
+{
+
+const size_t kBlock = 64 * 1024;
+
+/**
+ * A span - times are in microseconds since the trace was opened
+ */
+struct Event
+{
+  const char *name;
+  const char *category;
+  int64_t     start;
+  int64_t     duration;
+  long        lane;
+  std::string target;
+};
+
+/**
+ * A thread's events - its lock is only contended while the trace closes
+ */
+struct Buffer
+{
+  std::mutex         lock;
+  long               thread;
+  std::string        name;
+  std::vector<Event> events;
+};
+
+std::mutex registry;  //Guards every global below
+
+std::vector<std::unique_ptr<Buffer>> buffers;
+std::unordered_map<long, Event>      children;  //Running, by PID
+Trace::Clock::time_point             origin;
+int                                  output = -1;
+
+thread_local Buffer *local = nullptr;
+
+/**
+ * Returns the calling thread's buffer
+ */
+Buffer &Local()
+{
+  if (!local) {
+    std::lock_guard<std::mutex> guard(registry);
+
+    buffers.emplace_back(new Buffer());
+    local = buffers.back().get();
+    local->thread = syscall(SYS_gettid);
+  }
+
+  return *local;
+}
+
+int64_t Since(Trace::Clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           time - origin).count();
+}
+
+/**
+ * Appends a JSON string, quoted and escaped
+ */
+void AppendString(std::string &to, const std::string &value)
+{
+  to += '"';
+
+  for (char c : value) {
+    unsigned char byte = c;
+
+    if (byte == '"' || byte == '\\') {
+      to += '\\';
+      to += c;
+
+    } else if (byte < 0x20) {
+      char escaped[8];
+
+      snprintf(escaped, sizeof(escaped), "\\u%04x", byte);
+      to += escaped;
+
+    } else {
+      to += c;
+    }
+  }
+
+  to += '"';
+}
+
+/**
+ * Appends a lane's name, as a metadata event
+ */
+void AppendLane(std::string &to, long process, long lane,
+                const std::string &name)
+{
+  char ids[64];
+
+  snprintf(ids, sizeof(ids), ",\n{\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,",
+           process, lane);
+
+  to += ids;
+  to += "\"name\":\"thread_name\",\"args\":{\"name\":";
+  AppendString(to, name);
+  to += "}}";
+}
+
+void AppendEvent(std::string &to, long process, const Event &event)
+{
+  char fields[192];
+
+  snprintf(fields, sizeof(fields),
+           ",\n{\"ph\":\"X\",\"pid\":%ld,\"tid\":%ld,\"ts\":%lld,\"dur\":%lld,",
+           process, event.lane, static_cast<long long>(event.start),
+           static_cast<long long>(event.duration));
+
+  to += fields;
+  to += "\"name\":";
+  AppendString(to, event.name);
+  to += ",\"cat\":";
+  AppendString(to, event.category);
+
+  if (!event.target.empty()) {
+    to += ",\"args\":{\"target\":";
+    AppendString(to, event.target);
+    to += '}';
+  }
+
+  to += '}';
+}
+
+/**
+ * Writes out (and empties) a block of the trace
+ */
+void Flush(std::string &block)
+{
+  const char *data = block.data();
+  size_t      left = block.size();
+
+  while (left) {
+    ssize_t written = ::write(output, data, left);
+
+    if (written == -1 && errno == EINTR) {
+      continue;
+    }
+
+    if (written == -1) {
+      block.clear();
+
+      throw std::runtime_error(std::string("write(): ") + strerror(errno));
+    }
+
+    data += written;
+    left -= written;
+  }
+
+  block.clear();
+}
+
+}
+
+/**
+ * Constructor for Span - the span starts, if a trace is open
+ */
+Trace::Span::Span(const char *name, const char *category,
+                  const std::string &target)
+  : name_(name), category_(category), recording_(Enabled())
+{
+  if (recording_) {
+    target_ = target;
+    start_  = Clock::now();
+  }
+}
+
+/**
+ * Destructor for Span - the span ends
+ */
+Trace::Span::~Span()
+{
+  if (recording_) {
+    Complete(name_, category_, start_, target_);
+  }
+}
+
+/**
+ * Opens a trace
+ */
+void Trace::Open(const std::string &path)
+{
+  std::lock_guard<std::mutex> guard(registry);
+
+  if (output != -1) {
+    throw std::runtime_error("A trace is already open.");
+  }
+
+  //The file is opened now, so a bad path fails the run before it starts
+  output = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (output == -1) {
+    throw std::runtime_error("open(): cannot open file \"" + path + "\"");
+  }
+
+  for (auto &buffer : buffers) {
+    std::lock_guard<std::mutex> emptying(buffer->lock);
+    buffer->events.clear();
+  }
+
+  children.clear();
+  origin = Clock::now();
+
+  enabled_.store(true);
+}
+
+/**
+ * Writes the trace out and closes it
+ */
+void Trace::Close()
+{
+  std::lock_guard<std::mutex> guard(registry);
+  std::unordered_map<long, const char *> lanes;
+  std::string block;
+  long process = getpid();
+  int64_t now;
+
+  if (output == -1) {
+    return;
+  }
+
+  enabled_.store(false);
+  now = Since(Clock::now());
+
+  block.reserve(kBlock + kBlock / 4);
+  block += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  block += "{\"ph\":\"M\",\"pid\":";
+  block += std::to_string(process);
+  block += ",\"name\":\"process_name\",\"args\":{\"name\":\"wrt\"}}";
+
+  try {
+    for (auto &buffer : buffers) {
+      std::lock_guard<std::mutex> writing(buffer->lock);
+
+      if (buffer->events.empty()) {
+        continue;
+      }
+
+      AppendLane(block, process, buffer->thread,
+                 !buffer->name.empty() ? buffer->name :
+                 buffer->thread == process ? "wrt" :
+                 "thread " + std::to_string(buffer->thread));
+
+      for (auto &event : buffer->events) {
+        AppendEvent(block, process, event);
+
+        if (event.lane != buffer->thread) {
+          lanes[event.lane] = event.name;
+        }
+
+        if (block.size() >= kBlock) {
+          Flush(block);
+        }
+      }
+
+      buffer->events.clear();
+    }
+
+    //Children never reaped are drawn up to the end
+    for (auto &child : children) {
+      child.second.duration = now - child.second.start;
+
+      AppendEvent(block, process, child.second);
+      lanes[child.first] = child.second.name;
+    }
+
+    for (auto &lane : lanes) {
+      AppendLane(block, process, lane.first,
+                 std::string(lane.second) + ' ' + std::to_string(lane.first));
+    }
+
+    block += "\n]}\n";
+    Flush(block);
+
+  } catch (...) {
+    close(output);
+    output = -1;
+    children.clear();
+
+    throw;
+  }
+
+  children.clear();
+
+  if (close(output) == -1) {
+    output = -1;
+
+    throw std::runtime_error(std::string("close(): ") + strerror(errno));
+  }
+
+  output = -1;
+}
+
+/**
+ * Records a span on the calling thread's lane
+ */
+void Trace::Complete(const char *name, const char *category,
+                     Clock::time_point start, const std::string &target)
+{
+  if (!Enabled()) {
+    return;
+  }
+
+  Buffer &buffer = Local();
+  int64_t begun  = Since(start),
+          ended  = Since(Clock::now());
+
+  std::lock_guard<std::mutex> guard(buffer.lock);
+
+  buffer.events.push_back({ name, category, begun, ended - begun,
+                            buffer.thread, target });
+}
+
+/**
+ * Starts the span of a child process
+ */
+void Trace::Started(long PID, const char *name, const std::string &target)
+{
+  if (!Enabled()) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(registry);
+
+  children[PID] = { name, "process", Since(Clock::now()), 0, PID, target };
+}
+
+/**
+ * Ends the span of a child process
+ */
+void Trace::Exited(long PID)
+{
+  Event event;
+
+  if (!Enabled()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(registry);
+    auto child = children.find(PID);
+
+    if (child == children.end()) {
+      return;
+    }
+
+    event = child->second;
+    children.erase(child);
+  }
+
+  Buffer &buffer = Local();
+
+  event.duration = Since(Clock::now()) - event.start;
+
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  buffer.events.push_back(event);
+}
+
+/**
+ * Names the calling thread's lane
+ */
+void Trace::NameThread(const std::string &name)
+{
+  if (!Enabled()) {
+    return;
+  }
+
+  Buffer &buffer = Local();
+
+  std::lock_guard<std::mutex> guard(buffer.lock);
+  buffer.name = name;
+}
+
+}
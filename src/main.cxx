@@ -15,6 +15,10 @@
 #include <sys/stat.h>
 #include <sys/fcntl.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <dirent.h>
+#include <signal.h>
+#include <poll.h>
 
 // C LIBRARIES
 #include <getopt.h>
@@ -23,11 +27,21 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
 #include <cerrno>
+#include <ctime>
 #include <exception>
 #include <stdexcept>
 #include <iomanip>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
 #include <unordered_map>
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
 
 // LIBCONFIG DEPENDENCY
 #include <libconfig.h++>
@@ -36,6 +50,26 @@
 #include <wrt_ap.hxx>
 #include <wrt_io.hxx>
 #include <wrt_exception.hxx>
+#include <wrt_checkpoint.hxx>
+#include <wrt_maintenance.hxx>
+#include <wrt_keyscan.hxx>
+#include <wrt_known_hosts.hxx>
+#include <wrt_credentials.hxx>
+#include <wrt_crypto.hxx>
+#include <wrt_inventory.hxx>
+#include <wrt_config.hxx>
+#include <wrt_image.hxx>
+#include <wrt_metrics.hxx>
+#include <wrt_query.hxx>
+#include <wrt_render.hxx>
+#include <wrt_shards.hxx>
+#include <wrt_stream.hxx>
+#include <wrt_trace.hxx>
+#include <wrt_types.hxx>
+
+// SSH WRAPPER
+#include <ssh_session.hxx>
+#include <ssh_keys.hxx>
 
 using namespace wrt;
 
@@ -54,6 +88,31 @@ const auto kDefaultRemoteConfigDirectory("/etc/");
 const auto kDefaultCertDirectory("/etc/dropbear/");
 const auto kDefaultKeyType("id_dsa");
 const auto kDefaultInterface("eth0");
+const auto kDefaultSSHConfig("/etc/wrt/ssh_config");
+const auto kDefaultJournalFile("push.journal");
+const auto kDefaultAcceptedKeysFile("accepted_keys");
+const auto kDefaultLogFile("wrt.log");
+const auto kDefaultMetricsFile("wrt");
+const auto kInventoryImageSuffix(".image");
+const auto kWirelessConfigFile("wireless");
+const auto kPartialSuffix(".wrt-part");
+const auto kDefaultPrepareTimeout = 30;
+const auto kDefaultSyncLimit = 256;
+const auto kDefaultWirelessInterface("wlan0");
+const auto kDefaultDeferLimit = 45;        //Inside WRTd's 60 second run
+const auto kDefaultLoadPollInterval = 10;
+const auto kDefaultMetricsInterval = 15;
+
+//Remote commands
+const auto kCommitCommand("uci commit dhcp;"
+                          "uci commit 6relayd;"
+                          "uci commit dropbear;"
+                          "uci commit firewall;"
+                          "uci commit network;"
+                          "uci commit ubootenv;"
+                          "uci commit wireless");
+const auto kRestartCommand("wifi down;"
+                           "wifi up");
 
 //Root-less configuration elements
 const auto kVersion("Version");             //NEW!!!
@@ -72,47 +131,116 @@ const auto kConfigDirectory("Config_Dir");
 const auto kConfigurationFile("Config_File");
 const auto kLogDirectory("Log_Dir");
 const auto kLogLevel("Log_Level");
+const auto kLogMaxSize("Log_Max_Size");
+const auto kLogRotateInterval("Log_Rotate_Interval");
+const auto kLogKeep("Log_Keep");
+const auto kSyslog("Syslog");
+const auto kMetricsDirectory("Metrics_Dir");
+const auto kMetricsInterval("Metrics_Interval");
 const auto kPIDFile("PID_File");
 const auto kSSID("SSID");
 const auto kCrypto("Encryption");
 const auto kPassword("Wifi_Password");
 const auto kAPList("Access_Points");
-const auto kAPName("Name");
-const auto kAPType("Type");
-const auto kAPMAC("MAC");
-const auto kAPIPv6("IPv6");
-const auto kAPIPv4("IPv4");
+const auto kInventoryDirectory("Inventory_Dir");
+const auto kPushWindow("Push_Window");
+const auto kSyncLimit("Sync_Limit");
+const auto kMaintenanceWindow("Maintenance_Window");
+const auto kMaxStations("Max_Stations");
+const auto kMaxThroughput("Max_Throughput");
+const auto kDeferLimit("Defer_Limit");
+const auto kWirelessInterface("Wireless_Interface");
+const auto kCryptoProfiles("Crypto_Profiles");
+const auto kCiphers("Ciphers");
+const auto kKex("Kex");
+const auto kMACs("MACs");
 
 //Configuration Functions
 static void ParseCommandLineOptions(int argc, char **argv);
 
 static libconfig::Config &ReadConfigFile(std::string file = kDefaultConfigFile);
-static void WriteConfigFile(libconfig::Config &settings,
-                            std::string file = kDefaultConfigFile);
+static libconfig::Config &ReadSettings(std::string file = kDefaultConfigFile);
+static ConfigStore &GetConfigStore(std::string file = kDefaultConfigFile);
+static void WriteConfigFile(std::string file = kDefaultConfigFile);
+static void OpenLog(libconfig::Config &config);
 
 //Utility Functions
+static InventoryImage::Stamp InventoryStamp(libconfig::Config &config,
+                                            std::vector<std::string> &sources,
+                                            std::vector<std::string> &shards);
+static Inventory *ReadInventory(libconfig::Config &config,
+                                InventoryImage::Origins &origins,
+                                InventoryImage::Stamp *read = nullptr);
+static Inventory &GetInventory(libconfig::Config &config);
+static void RequestReload(int number);
+static bool ReloadInventory(libconfig::Config &config);
+static InventoryStream::Source GetInventorySource(libconfig::Config &config);
+static bool OpenInventoryImage(libconfig::Config &config);
 static APList &GetAPList(libconfig::Config &config);
+static InventoryImage &GetInventoryImage();
+static InventoryShards *GetInventoryShards(libconfig::Config &config);
+static FleetIndex &GetFleetIndex(libconfig::Config &config);
+static std::vector<AccessPoint> SelectAPs(libconfig::Config &config,
+                                          const FleetIndex::Selector &where);
+static void CommitInventory(Inventory::Batch &batch,
+                            libconfig::Config &config);
 static int ForkChild(int pipefd[] = NULL);
 static int WaitForChild(int PID, int options = 0);
+static void ExecRemote(AccessPoint &AP, std::string command,
+                       std::string identity = "");
+static int SpawnRemote(AccessPoint &AP, std::string command,
+                       int *input = NULL, int *output = NULL);
+static Checkpoint &GetCheckpoint();
+static Checkpoint &ReadCheckpoint();
+static Checkpoint::Step PushStep(AccessPoint &AP, Checkpoint &journal);
+static std::string KnownHostsPath();
+static Credentials &GetCredentials();
+static Credentials &GetIdentities();
+static CryptoProfile GetCryptoProfile(AccessPoint &AP);
+static void OpenSession(AccessPoint &AP, ssh::Session &session,
+                        const CryptoProfile *profile = nullptr);
+static PushMetrics &GetPushMetrics();
+static void WriteMetrics(bool periodic = false);
 
 //Print command block
 static void PrintAP(AccessPoint &AP, int index, int depth = 0);
 static void NameAP(AccessPoint &AP, int index, int depth = 0);
 static void ListAP(AccessPoint &AP, int depth = 0);
+static Renderer &GetRenderer();
+static void RenderAP(AccessPoint &AP);
+static void RenderPush(AccessPoint &AP, Checkpoint &journal, bool checked);
+static const char *PushResult(AccessPoint &AP, Checkpoint &journal,
+                              bool checked);
 
 //Add command block
-static void AddAPConfig(AccessPoint &AP);
-static void AddAPKey(AccessPoint &AP);
+static void AddAPConfig(AccessPoint &AP, Inventory::Batch &batch);
+static std::vector<std::string> AddAPKeys(APList &APs);
 
 //Remove command block
-static void RemoveAPConfig(AccessPoint &AP);
-static void RemoveAPKey(AccessPoint &AP);
+static void RemoveAPConfig(AccessPoint &AP, Inventory::Batch &batch);
+static void RemoveAPKey(AccessPoint &AP, KnownHosts &known_hosts);
 
 //Push command block
 static bool CheckConfig(AccessPoint &AP);
-static void PushConfig(AccessPoint &AP);
+static bool AcceptIdentity(AccessPoint &AP);
+static bool PushConfig(AccessPoint &AP, Checkpoint &journal);
+static off_t RemoteFileSize(AccessPoint &AP, std::string path);
+static std::string PartialPath(std::string remote);
+static bool TransferFile(AccessPoint &AP, std::string local,
+                         std::string remote, off_t offset);
 static void PushWirelessConfig(AccessPoint &AP);
 static void CommitConfig(AccessPoint &AP);
+static bool RestartWireless(AccessPoint &AP);
+static MaintenancePolicy &GetMaintenancePolicy();
+static bool MaintenanceAllows(AccessPoint &AP);
+static void ReloadStream(libconfig::Config &config, InventoryStream &stream,
+                         std::vector<AccessPoint> &selected,
+                         std::vector<uint64_t> &pushed);
+static void DeferredRestart(std::vector<AccessPoint *> &deferred,
+                            Checkpoint &journal);
+static void BenchmarkCrypto(libconfig::Config &config);
+static void SynchronizedCommit(std::vector<AccessPoint *> &prepared,
+                               Checkpoint &journal);
 
 //Command line output functions / command blocks
 static void Help();
@@ -123,11 +251,11 @@ static void Version();
  * PROGRAM MAIN                                                     [main-MA] *
  ******************************************************************************/
 
-//WRT output stream
-WRTout     wout,    //SLOPPY - refactor later
-           werr,    //TODO
-           wlog,    //TODO
-           wsyslog; //TODO
+//WRT output stream - one per thread, each with its own buffer and verbosity
+thread_local WRTout    wout,    //SLOPPY - refactor later
+                       werr;    //TODO
+thread_local WRTlog    wlog;    //Log_Dir/wrt.log, once OpenLog() is called
+thread_local WRTsyslog wsyslog; //syslog, if the configuration asks for it
 
 //Global flags and functions that must never be used by others
 namespace
@@ -136,12 +264,24 @@ APList PendingNodes;
 
 auto ConfigFile(kDefaultConfigFile);  //make this an extern also
 libconfig::Config State;              //make this extern later
-
-auto    Push   = false,
-        Force  = false,
-        List   = false,
-        Add    = false,
-        Remove = false;
+InventoryImage::Stamp ConfigStamp;    //wrt.cfg, as State was read from it
+InventoryImage::Stamp InventoryRead;  //wrt.cfg and shards, as last loaded
+Inventory *LiveInventory = nullptr;   //Loaded in full (a streamed push not)
+InventoryImage::Origins Origins;      //Shard each AP was read from
+volatile sig_atomic_t Reload = 0;     //SIGHUP received
+std::string TargetShard;              //Shard --add writes to ("" - wrt.cfg)
+FleetIndex::Selector Where;           //APs --where limits the operation to
+Renderer::Format OutputFormat = Renderer::Format::kText;
+std::string TracePath;                //Trace-event file --trace writes
+
+auto    Push      = false,
+        Force     = false,
+        Sync      = false,
+        List      = false,
+        Add       = false,
+        Remove    = false,
+        Benchmark = false,
+        Selecting = false;
 
 WRTout  out,
         err,
@@ -157,153 +297,474 @@ int main(int argc, char *argv[])
   try { // <---- fucking disgusting - depricate this trash
 
     ParseCommandLineOptions(argc, argv);
-    libconfig::Config &config = ReadConfigFile(ConfigFile);
+
+    if (!TracePath.empty()) {
+      Trace::Open(TracePath);
+    }
+
+    //During a push, SIGHUP re-reads the inventory at the next point it is
+    //safe to - any other command still ends on a hangup
+    if (Push) {
+      signal(SIGHUP, RequestReload);
+    }
+
+    libconfig::Config &config = State;
+
+    //A current inventory image answers --list without parsing wrt.cfg, or
+    //any shard - unless it is to select from the indexed inventory
+    if (!List || Selecting || !GetInventoryImage().open()) {
+      //A push or a listing reads its APs from the image (as does --where's
+      //index) - wrt.cfg's own list is only parsed should the image need
+      //compiling
+      if (Push || List) {
+        ReadSettings(ConfigFile);
+      } else {
+        ReadConfigFile(ConfigFile);
+      }
+
+      OpenLog(config);
+    }
 
     if (List) {
+      InventoryImage &image = GetInventoryImage();
       int index = 1;
 
       wout << Output::Verbosity::kBrief
            << "WRT APs Known:"
            << std::endl;
 
-      for (auto &AP : GetAPList(config)) {
-        PrintAP(AP.second, index, 1);
+      //Machine readable output renders each AP in place of printing it
+      void (*print)(AccessPoint &AP, int index) =
+        [](AccessPoint &AP, int index) { PrintAP(AP, index, 1); };
 
-        index++;
+      if (OutputFormat != Renderer::Format::kText) {
+        print = [](AccessPoint &AP, int) { RenderAP(AP); };
+      }
+
+      if (Selecting) {
+        for (auto &AP : SelectAPs(config, Where)) {
+          print(AP, index);
+
+          index++;
+        }
+
+      } else if (image.isOpen()) {
+        for (size_t i = 0; i < image.size(); ++i) {
+          AccessPoint AP = image.get(i).toAccessPoint();
+
+          print(AP, index);
+
+          index++;
+        }
+
+      } else {
+        for (auto &AP : GetAPList(config)) {
+          print(AP.second, index);
+
+          index++;
+        }
       }
 
-      if (GetAPList(config).empty()) {
+      if (index == 1) {
         wout << Output::Verbosity::kBrief
              << std::string(Output::kTabWidth, ' ')
              << "none" << std::endl;
       }
 
     } else if (Add) {
-      int index = 1, child, status;
+      int index = 1;
 
       wout << Output::Verbosity::kBrief
            << "Adding Host Information to System Config:"
            << std::endl;
 
+      Inventory::Batch requested, batch;
+
+      //The whole batch is checked before any AP is contacted
       for (auto &AP : PendingNodes) {
-        NameAP(AP.second, index, 1);
+        requested.add(AP.second);
+      }
 
-        if ((child = ForkChild())) { /* Parent */
-          if ((status = WaitForChild(child))) {
-            std::string failed_termination("Remove AP: Subprocess \"");
-            failed_termination += child;
-            failed_termination += "\" terminated with abnormal status (";
-            failed_termination += status;
-            failed_termination += "). Aborting.";
+      std::vector<std::string> conflicts =
+        GetInventory(config).validate(requested);
 
-            throw std::runtime_error(failed_termination);
+      for (auto &conflict : conflicts) {
+        wout << Output::Verbosity::kDefault
+             << "wrt: " << conflict << std::endl;
+      }
 
-          } else {
-            AddAPConfig(AP.second);
-            WriteConfigFile(config, ConfigFile);
-          }
+      if (!conflicts.empty()) {
+        throw std::runtime_error("Nothing added.");
+      }
+
+      //Every host key is collected at once, before the config is touched
+      std::vector<std::string> unreachable = AddAPKeys(PendingNodes);
+
+      for (auto &AP : PendingNodes) {
+        NameAP(AP.second, index, 1);
+
+        if (std::find(unreachable.begin(), unreachable.end(),
+                      AP.first) != unreachable.end()) {
+          wout << Output::Verbosity::kDefault
+               << "wrt: No host key collected from \"" << AP.second.getName()
+               << "\", not added." << std::endl;
 
-        } else { /* Child */
-          AddAPKey(AP.second);
+        } else {
+          AddAPConfig(AP.second, batch);
         }
 
         index++;
       }
 
+      CommitInventory(batch, config);
+
+      if (!unreachable.empty()) {
+        std::stringstream failed;
+        failed << unreachable.size() << " AP(s) could not be reached.";
+
+        throw std::runtime_error(failed.str());
+      }
+
     } else if (Remove) {
-      int index = 1, child, status;
+      int index = 1;
+      Inventory::Batch batch;
+      APList removing;
+
+      //A selector given to --remove stands for every AP it selects
+      for (auto &AP : PendingNodes) {
+        if (AP.first.find('=') == std::string::npos) {
+          removing.insert(AP);
+          continue;
+        }
+
+        for (auto &selected : SelectAPs(config,
+                                        FleetIndex::Selector::Parse(AP.first))) {
+          removing[selected.getName()] = AccessPoint(selected.getName(), "");
+        }
+      }
+
+      //known_hosts is read once, and written once after every removal
+      KnownHosts known_hosts(KnownHostsPath());
+      known_hosts.load();
 
       wout << Output::Verbosity::kBrief
            << "Removing Host Information from System Config:"
            << std::endl;
 
-      for (auto &AP : PendingNodes) {
+      for (auto &AP : removing) {
         NameAP(AP.second, index, 1);
 
-        if ((child = ForkChild())) {
-          if ((status = WaitForChild(child))) {
-            std::string failed_termination("Remove AP: Subprocess \"");
-            failed_termination += child;
-            failed_termination += "\" terminated with abnormal status (";
-            failed_termination += status;
-            failed_termination += "). Aborting.";
+        RemoveAPKey(AP.second, known_hosts);
+        RemoveAPConfig(AP.second, batch);
 
-            throw std::runtime_error(failed_termination);
+        index++;
+      }
 
-          } else {
-            RemoveAPConfig(AP.second);
-            WriteConfigFile(config, ConfigFile);
-          }
+      //Keys are only forgotten once the APs are gone from the inventory
+      CommitInventory(batch, config);
 
-        } else {
+      known_hosts.write();
 
-          RemoveAPKey(AP.second);
-        }
+    } else if (Benchmark) {
+      wout << Output::Verbosity::kBrief
+           << "Benchmarking SSH Crypto Profiles:"
+           << std::endl;
 
-        index++;
-      }
+      BenchmarkCrypto(config);
 
     } else if (Push) {
-      int index = 1, child, status;
+      int index = 1, child, status, window = InventoryStream::kDefaultWindow;
+      size_t unfinished = 0;
+      bool complete = true;
+
+      std::vector<AccessPoint *> prepared, deferred;
+      std::vector<AccessPoint> selected;
+      std::vector<uint64_t> pushed;
+      std::deque<AccessPoint> held;
+
+      config.lookupValue(kPushWindow, window);
+
+      Checkpoint &journal = GetCheckpoint();
+      PushMetrics &metrics = GetPushMetrics();
+      PushMetrics::Clock::time_point start;
+
+      //The keys APs accepted are read once, here, before any child is
+      //forked - ssh reads the identity itself, so none is parsed
+      Credentials &credentials = GetCredentials();
+
+      //A dead ssh must fail its transfer, not kill the push
+      signal(SIGPIPE, SIG_IGN);
 
       wout << Output::Verbosity::kBrief
            << "Updating Managed Hosts:"
            << std::endl;
 
-      for (auto &AP : GetAPList(config)) {
-        NameAP(AP.second, index, 1);
+      //APs are read a window at a time - only those a later phase still
+      //needs are kept beyond their window. A selector streams only the APs
+      //it selects.
+      if (Selecting) {
+        selected = SelectAPs(config, Where);
+      }
+
+      InventoryStream stream(Selecting ? InventoryStream::Of(selected)
+                                       : GetInventorySource(config),
+                             window > 0 ? window : 1);
+
+      while (stream.next()) {
+        for (auto &AP : stream.window()) {
+          Trace::Span traced("push", "ap", AP.getName());
+          std::string key = AP.getMAC();
+          size_t holding = held.size();
+          bool checked = false;
+
+          NameAP(AP, index, 1);
+
+          if (Force || CheckConfig(AP)) {
+            checked = true;
+
+            //ssh is given just the identity the AP accepts, once it is known
+            try {
+              if (credentials.getIdentityFile(key).empty() &&
+                  !AcceptIdentity(AP)) {
+                wout << Output::Verbosity::kVerbose
+                     << "No identity accepted, ssh falls back on ssh_config"
+                     << std::endl;
+              }
+
+            } catch (const std::exception &exception) {
+              PrintException(exception, 1);
+            }
 
-        if (Force || CheckConfig(AP.second)) {
+            if (journal.isComplete(key, Checkpoint::Step::kTransferred)) {
+              wout << Output::Verbosity::kVerbose
+                   << "Resuming: configuration already transferred"
+                   << std::endl;
 
-          if ((child = ForkChild())) {
-            if ((status = WaitForChild(child))) {
-              wout << Output::Verbosity::kDebug
-                   << "Subprocess " << child << ": Exited with status "
-                   << status << std::endl;
+            } else {
+              Trace::Span phase("transfer", "push", AP.getName());
+              bool transferred;
+
+              start = PushMetrics::Clock::now();
+              transferred = PushConfig(AP, journal);
+
+              metrics.record(AP.getName(), PushMetrics::Phase::kTransfer,
+                             start, transferred);
+
+              if (transferred) {
+                journal.mark(key, Checkpoint::Step::kTransferred);
+              }
             }
 
-          } else {
-            PushConfig(AP.second);
-          }
+            if (journal.isComplete(key, Checkpoint::Step::kSet)) {
+              wout << Output::Verbosity::kVerbose
+                   << "Resuming: wireless configuration already set"
+                   << std::endl;
+
+            } else if (journal.isComplete(key,
+                                          Checkpoint::Step::kTransferred)) {
+              Trace::Span phase("set", "push", AP.getName());
+
+              start = PushMetrics::Clock::now();
+
+              if ((child = ForkChild())) {
+                status = WaitForChild(child);
 
-          if ((child = ForkChild())) {
-            if ((status = WaitForChild(child))) {
-              wout << Output::Verbosity::kDebug
-                   << "Subprocess " << child << ": Exited with status "
-                   << status << std::endl;
+                metrics.record(AP.getName(), PushMetrics::Phase::kSet, start,
+                               !status);
+
+                if (status) {
+                  wout << level::kDebug
+                       << "Subprocess " << child << ": Exited with status "
+                       << status << std::endl;
+
+                } else {
+                  journal.mark(key, Checkpoint::Step::kSet);
+                }
+
+              } else {
+                PushWirelessConfig(AP);
+              }
             }
 
-          } else {
-            PushWirelessConfig(AP.second);
-          }
+            if (journal.isComplete(key, Checkpoint::Step::kCommitted)) {
+              wout << Output::Verbosity::kVerbose
+                   << "Resuming: configuration already committed"
+                   << std::endl;
+
+            } else if (Sync) {
+              //Phase one only stages - commits wait for every AP to prepare
+              if (journal.isComplete(key, Checkpoint::Step::kSet)) {
+                held.push_back(AP);
+                prepared.push_back(&held.back());
+              }
+
+            } else if (journal.isComplete(key, Checkpoint::Step::kSet)) {
+              Trace::Span phase("commit", "push", AP.getName());
+
+              start = PushMetrics::Clock::now();
 
-          if ((child = ForkChild())) {
-            if ((status = WaitForChild(child))) {
-              wout << Output::Verbosity::kDebug
-                   << "Subprocess " << child << ": Exited with status "
-                   << status << std::endl;
+              if ((child = ForkChild())) {
+                status = WaitForChild(child);
+
+                metrics.record(AP.getName(), PushMetrics::Phase::kCommit,
+                               start, !status);
+
+                if (status) {
+                  wout << level::kDebug
+                       << "Subprocess " << child << ": Exited with status "
+                       << status << std::endl;
+
+                } else {
+                  journal.mark(key, Checkpoint::Step::kCommitted);
+                }
+
+              } else {
+                CommitConfig(AP);
+              }
             }
 
-          } else {
-            CommitConfig(AP.second);
+            //Restarting the wireless drops clients - only when the AP
+            //allows
+            if (journal.isComplete(key, Checkpoint::Step::kRestarted)) {
+              wout << Output::Verbosity::kVerbose
+                   << "Resuming: wireless already restarted"
+                   << std::endl;
+
+            } else if (journal.isComplete(key, Checkpoint::Step::kCommitted)) {
+              if (!MaintenanceAllows(AP)) {
+                held.push_back(AP);
+                deferred.push_back(&held.back());
+
+              } else if (RestartWireless(AP)) {
+                journal.mark(key, Checkpoint::Step::kRestarted);
+              }
+            }
+
+            if (!journal.isComplete(key, Checkpoint::Step::kRestarted)) {
+              complete = false;
+              unfinished++;
+            }
           }
+
+          std::string step = checked ?
+                             Checkpoint::StepToString(PushStep(AP, journal)) :
+                             "skipped";
+
+          wlog << Output::Verbosity::kDefault
+               << "push \"" << AP.getName() << "\": " << step << std::endl;
+          wsyslog << "push \"" << AP.getName() << "\": " << step
+                  << std::endl;
+
+          //APs held for a later phase are counted (and rendered) once it is
+          //over
+          if (held.size() == holding) {
+            metrics.outcome(PushResult(AP, journal, checked));
+
+            if (OutputFormat != Renderer::Format::kText) {
+              RenderPush(AP, journal, checked);
+            }
+          }
+
+          WriteMetrics(true);
+
+          pushed.push_back(AP.getMACValue());
+          index++;
         }
 
-        index++;
+        ReloadStream(config, stream, selected, pushed);
+      }
+
+      if (Sync) {
+        Trace::Span phase("synchronized commit", "push");
+
+        SynchronizedCommit(prepared, journal);
+      }
+
+      if (!deferred.empty()) {
+        Trace::Span phase("deferred restart", "push");
+
+        DeferredRestart(deferred, journal);
+      }
+
+      //Every AP the first pass left unfinished but could still finish was
+      //held - the inventory need not be read again to know how they fared
+      if (Sync || !deferred.empty()) {
+        complete = unfinished == held.size();
+
+        for (auto &AP : held) {
+          complete = complete &&
+                     journal.isComplete(AP.getMAC(),
+                                        Checkpoint::Step::kRestarted);
+        }
+      }
+
+      for (auto &AP : held) {
+        metrics.outcome(PushResult(AP, journal, true));
+
+        if (OutputFormat != Renderer::Format::kText) {
+          RenderPush(AP, journal, true);
+        }
+      }
+
+      //Only a push that reached every AP may forget its progress - one to a
+      //selection has not
+      if (complete && !Selecting) {
+        journal.clear();
       }
+
+      credentials.write();
     }
 
+    //Whatever a push measured is written out for the last time
+    WriteMetrics();
+    Trace::Close();
+
   } catch (const std::exception &exception) {
 
+    //Whatever was rendered is still closed off, so it parses
+    if (OutputFormat != Renderer::Format::kText) {
+      try {
+        GetRenderer().finish();
+      } catch (...) {
+        //stdout is gone - the failure below is still reported
+      }
+    }
+
     std::cerr << std::endl << "wrt: Operation unsuccessful!" << std::endl;
 
     PrintException(exception, 1);
+
+    wlog << Output::Verbosity::kBrief
+         << "Operation unsuccessful: " << exception.what() << std::endl;
+    wsyslog << Syslog::LogLevel::kSyslogError
+            << "Operation unsuccessful: " << exception.what() << std::endl;
+    WriteMetrics();
+    FileLog::Close();
+    Syslog::Close();
+
+    //A trace of a failed run shows where it stopped
+    try {
+      Trace::Close();
+    } catch (...) {
+      //Nowhere left to report it
+    }
+
     std::exit(kExitFailure);
   }
 
+  if (OutputFormat != Renderer::Format::kText) {
+    GetRenderer().finish();
+  }
+
   wout << Output::Verbosity::kDefault
        << std::endl << "wrt: Operation completed successfully"
        << std::endl;
+
+  wlog << Output::Verbosity::kDefault
+       << "Operation completed successfully" << std::endl;
+  FileLog::Close();
+  Syslog::Close();
+
   std::exit(kExitSuccess);
 }
 
@@ -330,8 +791,14 @@ void ParseCommandLineOptions(int argc, char *argv[])
     {"list",    no_argument,       0, 'l'},
     {"add",     required_argument, 0, 'a'},
     {"remove",  required_argument, 0, 'r'},
+    {"shard",   required_argument, 0, 'S'},
+    {"where",   required_argument, 0, 'w'},
+    {"format",  required_argument, 0, 'o'},
+    {"trace",   required_argument, 0, 't'},
     {"push",    no_argument,       0, 'p'},
     {"force",   no_argument,       0, 'f'},
+    {"sync",    no_argument,       0, 's'},
+    {"benchmark", no_argument,     0, 'k'},
     {"usage",   no_argument,       0, 'u'},
     {"verbose", no_argument,       0, 'v'},
     {"brief",   no_argument,       0, 'q'},
@@ -343,25 +810,25 @@ void ParseCommandLineOptions(int argc, char *argv[])
   try {
     do {
       //TODO: Un-gnu this code - consider a wrt::Configuration library
-      command_line_option = getopt_long(argc, argv, "lfpuvbhqVc:a:r:",
+      command_line_option = getopt_long(argc, argv, "lfpskuvbhqVc:a:r:S:w:o:t:",
                                         long_options, &option_index);
 
       switch (command_line_option) {
       case 0:
-        wout << Output::Verbosity::kDebug2
+        wout << level::kDebug2
              << "Case Zero. Bad." << std::endl;
         //Forgot what this means
         break;
 
       case 'c':
-        wout << Output::Verbosity::kDebug1
+        wout << level::kDebug1
              << "Setting target configuration file to \""
              << optarg << "\"..." << std::endl;
         ConfigFile = optarg;
         break;
 
       case 'l':
-        wout << Output::Verbosity::kDebug1
+        wout << level::kDebug1
              << "Setting \"List\" operation flag..." << std::endl;
         List = true;
         break;
@@ -376,7 +843,7 @@ void ParseCommandLineOptions(int argc, char *argv[])
           std::exit(kExitFailure);
         }
 
-        wout << Output::Verbosity::kDebug1
+        wout << level::kDebug1
              << "Queue \"" << argv[optind - 1]
              << "\" to operations list - pending addition..."
              << std::endl;
@@ -384,6 +851,15 @@ void ParseCommandLineOptions(int argc, char *argv[])
         Add = true;
         PendingNodes[argv[optind - 1]] =
           AccessPoint(argv[optind - 1], argv[optind]);
+
+        if (!PendingNodes[argv[optind - 1]].hasMAC()) {
+          wout << Output::Verbosity::kBrief
+               << "wrt: \"" << argv[optind]
+               << "\" is not a MAC address." << std::endl;
+
+          std::exit(kExitFailure);
+        }
+
         optind++;
         break;
 
@@ -397,17 +873,87 @@ void ParseCommandLineOptions(int argc, char *argv[])
           std::exit(kExitFailure);
         }
 
-        wout << Output::Verbosity::kDebug1
+        wout << level::kDebug1
              << "Queue \"" << argv[optind - 1]
              << "\" to operations list - pending removal..."
              << std::endl;
 
+        //A selector is checked now, and expanded once the inventory is read
+        if (strchr(argv[optind - 1], '=')) {
+          try {
+            FleetIndex::Selector::Parse(argv[optind - 1]);
+
+          } catch (const std::runtime_error &error) {
+            wout << Output::Verbosity::kBrief
+                 << "wrt: " << error.what() << std::endl;
+
+            std::exit(kExitFailure);
+          }
+        }
+
         Remove = true;
         PendingNodes[argv[optind - 1]] = AccessPoint(argv[optind - 1], "");
         break;
 
+      case 'w':
+        try {
+          Where = FleetIndex::Selector::Parse(optarg);
+
+        } catch (const std::runtime_error &error) {
+          wout << Output::Verbosity::kBrief
+               << "wrt: " << error.what() << std::endl;
+
+          std::exit(kExitFailure);
+        }
+
+        wout << level::kDebug1
+             << "Selecting APs where \"" << optarg << "\"..."
+             << std::endl;
+
+        Selecting = true;
+        break;
+
+      case 'o':
+        try {
+          OutputFormat = Renderer::FormatFromString(optarg);
+
+        } catch (const std::runtime_error &error) {
+          wout << Output::Verbosity::kBrief
+               << "wrt: " << error.what() << std::endl;
+
+          std::exit(kExitFailure);
+        }
+
+        wout << level::kDebug1
+             << "Setting output format to \"" << optarg << "\"..."
+             << std::endl;
+        break;
+
+      case 't':
+        wout << level::kDebug1
+             << "Tracing to \"" << optarg << "\"..." << std::endl;
+
+        TracePath = optarg;
+        break;
+
+      case 'S':
+        if (!*optarg || strchr(optarg, '/')) {
+          wout << Output::Verbosity::kBrief
+               << "wrt: \"" << optarg
+               << "\" is not a shard name." << std::endl;
+
+          std::exit(kExitFailure);
+        }
+
+        wout << level::kDebug1
+             << "Setting target shard to \"" << optarg << "\"..."
+             << std::endl;
+
+        TargetShard = optarg;
+        break;
+
       case 'p':
-        wout << Output::Verbosity::kDebug1
+        wout << level::kDebug1
              << "Push flag set..."
              << std::endl;
 
@@ -415,13 +961,29 @@ void ParseCommandLineOptions(int argc, char *argv[])
         break;
 
       case 'f':
-        wout << Output::Verbosity::kDebug1
+        wout << level::kDebug1
              << "Force flag set..."
              << std::endl;
 
         Force = true;
         break;
 
+      case 's':
+        wout << level::kDebug1
+             << "Sync flag set..."
+             << std::endl;
+
+        Sync = true;
+        break;
+
+      case 'k':
+        wout << level::kDebug1
+             << "Benchmark flag set..."
+             << std::endl;
+
+        Benchmark = true;
+        break;
+
       case 'v':
         wout << Output::Verbosity::kVerbose
              << "Verbosity flag set...";
@@ -473,30 +1035,35 @@ void ParseCommandLineOptions(int argc, char *argv[])
 
     } while (command_line_option != -1);
 
-    wout << Output::Verbosity::kDebug
+    wout << level::kDebug
          << "ParseCommandLineOptions:"
          << std::endl;
 
-    wout << Output::Verbosity::kDebug1
+    wout << level::kDebug1
          << "ParseCommandLineOptions( "
          << argc << ", [";
 
     for (int i = 1; i < argc; ++i) {
-      wout << Output::Verbosity::kDebug1
+      wout << level::kDebug1
            << argv[i]
            << " ";
     }
 
-    wout << Output::Verbosity::kDebug1
+    wout << level::kDebug1
          << "] )"
          << std::endl;
 
-    if (!Push && !Force && !List && !Add && !Remove) {
+    if (!Push && !Force && !List && !Add && !Remove && !Benchmark) {
       Usage();
 
       std::exit(kExitFailure);
     }
 
+    //Records own stdout - nothing else may be written between them
+    if (OutputFormat != Renderer::Format::kText) {
+      wrt::OutputLevel = Output::Verbosity::kSquelch;
+    }
+
     wout << Output::Verbosity::kVerbose
          << "WRT Configuration:"              << std::endl
          << "\tConfig File: " << ConfigFile   << std::endl
@@ -507,9 +1074,12 @@ void ParseCommandLineOptions(int argc, char *argv[])
          << "Program State"   << std::endl
          << "\tPush   flag: " << Push   << std::endl
          << "\tForce  flag: " << Force  << std::endl
+         << "\tSync   flag: " << Sync   << std::endl
          << "\tList   flag: " << List   << std::endl
          << "\tAdd    flag: " << Add    << std::endl
          << "\tRemove flag: " << Remove << std::endl
+         << "\tBench  flag: " << Benchmark << std::endl
+         << "\tWhere:       " << Where.getText() << std::endl
          << std::noboolalpha            << std::endl;
 
   } catch (...) {
@@ -518,6 +1088,26 @@ void ParseCommandLineOptions(int argc, char *argv[])
   }
 }
 
+/**
+ * Returns the store every change to the configuration file goes through
+ *
+ * @method  GetConfigStore
+ *
+ * @param   file        Configuration file (only used on the first call)
+ *
+ * @return              Store of the configuration file
+ */
+ConfigStore &GetConfigStore(std::string file)
+{
+  static ConfigStore *store = nullptr;
+
+  if (!store) {
+    store = new ConfigStore(file, State);
+  }
+
+  return *store;
+}
+
 /**
  * Reads a configuration file
  *
@@ -531,7 +1121,11 @@ libconfig::Config &ReadConfigFile(std::string file)
   if (!State.exists(kAPList)) {
     try {
       try {
-        State.readFile(file.c_str());
+        //Noted before reading - if the file changes meanwhile, the inventory
+        //image compiled from State is merely judged stale
+        ConfigStamp = InventoryImage::Stamp::Of(file);
+
+        GetConfigStore(file).read();
 
       } catch (libconfig::FileIOException &e) {
         std::string read_error(1, '"');
@@ -551,21 +1145,99 @@ libconfig::Config &ReadConfigFile(std::string file)
 }
 
 /**
- * Writes given settings to a configuration file
+ * Reads a configuration file's settings, leaving its Access_Points list
+ * unparsed - ReadInventory() reads the list after all, if it is needed
+ *
+ * @param  file file to read, defaults to /etc/wrt/wrt.cfg
+ *
+ * @return libconfig::Configuration object containing the settings
+ */
+libconfig::Config &ReadSettings(std::string file)
+{
+  try {
+    try {
+      ConfigStamp = InventoryImage::Stamp::Of(file);
+
+      GetConfigStore(file).read(kAPList);
+
+    } catch (libconfig::FileIOException &e) {
+      std::string read_error(1, '"');
+      read_error += file;
+      read_error += "\": could not be read from disk.";
+
+      std::throw_with_nested(std::runtime_error(read_error));
+    }
+
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error("ReadSettings(std::string)"
+                           " failed."));
+  }
+
+  return State;
+}
+
+/**
+ * Opens the log file - Log_Dir/wrt.log, rotated as Log_Max_Size (bytes),
+ * Log_Rotate_Interval (seconds) and Log_Keep say - and sets the level it is
+ * written at from Log_Level. A log which cannot be opened is not an error;
+ * records are simply not written. syslog is opened too, if Syslog is true.
+ *
+ * @method  OpenLog
+ *
+ * @param   config      Configuration naming the log
+ */
+void OpenLog(libconfig::Config &config)
+{
+  LogSink::Rotation rotation;
+  std::string directory;
+  int level = static_cast<int>(LogLevel), max_size = rotation.max_size,
+      interval = rotation.interval, keep = rotation.keep;
+  bool syslog = false;
+
+  if (config.lookupValue(kSyslog, syslog) && syslog) {
+    Syslog::Open("wrt", LOG_DAEMON);
+  }
+
+  if (!config.lookupValue(kLogDirectory, directory)) {
+    return;
+  }
+
+  config.lookupValue(kLogLevel, level);
+  config.lookupValue(kLogMaxSize, max_size);
+  config.lookupValue(kLogRotateInterval, interval);
+  config.lookupValue(kLogKeep, keep);
+
+  LogLevel           = static_cast<Output::Verbosity>(level);
+  rotation.max_size  = max_size > 0 ? max_size : 0;
+  rotation.interval  = interval > 0 ? interval : 0;
+  rotation.keep      = keep > 0 ? keep : 0;
+
+  if (!directory.empty() && directory.back() != '/') {
+    directory += '/';
+  }
+
+  FileLog::Open(directory + kDefaultLogFile, rotation);
+
+  wlog << Output::Verbosity::kDefault
+       << "wrt " << getpid() << " started, config \"" << ConfigFile << "\""
+       << std::endl;
+}
+
+/**
+ * Writes the changes queued on the configuration store to its file
  *
  * @method  WriteConfigFile
  *
- * @param   settings         config to be written
  * @param   file             file to write to
  */
-void WriteConfigFile(libconfig::Config &settings, std::string file)
+void WriteConfigFile(std::string file)
 {
   try {
     try {
 
-      settings.writeFile(ConfigFile);
+      GetConfigStore(file).flush();
 
-    } catch (libconfig::FileIOException &e) {
+    } catch (...) {
       std::string error = "\"" + file + "\": could not be written to disk.";
 
       std::throw_with_nested(std::runtime_error(error));
@@ -573,8 +1245,7 @@ void WriteConfigFile(libconfig::Config &settings, std::string file)
 
   } catch (...) {
     std::throw_with_nested(std::runtime_error("WriteConfigFile"
-                           "(libconfig::Config &)"
-                           " failed."));
+                           "(std::string) failed."));
   }
 
   return;
@@ -629,41 +1300,620 @@ std::string SCPTarget(AccessPoint &AP)
   return target;
 }
 
-APList &GetAPList(libconfig::Config &config)
+/**
+ * Returns the identity of every file the inventory is read from, as they
+ * are now
+ *
+ * @method  InventoryStamp
+ *
+ * @param   config      Configuration holding the managed APs
+ * @param   sources     Files the inventory is read from, set
+ * @param   shards      Shards among them, set
+ *
+ * @return              Their identity
+ */
+InventoryImage::Stamp InventoryStamp(libconfig::Config &config,
+                                     std::vector<std::string> &sources,
+                                     std::vector<std::string> &shards)
 {
-  static APList APs;
+  InventoryShards *directory = GetInventoryShards(config);
+  InventoryImage::Stamp stamp = ConfigStamp;
 
-  if (APs.empty()) {
-    try {
-      libconfig::Setting &list = State.getRoot()[kAPList];
-
-      for (int i = 0; i < list.getLength(); ++i) {
-        std::string name = list[i][kAPName],
-                    type = list[i][kAPType],
-                    mac  = list[i][kAPMAC],
-                    ipv4 = list[i][kAPIPv4],
-                    ipv6 = list[i][kAPIPv6];
-
-        APs[name] = AccessPoint(name, mac, type);
-        APs[name].setIPv4(ipv4);
-        APs[name].setIPv6(ipv6);
-      }
+  sources.assign(1, ConfigFile);
+  shards.clear();
 
-    } catch (...) {
-      std::throw_with_nested(std::runtime_error("GetAPList"
-                             "(libconfig::Config &) failed."));
+  //Like wrt.cfg, the directory and every shard are noted before any is
+  //read - one changing meanwhile merely leaves the image stale
+  if (directory) {
+    shards = directory->list();
+
+    sources.push_back(directory->getDirectory());
+    sources.insert(sources.end(), shards.begin(), shards.end());
+
+    for (size_t i = 1; i < sources.size(); ++i) {
+      stamp.fold(InventoryImage::Stamp::Of(sources[i]));
     }
   }
 
-  return (APs);
+  return stamp;
 }
 
-int ForkChild(int pipefd[])
+/**
+ * Reads the inventory of managed APs - from the inventory image if it is
+ * current, otherwise from the configuration and its shards, compiling a
+ * new image
+ *
+ * @method  ReadInventory
+ *
+ * @param   config      Configuration holding the managed APs
+ * @param   origins     Shard each AP was read from, set
+ * @param   read        Identity of the files read, set (unless null)
+ *
+ * @return              A new inventory
+ */
+Inventory *ReadInventory(libconfig::Config &config,
+                         InventoryImage::Origins &origins,
+                         InventoryImage::Stamp *read)
 {
+  Trace::Span traced("read inventory", "inventory");
+  InventoryImage &image = GetInventoryImage();
+  InventoryShards *shards = GetInventoryShards(config);
+  std::unique_ptr<Inventory> inventory(new Inventory());
+  std::vector<std::string> sources, paths;
+  InventoryImage::Stamp stamp = InventoryStamp(config, sources, paths);
+
+  if (read) {
+    *read = stamp;
+  }
+
+  //The image holds exactly what was read - skip the settings
+  if (image.isOpen() || image.open(stamp)) {
+    for (size_t i = 0; i < image.size(); ++i) {
+      InventoryImage::View view = image.get(i);
+
+      if (*view.origin) {
+        origins[view.name] = view.origin;
+      }
+
+      inventory->insert(view.toAccessPoint());
+    }
+
+    return inventory.release();
+  }
+
+  //wrt.cfg first, then the shards in order - the first AP read under a
+  //name or MAC is the one kept
+  auto merge = [&inventory, &origins](
+    std::vector<AccessPoint> &APs, const std::vector<std::string> &malformed,
+    const std::string &origin) {
+    std::string where = origin.empty() ? "" : origin + ": ";
+
+    for (auto &name : malformed) {
+      wout << Output::Verbosity::kDefault
+           << "wrt: " << where << "\"" << name
+           << "\" has a malformed MAC or address." << std::endl;
+    }
+
+    for (auto &AP : APs) {
+      if (!inventory->insert(AP)) {
+        wout << Output::Verbosity::kDefault
+             << "wrt: " << where << "\"" << AP.getName()
+             << "\" duplicates another AP, ignored." << std::endl;
+
+      } else if (!origin.empty()) {
+        origins[AP.getName()] = origin;
+      }
+    }
+  };
+
+  std::vector<AccessPoint> APs;
+  std::vector<std::string> malformed;
+
+  //wrt.cfg was read without its APs, for a push - they are needed now
+  if (GetConfigStore(ConfigFile).partial()) {
+    ConfigStamp = InventoryImage::Stamp::Of(ConfigFile);
+    GetConfigStore(ConfigFile).read();
+  }
+
+  InventoryShards::ReadAPs(config, APs, malformed);
+  merge(APs, malformed, "");
+
+  if (shards) {
+    shards->load(paths);
+
+    for (size_t i = 0; i < shards->size(); ++i) {
+      merge(shards->getAPs(i), shards->getMalformed(i), shards->getPath(i));
+    }
+
+    //A shard a change touches is read again, then - nothing else needs them
+    shards->clear();
+  }
+
+  //An image is only an accelerator - failing to write one is no error
+  try {
+    InventoryImage::Write(std::string(ConfigFile) + kInventoryImageSuffix,
+                          sources, stamp, inventory->getAPList(), origins);
+
+  } catch (std::exception &e) {
+    wout << level::kDebug
+         << "Inventory image not written: " << e.what() << std::endl;
+  }
+
+  return inventory.release();
+}
+
+/**
+ * Returns the inventory of managed APs, loaded from the configuration once
+ *
+ * @method  GetInventory
+ *
+ * @param   config      Configuration holding the managed APs
+ *
+ * @return              Inventory, indexed by name, MAC and address
+ */
+Inventory &GetInventory(libconfig::Config &config)
+{
+  if (!LiveInventory) {
+    try {
+      LiveInventory = ReadInventory(config, Origins, &InventoryRead);
+
+    } catch (...) {
+      std::throw_with_nested(std::runtime_error("GetInventory"
+                             "(libconfig::Config &) failed."));
+    }
+  }
+
+  return *LiveInventory;
+}
+
+/**
+ * Notes a SIGHUP - the inventory is re-read by the next ReloadInventory()
+ *
+ * @method  RequestReload
+ *
+ * @param   number      Signal received
+ */
+void RequestReload(int /* number */)
+{
+  Reload = 1;
+}
+
+/**
+ * Re-reads the inventory if SIGHUP asked for it, or a file it was read from
+ * has changed, and applies only the difference to the live inventory. APs
+ * which did not change are not touched - whatever is held on to them (their
+ * sessions, cached keys and profiles) stays valid.
+ *
+ * @method  ReloadInventory
+ *
+ * @param   config      Configuration holding the managed APs
+ *
+ * @return              true if the inventory changed
+ */
+bool ReloadInventory(libconfig::Config &config)
+{
+  std::vector<std::string> sources, paths;
+  bool requested = Reload;
+
+  Reload = 0;
+
+  try {
+    InventoryImage::Stamp current = InventoryImage::Stamp::Of(ConfigFile);
+
+    //wrt.cfg goes first - it says where the shards are
+    if (requested || !(current == ConfigStamp)) {
+      GetConfigStore(ConfigFile).read();
+      ConfigStamp = current;
+    }
+
+    if (!requested &&
+        InventoryStamp(config, sources, paths) == InventoryRead) {
+      return false;
+    }
+
+    InventoryImage::Origins origins;
+    InventoryImage::Stamp read;
+
+    //The image mapped is of the inventory as it was
+    GetInventoryImage().close();
+
+    std::unique_ptr<Inventory> fresh(ReadInventory(config, origins, &read));
+
+    //A streamed push never loaded the inventory - there is nothing to apply
+    //the difference to, so the inventory just read becomes the live one
+    if (!LiveInventory) {
+      LiveInventory = fresh.release();
+      Origins.swap(origins);
+      InventoryRead = read;
+
+      wout << Output::Verbosity::kDefault
+           << "wrt: Inventory reloaded." << std::endl;
+
+      return true;
+    }
+
+    Inventory &live = *LiveInventory;
+    Inventory::Batch batch = live.diff(*fresh);
+    std::vector<std::string> conflicts = live.apply(batch);
+
+    for (auto &conflict : conflicts) {
+      wout << Output::Verbosity::kDefault
+           << "wrt: " << conflict << std::endl;
+    }
+
+    if (!conflicts.empty()) {
+      throw std::runtime_error("ReloadInventory(): inventory left unchanged.");
+    }
+
+    Origins.swap(origins);
+    InventoryRead = read;
+
+    //An AP both removed and added is one which changed
+    std::unordered_set<std::string> removed(batch.getRemoved().begin(),
+                                            batch.getRemoved().end());
+    size_t changed = 0;
+
+    for (auto &AP : batch.getAdded()) {
+      changed += removed.count(AP.getName());
+    }
+
+    wout << Output::Verbosity::kDefault
+         << "wrt: Inventory reloaded - "
+         << batch.getAdded().size() - changed << " added, "
+         << batch.getRemoved().size() - changed << " removed, "
+         << changed << " changed." << std::endl;
+
+    return !batch.empty();
+
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error("ReloadInventory"
+                           "(libconfig::Config &) failed."));
+  }
+}
+
+/**
+ * Returns the managed APs one at a time, without holding the inventory in
+ * memory - they are read from the inventory image, which is compiled first
+ * if it is stale. Should no image be written, the inventory is loaded.
+ *
+ * @method  GetInventorySource
+ *
+ * @param   config      Configuration holding the managed APs
+ *
+ * @return              Source of every managed AP
+ */
+InventoryStream::Source GetInventorySource(libconfig::Config &config)
+{
+  if (OpenInventoryImage(config)) {
+    return InventoryStream::Of(GetInventoryImage());
+  }
+
+  return InventoryStream::Of(GetAPList(config));
+}
+
+/**
+ * Maps the inventory image, compiling it first if it is stale
+ *
+ * @method  OpenInventoryImage
+ *
+ * @param   config      Configuration holding the managed APs
+ *
+ * @return              true if a current image is mapped
+ */
+bool OpenInventoryImage(libconfig::Config &config)
+{
+  InventoryImage &image = GetInventoryImage();
+
+  try {
+    std::vector<std::string> sources, paths;
+    InventoryImage::Stamp stamp = InventoryStamp(config, sources, paths);
+
+    if (!image.isOpen()) {
+      InventoryImage::Origins origins;
+
+      //Compiling the image reads the whole inventory, but only for now
+      if (!image.open(stamp)) {
+        delete ReadInventory(config, origins);
+        image.open(stamp);
+      }
+    }
+
+    //A reload compares against what the stream reads, not a load never made
+    if (!LiveInventory) {
+      InventoryRead = stamp;
+    }
+
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error("OpenInventoryImage"
+                           "(libconfig::Config &) failed."));
+  }
+
+  return image.isOpen();
+}
+
+APList &GetAPList(libconfig::Config &config)
+{
+  return GetInventory(config).getAPList();
+}
+
+/**
+ * Returns the compiled inventory image kept beside the configuration file
+ *
+ * @method  GetInventoryImage
+ *
+ * @return  Image (mapped only once opened against wrt.cfg)
+ */
+InventoryImage &GetInventoryImage()
+{
+  static InventoryImage *image = nullptr;
+
+  if (!image) {
+    image = new InventoryImage(std::string(ConfigFile) +
+                               kInventoryImageSuffix);
+  }
+
+  return *image;
+}
+
+/**
+ * Returns the inventory shards, if the configuration names a directory of
+ * them
+ *
+ * @method  GetInventoryShards
+ *
+ * @param   config      Configuration naming the directory
+ *
+ * @return              Shards (nullptr if Inventory_Dir is not set)
+ */
+InventoryShards *GetInventoryShards(libconfig::Config &config)
+{
+  static InventoryShards *shards = nullptr;
+  static std::string named;
+  std::string directory;
+
+  config.lookupValue(kInventoryDirectory, directory);
+
+  //A reload may have moved, or dropped, the directory
+  if (directory != named) {
+    delete shards;
+
+    shards = directory.empty() ? nullptr : new InventoryShards(directory);
+    named  = directory;
+  }
+
+  return shards;
+}
+
+/**
+ * Returns the index of the managed APs --where selects from. Unless the
+ * inventory is already loaded, it is built straight from the inventory
+ * image, and the inventory never loaded. It is built again only after the
+ * inventory changes (a commit, or a reload).
+ *
+ * @method  GetFleetIndex
+ *
+ * @param   config      Configuration holding the managed APs
+ *
+ * @return              Index of the inventory
+ */
+FleetIndex &GetFleetIndex(libconfig::Config &config)
+{
+  static FleetIndex *index = nullptr;
+  static uint64_t revision = 0;
+  static InventoryImage::Stamp imaged;
+  static bool mapped = false;
+
+  if (!LiveInventory && OpenInventoryImage(config)) {
+    InventoryImage &image = GetInventoryImage();
+
+    //An image is of exactly the files it was compiled from
+    if (!index || !mapped || !(imaged == InventoryRead)) {
+      delete index;
+
+      index  = new FleetIndex(image.size(), [&image](size_t id) {
+        return image.get(id).toAccessPoint();
+      });
+      imaged = InventoryRead;
+      mapped = true;
+
+      wout << level::kDebug1
+           << index->size() << " APs indexed for selection, from the image"
+           << std::endl;
+    }
+
+    return *index;
+  }
+
+  Inventory &inventory = GetInventory(config);
+
+  if (!index || mapped || revision != inventory.getRevision()) {
+    std::shared_ptr<std::vector<AccessPoint *> > APs(
+      new std::vector<AccessPoint *>());
+
+    for (auto &AP : inventory.getAPList()) {
+      APs->push_back(&AP.second);
+    }
+
+    delete index;
+
+    index    = new FleetIndex(APs->size(), [APs](size_t id) {
+      return *(*APs)[id];
+    });
+    revision = inventory.getRevision();
+    mapped   = false;
+
+    wout << level::kDebug1
+         << index->size() << " APs indexed for selection" << std::endl;
+  }
+
+  return *index;
+}
+
+/**
+ * Returns the managed APs a selector selects. The index answers the name,
+ * type and net terms; push terms are checked only against the APs it
+ * gives, by the furthest step the journal has each at.
+ *
+ * @method  SelectAPs
+ *
+ * @param   config      Configuration holding the managed APs
+ * @param   where       Selector to match
+ *
+ * @return              The APs selected
+ */
+std::vector<AccessPoint> SelectAPs(libconfig::Config &config,
+                                   const FleetIndex::Selector &where)
+{
+  std::vector<AccessPoint> selected;
+
+  try {
+    for (auto &AP : GetFleetIndex(config).select(where)) {
+      bool matched = true;
+
+      for (auto &term : where.getStatus()) {
+        Checkpoint::Step step = PushStep(AP, ReadCheckpoint());
+        std::string status = Checkpoint::StepToString(step);
+
+        //pending - anything short of restarted
+        if (step != Checkpoint::Step::kRestarted &&
+            std::find(term.values.begin(), term.values.end(),
+                      "pending") != term.values.end()) {
+          status = "pending";
+        }
+
+        matched = matched && std::find(term.values.begin(), term.values.end(),
+                                       status) != term.values.end();
+      }
+
+      if (matched) {
+        selected.push_back(AP);
+      }
+    }
+
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error("SelectAPs(libconfig::Config &,"
+                           " const FleetIndex::Selector &) failed."));
+  }
+
+  return selected;
+}
+
+/**
+ * Applies a batch of additions and removals to the inventory, and writes
+ * the files holding the APs it touches - each once, however many APs the
+ * batch touches, and no other
+ *
+ * @method  CommitInventory
+ *
+ * @param   batch       Changes to apply
+ * @param   config      Configuration to write the inventory to
+ */
+void CommitInventory(Inventory::Batch &batch, libconfig::Config &config)
+{
+  Inventory &inventory = GetInventory(config);
+  InventoryShards *shards = GetInventoryShards(config);
+
+  std::unordered_set<std::string> names, macs;
+  std::vector<AccessPoint> added = batch.getAdded();
+  std::set<std::string> touched;
+  std::string target = ConfigFile;
+
+  if (batch.empty()) {
+    return;
+  }
+
+  if (!TargetShard.empty()) {
+    if (!shards) {
+      throw std::runtime_error("CommitInventory(): --shard needs " +
+                               std::string(kInventoryDirectory) +
+                               " set in \"" + ConfigFile + "\".");
+    }
+
+    target = shards->pathOf(TargetShard);
+  }
+
+  //Resolve what the batch removes, and from where, while those APs are
+  //still indexed
+  for (auto &key : batch.getRemoved()) {
+    AccessPoint *removed = inventory.find(key);
+
+    if (removed) {
+      auto origin = Origins.find(removed->getName());
+
+      names.insert(removed->getName());
+      macs.insert(Inventory::MACKey(removed->getMAC()));
+      touched.insert(origin == Origins.end() ? std::string(ConfigFile)
+                                             : origin->second);
+    }
+  }
+
+  for (auto &AP : added) {
+    names.insert(AP.getName());
+  }
+
+  if (!added.empty()) {
+    touched.insert(target);
+  }
+
+  std::vector<std::string> conflicts = inventory.apply(batch);
+
+  for (auto &conflict : conflicts) {
+    wout << Output::Verbosity::kDefault
+         << "wrt: " << conflict << std::endl;
+  }
+
+  if (!conflicts.empty()) {
+    throw std::runtime_error("CommitInventory(): inventory left unchanged.");
+  }
+
+  try {
+    //Replayable on a newer file: each file touched drops every entry the
+    //batch replaces, and the target then gains the additions
+    for (auto &file : touched) {
+      ConfigStore &store = (file == ConfigFile) ? GetConfigStore()
+                                                : shards->getStore(file);
+
+      store.mutate(InventoryShards::Replace(names, macs,
+                                            file == target ? added :
+                                            std::vector<AccessPoint>()));
+    }
+
+    for (auto &name : names) {
+      Origins.erase(name);
+    }
+
+    if (target != ConfigFile) {
+      for (auto &AP : added) {
+        Origins[AP.getName()] = target;
+      }
+    }
+
+    //Files the batch did not touch have nothing queued, and are not written
+    WriteConfigFile(ConfigFile);
+
+    if (shards) {
+      shards->flush();
+    }
+
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error("CommitInventory"
+                           "(Inventory::Batch &, libconfig::Config &)"
+                           " failed."));
+  }
+}
+
+int ForkChild(int pipefd[])
+{
+  Trace::Clock::time_point start = Trace::Clock::now();
   int child;
 
   if ((child = fork()) != -1) {  //Parent
-    wout << Output::Verbosity::kDebug2
+    if (child) {
+      Trace::Complete("fork", "process", start);
+      Trace::Started(child, "child");
+    }
+
+    wout << level::kDebug2
          << "Child process spawned... PID:"
          << child << std::endl;
 
@@ -690,14 +1940,16 @@ int WaitForChild(int PID, int options)
 {
   int wait_pid, status;
 
-  wout << Output::Verbosity::kDebug2
+  wout << level::kDebug2
        << "Waiting for child \"" << PID << "\""
        << std::endl;
 
   wait_pid = waitpid(PID, &status, options);
 
   if (wait_pid == PID) {
-    wout << Output::Verbosity::kDebug2
+    Trace::Exited(PID);
+
+    wout << level::kDebug2
          << "Child process termination."
          << std::endl;
 
@@ -705,7 +1957,17 @@ int WaitForChild(int PID, int options)
     throw std::runtime_error("WaitForChild(int, int *, int) failed.");
   }
 
-  wout << Output::Verbosity::kDebug3
+  //A child killed by a signal must never read as a success
+  if (!WIFEXITED(status)) {
+    wout << level::kDebug3
+         << "Child process killed by signal "
+         << WTERMSIG(status)
+         << std::endl << std::flush;
+
+    return 128 + WTERMSIG(status);
+  }
+
+  wout << level::kDebug3
        << "Child process exit status: "
        << WEXITSTATUS(status)
        << std::endl << std::flush;
@@ -713,20 +1975,518 @@ int WaitForChild(int PID, int options)
   return WEXITSTATUS(status);
 }
 
-/******************************************************************************
- * DRIVER FUNCTIONS                                                 [main-DR] *
- ******************************************************************************/
-
 /**
- * Function that prints all features of a  single AP, it's meant to
- * write out a detailled illustration of an AP.
+ * Quotes a string for use as a single word in a remote shell command
  *
- * @method  PrintAP
+ * @method  ShellQuote
  *
- * @param   AP       AccessPoint object to list data for
- * @param   index    Index to print. An index of 0 is omitted
- *                   (remember: index, not offset)
- * @param   depth    Depth to begin indenting at
+ * @param   word        String to quote
+ *
+ * @return              word, single quoted
+ */
+std::string ShellQuote(std::string word)
+{
+  std::string quoted(1, '\'');
+
+  for (auto c : word) {
+    if (c == '\'') {
+      quoted += "'\\''";
+    } else {
+      quoted += c;
+    }
+  }
+
+  quoted += '\'';
+  return quoted;
+}
+
+/**
+ * Replaces the process with ssh running a command on an AP. The AP type's
+ * crypto profile is passed on the command line. If the AP is known to
+ * accept one of our identities, ssh is given only that one - so it reads
+ * and offers a single key, not every key in ssh_config.
+ *
+ * @method  ExecRemote
+ *
+ * @param   AP          AP to run the command on
+ * @param   command     Remote shell command
+ * @param   identity    Identity file to offer alone, if not the AP's own
+ */
+void ExecRemote(AccessPoint &AP, std::string command, std::string identity)
+{
+  std::string target(getTarget(AP));
+
+  try {
+    if (identity.empty()) {
+      identity = GetCredentials().getIdentityFile(AP.getMAC());
+    }
+  } catch (...) {
+    //Without the credential manager, ssh falls back on ssh_config
+  }
+
+  std::vector<const char *> arguments = { "ssh", "-F", kDefaultSSHConfig };
+  std::vector<std::string> crypto = GetCryptoProfile(AP).getSSHArguments();
+
+  for (auto &argument : crypto) {
+    arguments.push_back(argument.c_str());
+  }
+
+  if (!identity.empty()) {
+    arguments.push_back("-i");
+    arguments.push_back(identity.c_str());
+    arguments.push_back("-o");
+    arguments.push_back("IdentitiesOnly=yes");
+  }
+
+  arguments.push_back(target.c_str());
+  arguments.push_back(command.c_str());
+  arguments.push_back(NULL);
+
+  execvp("ssh", const_cast<char * const *>(arguments.data()));
+
+  _exit(kExitFailure);
+}
+
+/**
+ * Spawns ssh to run a command on an AP, optionally wiring the command's
+ * stdin and stdout to pipes held by the caller
+ *
+ * @method  SpawnRemote
+ *
+ * @param   AP          AP to run the command on
+ * @param   command     Remote shell command
+ * @param   input       If given, set to a fd writing to the command's stdin
+ * @param   output      If given, set to a fd reading the command's stdout
+ *
+ * @return              PID of the ssh child process
+ */
+int SpawnRemote(AccessPoint &AP, std::string command, int *input, int *output)
+{
+  int to_child[2] = { -1, -1 }, from_child[2] = { -1, -1 }, child;
+  Trace::Clock::time_point start = Trace::Clock::now();
+
+  if ((input && pipe(to_child)) || (output && pipe(from_child))) {
+    throw std::runtime_error("pipe(): returned -1");
+  }
+
+  if ((child = fork()) == -1) {
+    throw std::runtime_error("fork(): returned -1");
+  }
+
+  if (!child) { /* Child */
+    if (input) {
+      dup2(to_child[0], STDIN_FILENO);
+      close(to_child[0]);
+      close(to_child[1]);
+    } else {
+      close(STDIN_FILENO);
+    }
+
+    if (output) {
+      dup2(from_child[1], STDOUT_FILENO);
+      close(from_child[0]);
+      close(from_child[1]);
+    } else {
+      close(STDOUT_FILENO);
+    }
+
+    close(STDERR_FILENO);
+
+    ExecRemote(AP, command);
+  }
+
+  Trace::Complete("fork", "process", start, AP.getName());
+  Trace::Started(child, "ssh", AP.getName());
+
+  wout << level::kDebug2
+       << "Remote command spawned... PID:"
+       << child << std::endl;
+
+  if (input) {
+    close(to_child[0]);
+    *input = to_child[1];
+  }
+
+  if (output) {
+    close(from_child[1]);
+    *output = from_child[0];
+  }
+
+  return child;
+}
+
+/**
+ * Identifies the configuration a push delivers, so that a journal left
+ * by an earlier run is only resumed if nothing it covers has changed
+ *
+ * @method  ConfigGeneration
+ *
+ * @return  Generation string of the local configuration
+ */
+std::string ConfigGeneration()
+{
+  std::stringstream generation;
+  std::string base   = State.lookup(kConfigDirectory);
+  std::string ssid   = State.lookup(kSSID),
+              crypto = State.lookup(kCrypto),
+              secret = State.lookup(kPassword);
+  struct stat info;
+
+  if (!stat(ConfigFile, &info)) {
+    generation << info.st_size << '.' << info.st_mtime << ';';
+  }
+
+  //Both the files pushed as they are and the radio templates PushConfig
+  //sends in place of the wireless file
+  for (const char *subdirectory : { "config/", "radio/" }) {
+    std::string directory = base + subdirectory;
+
+    if (DIR *config = opendir(directory.c_str())) {
+      while (struct dirent *entry = readdir(config)) {
+        std::string path = directory + entry->d_name;
+
+        if (!stat(path.c_str(), &info) && S_ISREG(info.st_mode)) {
+          generation << subdirectory << entry->d_name << ':' << info.st_size
+                     << '.' << info.st_mtime << ';';
+        }
+      }
+
+      closedir(config);
+    }
+  }
+
+  generation << ssid << ';' << crypto << ';' << secret;
+
+  std::stringstream hashed;
+  hashed << std::hex << std::hash<std::string>()(generation.str());
+
+  return hashed.str();
+}
+
+/**
+ * Returns the path of the known_hosts file WRT manages
+ *
+ * @method  KnownHostsPath
+ *
+ * @return  Path of known_hosts, in the configuration directory
+ */
+std::string KnownHostsPath()
+{
+  std::string path = ReadConfigFile().lookup(kConfigDirectory);
+  path += "known_hosts";
+
+  return path;
+}
+
+/**
+ * Returns the credential manager, with only the keys APs accepted read -
+ * enough for ssh run by a push, which is handed the identity file
+ *
+ * @method  GetCredentials
+ *
+ * @return  Credential manager
+ */
+Credentials &GetCredentials()
+{
+  static Credentials *credentials = nullptr;
+
+  if (!credentials) {
+    try {
+      std::string directory = State.lookup(kCertificates),
+                  accepted  = State.lookup(kConfigDirectory);
+      accepted += kDefaultAcceptedKeysFile;
+
+      credentials = new Credentials(directory, accepted);
+      credentials->loadAccepted();
+
+    } catch (...) {
+      std::throw_with_nested(std::runtime_error("GetCredentials() failed."));
+    }
+  }
+
+  return *credentials;
+}
+
+/**
+ * Returns the credential manager, with every identity already read - for
+ * sessions opened in process (--benchmark), which authenticate themselves
+ *
+ * @method  GetIdentities
+ *
+ * @return  Identities to authenticate sessions with
+ */
+Credentials &GetIdentities()
+{
+  static bool loaded = false;
+
+  Credentials &credentials = GetCredentials();
+
+  if (!loaded) {
+    try {
+      std::string directory = State.lookup(kCertificates);
+
+      wout << level::kDebug1
+           << credentials.load() << " identities loaded from \""
+           << directory << "\"" << std::endl;
+
+      loaded = true;
+
+    } catch (...) {
+      std::throw_with_nested(std::runtime_error("GetIdentities() failed."));
+    }
+  }
+
+  return credentials;
+}
+
+/**
+ * Returns the crypto profile for an AP's type - the one recorded in the
+ * configuration by --benchmark, or else the built in one
+ *
+ * @method  GetCryptoProfile
+ *
+ * @param   AP          AP to look up the profile of
+ *
+ * @return              Crypto profile for the AP's type
+ */
+CryptoProfile GetCryptoProfile(AccessPoint &AP)
+{
+  CryptoProfile profile = CryptoProfile::Default(AP.getEnumType());
+  std::string path = std::string(kCryptoProfiles) + '.' + AP.getType();
+
+  if (State.exists(path)) {
+    libconfig::Setting &recorded = State.lookup(path);
+
+    recorded.lookupValue(kCiphers, profile.ciphers);
+    recorded.lookupValue(kKex,     profile.kex);
+    recorded.lookupValue(kMACs,    profile.macs);
+  }
+
+  return profile;
+}
+
+/**
+ * Opens an SSH session to an AP. The host key is checked against known_hosts
+ * right after key exchange. The session is authenticated with the identities already in memory.
+ *
+ * @method  OpenSession
+ *
+ * @param   AP          AP to connect to
+ * @param   session     Session to connect
+ * @param   profile     Crypto profile to use, if not the AP type's own
+ */
+void OpenSession(AccessPoint &AP, ssh::Session &session,
+                 const CryptoProfile *profile)
+{
+  std::string known_hosts = KnownHostsPath(), mac = AP.getMAC();
+
+  session.setOption(SSH_OPTIONS_HOST, getTarget(AP));
+  session.optionsParseConfig(kDefaultSSHConfig);
+  session.setOption(SSH_OPTIONS_KNOWNHOSTS, known_hosts);
+
+  if (profile) {
+    profile->apply(session);
+  } else {
+    GetCryptoProfile(AP).apply(session);
+  }
+
+  session.setHostVerifier([mac](ssh::Session &connected) {
+    if (connected.isServerKnown() != SSH_SERVER_KNOWN_OK) {
+      wout << Output::Verbosity::kDefault
+           << "wrt: Host key of \"" << mac << "\" is not known!" << std::endl;
+      return false;
+    }
+
+    return true;
+  });
+
+  Trace::Clock::time_point start = Trace::Clock::now();
+  bool accepted;
+
+  try {
+    session.connect();
+  } catch (...) {
+    Trace::Complete("connect", "session", start, AP.getName());
+    throw;
+  }
+
+  Trace::Complete("connect", "session", start, AP.getName());
+
+  start    = Trace::Clock::now();
+  accepted = GetIdentities().authenticate(session, mac);
+
+  Trace::Complete("auth", "session", start, AP.getName());
+
+  if (!accepted) {
+    session.disconnect();
+
+    throw std::runtime_error("No identity accepted by \"" +
+                             AP.getName() + "\"");
+  }
+}
+
+/**
+ * Returns the metrics of this run - the run is timed from the first call
+ *
+ * @method  GetPushMetrics
+ *
+ * @return  Latency of each phase, AP by AP, and how the push left the APs
+ */
+PushMetrics &GetPushMetrics()
+{
+  static PushMetrics *metrics = nullptr;
+
+  if (!metrics) {
+    metrics = new PushMetrics();
+  }
+
+  return *metrics;
+}
+
+/**
+ * Writes the metrics to Metrics_Dir (or Log_Dir) as wrt.prom, a Prometheus
+ * textfile, and wrt.json, a summary. WRTd kills a push which runs long - a
+ * push therefore also writes them as it goes, every Metrics_Interval
+ * seconds, so even a push cut short leaves them behind.
+ *
+ * @method  WriteMetrics
+ *
+ * @param   periodic    true if only due every Metrics_Interval seconds
+ */
+void WriteMetrics(bool periodic)
+{
+  static time_t written = time(NULL);
+  std::string directory;
+  int interval = kDefaultMetricsInterval;
+
+  if (!State.lookupValue(kMetricsDirectory, directory) &&
+      !State.lookupValue(kLogDirectory, directory)) {
+    return;
+  }
+
+  State.lookupValue(kMetricsInterval, interval);
+
+  if (periodic && (interval <= 0 || time(NULL) < written + interval)) {
+    return;
+  }
+
+  PushMetrics &metrics = GetPushMetrics();
+
+  if (metrics.empty()) {
+    return;
+  }
+
+  if (!directory.empty() && directory.back() != '/') {
+    directory += '/';
+  }
+
+  directory += kDefaultMetricsFile;
+  written    = time(NULL);
+
+  //Metrics are not worth failing a push over
+  try {
+    metrics.writePrometheus(directory + ".prom");
+    metrics.writeJSON(directory + ".json");
+
+  } catch (const std::exception &exception) {
+    wout << Output::Verbosity::kDefault
+         << "wrt: Metrics not written." << std::endl;
+
+    PrintException(exception, 1);
+  }
+}
+
+/**
+ * Returns the push journal, loaded for the current configuration
+ *
+ * @method  GetCheckpoint
+ *
+ * @return  Checkpoint of the current (or resumed) push
+ */
+Checkpoint &GetCheckpoint()
+{
+  static Checkpoint *journal = nullptr;
+
+  if (!journal) {
+    try {
+      std::string path = State.lookup(kConfigDirectory);
+      path += kDefaultJournalFile;
+
+      journal = new Checkpoint(path);
+      journal->load(ConfigGeneration());
+
+    } catch (...) {
+      std::throw_with_nested(std::runtime_error("GetCheckpoint() failed."));
+    }
+  }
+
+  return *journal;
+}
+
+/**
+ * Returns the push journal as it stands on disk, for selecting by - it is
+ * only read, so a --list never creates or discards a journal
+ *
+ * @method  ReadCheckpoint
+ *
+ * @return  Checkpoint of the current (or last) push, read only
+ */
+Checkpoint &ReadCheckpoint()
+{
+  static Checkpoint *journal = nullptr;
+
+  if (!journal) {
+    try {
+      std::string path = State.lookup(kConfigDirectory);
+      path += kDefaultJournalFile;
+
+      journal = new Checkpoint(path);
+      journal->read(ConfigGeneration());
+
+    } catch (...) {
+      std::throw_with_nested(std::runtime_error("ReadCheckpoint() failed."));
+    }
+  }
+
+  return *journal;
+}
+
+/**
+ * Returns the furthest step of the current push an AP has completed
+ *
+ * @method  PushStep
+ *
+ * @param   AP          AP to look up
+ * @param   journal     Journal of the push
+ *
+ * @return              Last step completed (kNone if none)
+ */
+Checkpoint::Step PushStep(AccessPoint &AP, Checkpoint &journal)
+{
+  Checkpoint::Step step = Checkpoint::Step::kRestarted;
+
+  while (step != Checkpoint::Step::kNone &&
+         !journal.isComplete(AP.getMAC(), step)) {
+    step = static_cast<Checkpoint::Step>(static_cast<int>(step) - 1);
+  }
+
+  return step;
+}
+
+/******************************************************************************
+ * DRIVER FUNCTIONS                                                 [main-DR] *
+ ******************************************************************************/
+
+/**
+ * Function that prints all features of a  single AP, it's meant to
+ * write out a detailled illustration of an AP.
+ *
+ * @method  PrintAP
+ *
+ * @param   AP       AccessPoint object to list data for
+ * @param   index    Index to print. An index of 0 is omitted
+ *                   (remember: index, not offset)
+ * @param   depth    Depth to begin indenting at
  */
 void PrintAP(AccessPoint &AP, int index, int depth)
 {
@@ -742,6 +2502,11 @@ void PrintAP(AccessPoint &AP, int index, int depth)
  */
 void NameAP(AccessPoint &AP, int index, int depth)
 {
+  //Machine readable output names the AP in its record
+  if (OutputFormat != Renderer::Format::kText) {
+    return;
+  }
+
   wout << Output::Verbosity::kBrief
        << std::string(Output::kTabWidth * depth, ' ')
        << std::flush;
@@ -757,437 +2522,1163 @@ void NameAP(AccessPoint &AP, int index, int depth)
        << std::endl;
 }
 
-/**
- * [ListAP description]
- * @param AP    [description]
- * @param index [description]
- * @param depth [description]
- */
-void ListAP(AccessPoint &AP, int depth)
-{
+/**
+ * [ListAP description]
+ * @param AP    [description]
+ * @param index [description]
+ * @param depth [description]
+ */
+void ListAP(AccessPoint &AP, int depth)
+{
+  wout << Output::Verbosity::kBrief
+       << std::string(Output::kTabWidth * depth, ' ')
+       << "MAC  " << AP.getMAC()
+       << std::endl;
+
+
+  if (AP.hasIPv4() || OutputLevel > Output::Verbosity::kVeryVerbose) {
+    wout << Output::Verbosity::kDefault
+         << std::string(Output::kTabWidth * depth, ' ')
+         << "IPv4 " << AP.getIPv4()
+         << std::endl;
+  }
+
+  if (AP.hasLinkLocalIPv4() || OutputLevel > Output::Verbosity::kVeryVerbose) {
+    wout << Output::Verbosity::kDefault
+         << std::string(Output::kTabWidth * depth, ' ')
+         << std::flush;
+
+    switch (OutputLevel) {
+    case Output::Verbosity::kDebug:
+    case Output::Verbosity::kVeryVerbose:
+      wout << Output::Verbosity::kVeryVerbose
+           << "Link Local IPv4 " << AP.getLinkLocalIPv4()
+           << std::endl;
+      break;
+
+    case Output::Verbosity::kVerbose:
+      wout << Output::Verbosity::kVerbose
+           << "L.L. IPv4 " << AP.getLinkLocalIPv4()
+           << std::endl;
+      break;
+
+    default:
+      wout << Output::Verbosity::kDefault
+           << "L.L. " << AP.getLinkLocalIPv4()
+           << std::endl;
+
+      break;
+    }
+  }
+
+  if (AP.hasIPv6() || OutputLevel > Output::Verbosity::kVeryVerbose) {
+    wout << Output::Verbosity::kDefault
+         << std::string(Output::kTabWidth * depth, ' ')
+         << "IPv6 " << AP.getIPv6()
+         << std::endl;
+  }
+
+
+  if (AP.hasLinkLocalIPv6() || OutputLevel > Output::Verbosity::kVeryVerbose) {
+    wout << Output::Verbosity::kDefault
+         << std::string(Output::kTabWidth * depth, ' ')
+         << std::flush;
+
+    switch (OutputLevel) {
+    case Output::Verbosity::kDebug:
+    case Output::Verbosity::kVeryVerbose:
+      wout << Output::Verbosity::kVeryVerbose
+           << "Link Local IPv6 " << AP.getLinkLocalIPv6()
+           << std::endl;
+      break;
+
+    case Output::Verbosity::kVerbose:
+      wout << Output::Verbosity::kVerbose
+           << "L.L. IPv6 " << AP.getLinkLocalIPv6()
+           << std::endl;
+      break;
+
+    default:
+      wout << Output::Verbosity::kDefault
+           << "L.L. " << AP.getLinkLocalIPv6()
+           << std::endl;
+
+      break;
+    }
+  }
+}
+
+/**
+ * Returns the renderer machine readable output is written through
+ *
+ * @method  GetRenderer
+ *
+ * @return  Renderer of the format --format chose, onto stdout
+ */
+Renderer &GetRenderer()
+{
+  static Renderer *renderer = nullptr;
+
+  if (!renderer) {
+    renderer = new Renderer(OutputFormat);
+  }
+
+  return *renderer;
+}
+
+/**
+ * Renders an AP as a record - absent addresses are left null
+ *
+ * @method  RenderAP
+ *
+ * @param   AP       AP to render
+ */
+void RenderAP(AccessPoint &AP)
+{
+  Renderer &renderer = GetRenderer();
+
+  renderer.begin();
+  renderer.field("name", AP.getName());
+  renderer.field("type", AP.getType());
+  renderer.field("mac",  AP.getMAC());
+
+  if (AP.hasIPv4()) {
+    renderer.field("ipv4", AP.getIPv4());
+  } else {
+    renderer.null("ipv4");
+  }
+
+  if (AP.hasIPv6()) {
+    renderer.field("ipv6", AP.getIPv6());
+  } else {
+    renderer.null("ipv6");
+  }
+
+  if (AP.hasLinkLocalIPv4()) {
+    renderer.field("link_local_ipv4", AP.getLinkLocalIPv4());
+  } else {
+    renderer.null("link_local_ipv4");
+  }
+
+  if (AP.hasLinkLocalIPv6()) {
+    renderer.field("link_local_ipv6", AP.getLinkLocalIPv6());
+  } else {
+    renderer.null("link_local_ipv6");
+  }
+
+  renderer.end();
+}
+
+/**
+ * Renders how a push left an AP as a record
+ *
+ * @method  RenderPush
+ *
+ * @param   AP       AP pushed to
+ * @param   journal  Journal of the push
+ * @param   checked  false if the AP was skipped (its config already current)
+ */
+void RenderPush(AccessPoint &AP, Checkpoint &journal, bool checked)
+{
+  Renderer &renderer = GetRenderer();
+  Checkpoint::Step step = PushStep(AP, journal);
+
+  renderer.begin();
+  renderer.field("name", AP.getName());
+  renderer.field("mac",  AP.getMAC());
+  renderer.field("step", Checkpoint::StepToString(step));
+  renderer.field("result", PushResult(AP, journal, checked));
+  renderer.end();
+}
+
+/**
+ * Returns how a push left an AP
+ *
+ * @method  PushResult
+ *
+ * @param   AP       AP pushed to
+ * @param   journal  Journal of the push
+ * @param   checked  false if the AP was skipped (its config already current)
+ *
+ * @return           "complete", "incomplete" or "skipped"
+ */
+const char *PushResult(AccessPoint &AP, Checkpoint &journal, bool checked)
+{
+  if (!checked) {
+    return "skipped";
+  }
+
+  return PushStep(AP, journal) == Checkpoint::Step::kRestarted ?
+         "complete" : "incomplete";
+}
+
+/**
+ * Queues an AP to be added to the inventory
+ *
+ * @method  AddAPConfig
+ *
+ * @param   AP              AP to add
+ * @param   batch           Batch the addition is queued on
+ */
+void AddAPConfig(AccessPoint &AP, Inventory::Batch &batch)
+{
+  wout << Output::Verbosity::kDefault
+       << "wrt: Adding \"" << AP.getName()
+       << "\" to config file." << std::endl;
+
+  batch.add(AP);
+}
+
+/**
+ * Collects the host keys of the given APs and adds them to known_hosts. The
+ * keys are scanned in process, many APs at a time, and appended in a single
+ * write.
+ *
+ * @method  AddAPKeys
+ *
+ * @param   APs       APs to collect host keys from
+ *
+ * @return            Names of the APs no host key could be collected from
+ */
+std::vector<std::string> AddAPKeys(APList &APs)
+{
+  std::string failure_message = "AddAPKeys(APList &) failed.";
+
+  std::unordered_map<std::string, std::string> hosts;
+  std::vector<std::string> unreachable;
+  KnownHosts known_hosts(KnownHostsPath());
+  KeyScanner scanner;
+
+  wout << level::kDebug1
+       << "AddAPKeys(APList &) called." << std::endl;
+
+  for (auto &AP : APs) {
+    std::string host = getTarget(AP.second);
+
+    hosts[host] = AP.first;
+    scanner.add(host);
+  }
+
+  try {
+    known_hosts.load();
+
+    for (auto &key : scanner.scan()) {
+      if (key.ok()) {
+        known_hosts.add(key.host, key.type, key.key);
+
+      } else {
+        wout << Output::Verbosity::kVerbose
+             << "Key scan of \"" << key.host << "\" failed: " << key.error
+             << std::endl;
+
+        unreachable.push_back(hosts[key.host]);
+      }
+    }
+
+    known_hosts.write();
+
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error(failure_message));
+  }
+
+  return unreachable;
+}
+
+/**
+ * Queues an AP to be removed from the inventory
+ *
+ * @method  RemoveAPConfig
+ *
+ * @param   AP              AP to remove (its name is the name or MAC given)
+ * @param   batch           Batch the removal is queued on
+ */
+void RemoveAPConfig(AccessPoint &AP, Inventory::Batch &batch)
+{
+  wout << Output::Verbosity::kDefault
+       << "wrt: Removing \"" << AP.getName()
+       << "\" from config file." << std::endl;
+
+  batch.remove(AP.getName());
+}
+
+/**
+ * Removes every address of an AP from the known_hosts store. The AP named
+ * on the command line is looked up in the inventory (by name, MAC or
+ * address), so the addresses removed are the ones its keys were recorded
+ * under.
+ *
+ * @method  RemoveAPKey
+ *
+ * @param   AP           AP to remove, as given on the command line
+ * @param   known_hosts  Store to remove the AP's keys from
+ */
+void RemoveAPKey(AccessPoint &AP, KnownHosts &known_hosts)
+{
+  AccessPoint *known = GetInventory(State).find(AP.getName());
+
+  if (!known) {
+    return;
+  }
+
+  if (known->hasIPv4()) {
+    known_hosts.remove(known->getIPv4());
+  }
+
+  if (known->hasIPv6()) {
+    known_hosts.remove(known->getIPv6());
+  }
+
+  if (known->hasLinkLocalIPv6()) {
+    known_hosts.remove(known->getLinkLocalIPv6() + '%' + kDefaultInterface);
+  }
+}
+
+/**
+ * [CheckConfig description]
+ *
+ * @method  CheckConfig
+ *
+ * @param   AP           [description]
+ *
+ * @return               [description]
+ */
+bool CheckConfig(AccessPoint &AP)
+{
+  return true;
+}
+
+/**
+ * Finds the identity an AP accepts, for an AP none is remembered for - ssh
+ * is run with each identity file in turn, alone, and the first the AP
+ * accepts is remembered (written out with the credentials). Every later
+ * ssh is then given only that identity.
+ *
+ * @method  AcceptIdentity
+ *
+ * @param   AP          AP to find the identity of
+ *
+ * @return              true if the AP accepted one of the identities
+ */
+bool AcceptIdentity(AccessPoint &AP)
+{
+  Credentials &credentials = GetCredentials();
+  int child, status;
+
+  for (auto &identity : credentials.available()) {
+    if (!(child = ForkChild())) {
+      ExecRemote(AP, "true", identity);
+    }
+
+    status = WaitForChild(child);
+
+    wout << level::kDebug1
+         << "Identity \"" << identity << "\" "
+         << (status ? "refused" : "accepted") << std::endl;
+
+    if (!status) {
+      credentials.accept(AP.getMAC(), identity);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/**
+ * Push configuration files one at a time over ssh, journaling each file as
+ * it completes. A file whose transfer was cut short by an earlier run is
+ * continued from the number of bytes the AP already holds.
+ *
+ * @method  PushConfig
+ *
+ * @param   AP          AP to push the configuration to
+ * @param   journal     Checkpoint of the current push
+ *
+ * @return              true if every file has been transferred
+ */
+bool PushConfig(AccessPoint &AP, Checkpoint &journal)
+{
+  std::string localConfig = State.lookup(kConfigDirectory),
+              remoteConfig(kDefaultRemoteConfigDirectory),
+              radio(localConfig),
+              key = AP.getMAC();
+  std::map<std::string, std::string> files;
+  bool transferred = true;
+  struct stat info;
+  DIR *config;
+
+  localConfig  += "config/";
+  remoteConfig += "config/";
+
+  if (!(config = opendir(localConfig.c_str()))) {
+    throw std::runtime_error("opendir(): cannot open \"" +
+                             localConfig + "\"");
+  }
+
+  while (struct dirent *entry = readdir(config)) {
+    std::string file(entry->d_name);
+
+    files[file] = localConfig + file;
+  }
+
+  closedir(config);
+
+  //The type's radio template, if one is installed, is its wireless file
+  radio += "radio/";
+  radio += types::Profile(AP.getEnumType()).radio;
+
+  if (!stat(radio.c_str(), &info) && S_ISREG(info.st_mode) && info.st_size) {
+    files[kWirelessConfigFile] = radio;
+  }
+
+  for (auto &entry : files) {
+    std::string file(entry.first),
+                local(entry.second),
+                remote(remoteConfig + file);
+    off_t offset = 0;
+
+    if (stat(local.c_str(), &info) || !S_ISREG(info.st_mode)) {
+      continue;
+    }
+
+    if (journal.isTransferred(key, file)) {
+      wout << Output::Verbosity::kVerbose
+           << "Resuming: \"" << file << "\" already transferred"
+           << std::endl;
+      continue;
+    }
+
+    if (journal.isStarted(key, file)) {
+      offset = RemoteFileSize(AP, PartialPath(remote));
+
+      if (offset < 0 || offset > info.st_size) {
+        offset = 0;
+      }
+
+      wout << Output::Verbosity::kVerbose
+           << "Resuming: \"" << file << "\" from byte " << offset
+           << std::endl;
+    }
+
+    journal.setOffset(key, file, offset);
+
+    if (TransferFile(AP, local, remote, offset)) {
+      journal.markTransferred(key, file);
+
+    } else {
+      transferred = false;
+    }
+  }
+
+  return transferred;
+}
+
+/**
+ * Asks an AP how many bytes of a file it holds
+ *
+ * @method  RemoteFileSize
+ *
+ * @param   AP          AP to query
+ * @param   path        Remote path of the file
+ *
+ * @return              Size of the file, or -1 if it could not be read
+ */
+off_t RemoteFileSize(AccessPoint &AP, std::string path)
+{
+  Trace::Span traced("remote file size", "push", AP.getName());
+  std::string command("wc -c < "), reply;
+  char buffer[64];
+  ssize_t length;
+  int output, child;
+
+  command += ShellQuote(path);
+  command += " 2>/dev/null || echo -1";
+
+  child = SpawnRemote(AP, command, NULL, &output);
+
+  while ((length = read(output, buffer, sizeof(buffer))) > 0) {
+    reply.append(buffer, length);
+  }
+
+  close(output);
+
+  if (WaitForChild(child) || reply.empty()) {
+    return -1;
+  }
+
+  return std::strtoll(reply.c_str(), NULL, 10);
+}
+
+/**
+ * Returns the partial file a transfer lands in - hidden, beside the file it
+ * is to replace. PushConfig resumes from its size, TransferFile writes it.
+ *
+ * @method  PartialPath
+ *
+ * @param   remote      Path the file is installed to on the AP
+ *
+ * @return              Path of the partial file
+ */
+std::string PartialPath(std::string remote)
+{
+  std::string::size_type slash = remote.rfind('/');
+
+  return remote.substr(0, slash + 1) + '.' + remote.substr(slash + 1) +
+         kPartialSuffix;
+}
+
+/**
+ * Streams a local file to an AP from the given offset. The data lands in a
+ * partial file first, which is moved into place once it is complete.
+ *
+ * @method  TransferFile
+ *
+ * @param   AP          AP to transfer the file to
+ * @param   local       Path of the local file
+ * @param   remote      Path the file is installed to on the AP
+ * @param   offset      Byte offset to continue the transfer from
+ *
+ * @return              true if the file has been installed on the AP
+ */
+bool TransferFile(AccessPoint &AP,
+                  std::string local,
+                  std::string remote,
+                  off_t offset)
+{
+  Trace::Span traced("transfer file", "push", AP.getName());
+  std::string partial = PartialPath(remote);
+  std::string command;
+  char buffer[4096];
+  ssize_t length = 0;
+  int input, child, file;
+
+  if ((file = open(local.c_str(), O_RDONLY)) == -1 ||
+      lseek(file, offset, SEEK_SET) == -1) {
+    throw std::runtime_error("open(): cannot read \"" + local + "\"");
+  }
+
+  command  = "cat ";
+  command += offset ? ">> " : "> ";
+  command += ShellQuote(partial);
+  command += " && mv " + ShellQuote(partial) + ' ' + ShellQuote(remote);
+
+  wout << level::kDebug1
+       << "Transferring \"" << local << "\" from byte " << offset
+       << std::endl;
+
+  child = SpawnRemote(AP, command, &input, NULL);
+
+  while ((length = read(file, buffer, sizeof(buffer))) > 0) {
+    const char *data = buffer;
+
+    while (length > 0) {
+      ssize_t written = write(input, data, length);
+
+      if (written == -1 && errno != EINTR) {
+        break;
+      }
+
+      if (written > 0) {
+        data   += written;
+        length -= written;
+      }
+    }
+
+    if (length) {
+      break;
+    }
+  }
+
+  close(file);
+  close(input);
+
+  return !WaitForChild(child) && !length;
+}
+
+void PushWirelessConfig(AccessPoint &AP)
+{
+  std::string command("uci set system.hostname="),
+      ssid   = State.lookup(kSSID),
+      crypto = State.lookup(kCrypto),
+      secret = State.lookup(kPassword);
+
+  if (AP.hasName()) {
+    command += AP.getName();
+    command += ';';
+  } else {
+    command.clear();
+  }
+
+  command += "uci set wireless.@wifi-device[0].disabled=0";
+  command += ";uci set wireless.@wifi-iface[0].ssid=";
+  command += ssid;
+  command += ";uci set wireless.@wifi-iface[0].encryption=";
+  command += crypto;
+  command += ";uci set wireless.@wifi-iface[0].key=";
+  command += secret;
+
+  ExecRemote(AP, command);
+}
+
+void CommitConfig(AccessPoint &AP)
+{
+  ExecRemote(AP, kCommitCommand);
+}
+
+/**
+ * Two phase commit across every prepared AP. A session is opened to each AP
+ * which reports "ready" and then blocks on its stdin; once every session is
+ * ready (or the prepare timeout passes) the commit is released to all ready
+ * sessions at once, so the fleet switches over within the same moment.
+ *
+ * APs which never reported ready are left prepared, for a later push.
+ *
+ * Each session is an ssh child holding two pipes until the commit, so no
+ * more than Sync_Limit APs are committed at once - a larger set fails before
+ * any session opens, all left prepared, rather than run out of processes or
+ * descriptors part way.
+ *
+ * @method  SynchronizedCommit
+ *
+ * @param   prepared    APs whose changes are staged but not committed
+ * @param   journal     Checkpoint of the current push
+ */
+void SynchronizedCommit(std::vector<AccessPoint *> &prepared,
+                        Checkpoint &journal)
+{
+  struct Participant {
+    AccessPoint *AP;
+    int child, input, output;
+    bool ready;
+  };
+
+  std::vector<Participant> sessions;
+  std::vector<struct pollfd> waiting;
+  std::string command("echo ready;"
+                      "read go;"
+                      "[ \"$go\" = commit ] || exit 1;");
+  struct rlimit limit;
+  int ready = 0, most = kDefaultSyncLimit;
+
+  command += kCommitCommand;
+  command += ';';
+  command += kRestartCommand;
+
+  if (prepared.empty()) {
+    return;
+  }
+
+  State.lookupValue(kSyncLimit, most);
+
+  if ((int) prepared.size() > most) {
+    throw std::runtime_error(std::to_string(prepared.size()) + " APs are "
+                             "prepared, more than Sync_Limit (" +
+                             std::to_string(most) + ") may commit at once."
+                             " Push a smaller --where selection.");
+  }
+
+  //Every session holds two pipes open for the length of the barrier
+  if (!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  if (!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_cur != RLIM_INFINITY &&
+      limit.rlim_cur < 2 * prepared.size() + 64) {
+    throw std::runtime_error(std::to_string(prepared.size()) + " APs are "
+                             "prepared, more than the open file limit (" +
+                             std::to_string(limit.rlim_cur) + ") allows to"
+                             " commit at once.");
+  }
+
   wout << Output::Verbosity::kBrief
-       << std::string(Output::kTabWidth * depth, ' ')
-       << "MAC  " << AP.getMAC()
-       << std::endl;
+       << "Preparing synchronized commit on " << prepared.size()
+       << " APs..." << std::endl;
 
+  for (auto AP : prepared) {
+    Participant session = { AP, -1, -1, -1, false };
 
-  if (AP.hasIPv4() || OutputLevel > Output::Verbosity::kVeryVerbose) {
-    wout << Output::Verbosity::kDefault
-         << std::string(Output::kTabWidth * depth, ' ')
-         << "IPv4 " << AP.getIPv4()
-         << std::endl;
+    session.child = SpawnRemote(*AP, command, &session.input, &session.output);
+    sessions.push_back(session);
+
+    struct pollfd fd = { session.output, POLLIN, 0 };
+    waiting.push_back(fd);
   }
 
-  if (AP.hasLinkLocalIPv4() || OutputLevel > Output::Verbosity::kVeryVerbose) {
-    wout << Output::Verbosity::kDefault
-         << std::string(Output::kTabWidth * depth, ' ')
-         << std::flush;
+  //Prepare barrier - wait for every session to report in
+  Trace::Clock::time_point barrier = Trace::Clock::now();
+  time_t deadline = time(NULL) + kDefaultPrepareTimeout;
 
-    switch (OutputLevel) {
-    case Output::Verbosity::kDebug:
-    case Output::Verbosity::kVeryVerbose:
-      wout << Output::Verbosity::kVeryVerbose
-           << "Link Local IPv4 " << AP.getLinkLocalIPv4()
-           << std::endl;
-      break;
+  while (ready < (int) sessions.size() && time(NULL) < deadline) {
+    if (poll(waiting.data(), waiting.size(), 1000) <= 0) {
+      continue;
+    }
 
-    case Output::Verbosity::kVerbose:
-      wout << Output::Verbosity::kVerbose
-           << "L.L. IPv4 " << AP.getLinkLocalIPv4()
-           << std::endl;
-      break;
+    for (size_t i = 0; i < waiting.size(); ++i) {
+      char reply[16];
+      ssize_t length;
 
-    default:
-      wout << Output::Verbosity::kDefault
-           << "L.L. " << AP.getLinkLocalIPv4()
-           << std::endl;
+      if (waiting[i].fd == -1 || !waiting[i].revents) {
+        continue;
+      }
 
-      break;
+      length = read(waiting[i].fd, reply, sizeof(reply));
+      sessions[i].ready = length > 0 && !strncmp(reply, "ready", 5);
+      waiting[i].fd = -1;
+
+      if (sessions[i].ready) {
+        ready++;
+      }
     }
   }
 
-  if (AP.hasIPv6() || OutputLevel > Output::Verbosity::kVeryVerbose) {
-    wout << Output::Verbosity::kDefault
-         << std::string(Output::kTabWidth * depth, ' ')
-         << "IPv6 " << AP.getIPv6()
-         << std::endl;
+  Trace::Complete("prepare barrier", "push", barrier);
+
+  wout << Output::Verbosity::kDefault
+       << ready << " of " << sessions.size()
+       << " APs prepared, committing." << std::endl;
+
+  //Commit barrier - release every ready session back to back
+  barrier = Trace::Clock::now();
+
+  for (auto &session : sessions) {
+    const char *go = session.ready ? "commit\n" : "abort\n";
+
+    if (write(session.input, go, strlen(go)) == -1) {
+      session.ready = false;
+    }
+
+    close(session.input);
   }
 
+  Trace::Complete("commit barrier", "push", barrier);
 
-  if (AP.hasLinkLocalIPv6() || OutputLevel > Output::Verbosity::kVeryVerbose) {
-    wout << Output::Verbosity::kDefault
-         << std::string(Output::kTabWidth * depth, ' ')
-         << std::flush;
+  for (auto &session : sessions) {
+    int status;
 
-    switch (OutputLevel) {
-    case Output::Verbosity::kDebug:
-    case Output::Verbosity::kVeryVerbose:
-      wout << Output::Verbosity::kVeryVerbose
-           << "Link Local IPv6 " << AP.getLinkLocalIPv6()
-           << std::endl;
-      break;
+    close(session.output);
 
-    case Output::Verbosity::kVerbose:
-      wout << Output::Verbosity::kVerbose
-           << "L.L. IPv6 " << AP.getLinkLocalIPv6()
-           << std::endl;
-      break;
+    if (!session.ready) {
+      kill(session.child, SIGTERM);
+    }
 
-    default:
-      wout << Output::Verbosity::kDefault
-           << "L.L. " << AP.getLinkLocalIPv6()
-           << std::endl;
+    if (!(status = WaitForChild(session.child)) && session.ready) {
+      journal.mark(session.AP->getMAC(), Checkpoint::Step::kRestarted);
 
-      break;
+    } else if (session.ready) {
+      wout << level::kDebug
+           << "Subprocess " << session.child << ": Exited with status "
+           << status << std::endl;
+    }
+
+    if (!session.ready) {
+      wout << Output::Verbosity::kDefault
+           << "wrt: \"" << session.AP->getName()
+           << "\" was not prepared in time, left uncommitted" << std::endl;
     }
   }
 }
 
 /**
- * Adds AP to the config file
+ * Restarts the wireless on an AP - the disruptive step of a push
  *
- * @method  AddAPConfig
+ * @method  RestartWireless
  *
- * @param   AP           AP information to add
+ * @param   AP          AP to restart the wireless on
+ *
+ * @return              true if the restart succeeded
  */
-void AddAPConfig(AccessPoint &AP)
+bool RestartWireless(AccessPoint &AP)
 {
-  wout << Output::Verbosity::kDefault
-       << "wrt: Adding \"" << AP.getName()
-       << "\" to config file:" << std::endl;
-
-  try {
-    libconfig::Setting &APList = State.lookup(kAPList);
-
-    for (int i = 0, size = APList.getLength(); i < size; i++) {
-      std::string name = APList[i][kAPName],
-                  mac  = APList[i][kAPMAC];
+  Trace::Span traced("restart", "push", AP.getName());
+  PushMetrics::Clock::time_point start = PushMetrics::Clock::now();
+  int status, child = SpawnRemote(AP, kRestartCommand);
+
+  if ((status = WaitForChild(child))) {
+    wout << level::kDebug
+         << "Subprocess " << child << ": Exited with status "
+         << status << std::endl;
+  }
 
-      if (mac == AP.getMAC() || name == AP.getName()) {
-        std::string already_exists(1, '"');
-        already_exists += AP.getName();
-        already_exists += "\" already exists!";
+  GetPushMetrics().record(AP.getName(), PushMetrics::Phase::kRestart, start,
+                          !status);
 
-        throw std::runtime_error(already_exists);
-      }
-    }
+  return !status;
+}
 
-    libconfig::Setting &NewEntry = APList.add(libconfig::Setting::TypeGroup);
+/**
+ * Returns the maintenance policy, read from the configuration file
+ *
+ * @method  GetMaintenancePolicy
+ *
+ * @return  The policy disruptive push steps are held to
+ */
+MaintenancePolicy &GetMaintenancePolicy()
+{
+  static MaintenancePolicy policy;
+  static bool loaded = false;
 
-    NewEntry.add(kAPName, libconfig::Setting::TypeString) = AP.getName();
-    NewEntry.add(kAPType, libconfig::Setting::TypeString) = AP.getType();
-    NewEntry.add(kAPMAC,  libconfig::Setting::TypeString) = AP.getMAC();
-    NewEntry.add(kAPIPv4, libconfig::Setting::TypeString) = AP.getIPv4();
-    NewEntry.add(kAPIPv6, libconfig::Setting::TypeString) = AP.getIPv6();
+  if (!loaded) {
+    std::string window;
+    int stations = -1, throughput = -1;
 
-    WriteConfigFile(State);
+    if (State.lookupValue(kMaintenanceWindow, window) &&
+        !policy.setWindow(window)) {
+      throw std::runtime_error("\"" + window + "\": is not a valid "
+                               "maintenance window (HH:MM-HH:MM).");
+    }
 
-  } catch (std::runtime_error const &e) {
-    print_exception(e);
+    State.lookupValue(kMaxStations, stations);
+    State.lookupValue(kMaxThroughput, throughput);
 
-  } catch (...) {
-    std::throw_with_nested(std::runtime_error("AddAPConfig"
-                           "(libconfig::Config &, AccessPoint &AP) failed."));
+    policy.setMaxStations(stations);
+    policy.setMaxThroughput(throughput);
+    loaded = true;
   }
 
-  return;
+  return policy;
 }
 
 /**
- * Adds AP key to known_hosts
+ * Measures the load on an AP and decides if its wireless may restart now
  *
- * @method  AddAPKey
+ * @method  MaintenanceAllows
  *
- * @param   AP        AP information to get ssh pubkey from
+ * @param   AP          AP to check
+ *
+ * @return              true if the restart may go ahead
  */
-void AddAPKey(AccessPoint &AP)
+bool MaintenanceAllows(AccessPoint &AP)
 {
-  std::string failure_message  =  "AddAPKey(AccessPoint &) failed.";
-  std::string known_hosts_path =  ReadConfigFile().lookup(kConfigDirectory);
-  known_hosts_path += std::string("known_hosts");
+  MaintenancePolicy &policy = GetMaintenancePolicy();
+  MaintenancePolicy::Load load;
+  std::string interface(kDefaultWirelessInterface), reply;
+  char buffer[256];
+  ssize_t length;
+  int output, child;
+
+  if (!policy.isRestricted() || policy.inWindow(time(NULL))) {
+    return true;
+  }
 
-  int child = 0, status, known_hosts;
+  //Without load thresholds, only the window can allow a restart
+  if (!policy.hasThresholds()) {
+    return false;
+  }
 
-  wout << Output::Verbosity::kDebug1
-       << "AddAPKey(AccessPoint &) called." << std::endl;
+  State.lookupValue(kWirelessInterface, interface);
 
-  wout << Output::Verbosity::kDebug2
-       << "Opening file \"" << known_hosts_path << "\" for child process"
-       << std::endl;
+  Trace::Span traced("measure load", "push", AP.getName());
 
-  known_hosts = open(known_hosts_path.c_str(),
-                     O_WRONLY | O_APPEND | O_CREAT,
-                     S_IRUSR | S_IWUSR);
+  child = SpawnRemote(AP, MaintenancePolicy::LoadCommand(interface),
+                      NULL, &output);
 
-  if (known_hosts != -1) {
-    wout << Output::Verbosity::kDebug2
-         << "File opened successfully!" << std::endl;
+  while ((length = read(output, buffer, sizeof(buffer))) > 0) {
+    reply.append(buffer, length);
+  }
 
-    wout << Output::Verbosity::kDebug3
-         << "File \"" << known_hosts_path
-         << "\" opened as fd " << known_hosts << std::endl;
+  close(output);
+  WaitForChild(child);
 
-    if ((child = fork()) != -1) {
-      if (child) {
-        wout << Output::Verbosity::kDebug2
-             << "Child process spawned - closing known_hosts file"
-             << " and waiting for child." << std::endl;
+  if (!MaintenancePolicy::ParseLoad(reply, load)) {
+    wout << Output::Verbosity::kVerbose
+         << "Could not measure load on \"" << AP.getName() << "\""
+         << std::endl;
+  }
 
-        close(known_hosts);
-        waitpid(child, &status, 0);
+  if (policy.allowsRestart(load, time(NULL))) {
+    return true;
+  }
 
-        wout << Output::Verbosity::kDebug2
-             << "Child process termination."
-             << std::endl << std::flush;
+  wout << Output::Verbosity::kDefault
+       << "wrt: \"" << AP.getName() << "\" is busy ("
+       << load.stations << " stations, " << load.throughput
+       << " B/s), deferring wireless restart" << std::endl;
 
-        wout << Output::Verbosity::kDebug3
-             << "Child process exit status: "
-             << WEXITSTATUS(status)
-             << std::endl << std::flush;
+  return false;
+}
 
-      } else {
-        dup2(known_hosts, STDOUT_FILENO);
-        close(STDIN_FILENO);
-        close(STDERR_FILENO);
+/**
+ * Picks up a SIGHUP, or a changed inventory file, between the windows of a
+ * push. Should the inventory be reloaded, the rest of the push streams it
+ * as it is now - less the APs already pushed, which are only remembered by
+ * their MACs.
+ *
+ * @method  ReloadStream
+ *
+ * @param   config      Configuration holding the managed APs
+ * @param   stream      Stream of the push, re-sourced on a reload
+ * @param   selected    APs --where selected, selected again on a reload
+ * @param   pushed      MACs of the APs pushed so far
+ */
+void ReloadStream(libconfig::Config &config, InventoryStream &stream,
+                  std::vector<AccessPoint> &selected,
+                  std::vector<uint64_t> &pushed)
+{
+  try {
+    if (!ReloadInventory(config)) {
+      return;
+    }
 
-        execlp("ssh-keyscan",
-               "ssh-keyscan",
-               getTarget(AP).c_str(),
-               (char *)NULL);
+  } catch (const std::exception &exception) {
+    wout << Output::Verbosity::kDefault
+         << "wrt: Inventory not reloaded, still pushing the APs as they were."
+         << std::endl;
 
-        std::exit(kExitFailure);
-      }
-    }
+    PrintException(exception, 1);
   }
 
-  if (known_hosts == -1 || child == -1) {
-    try {
-      std::string error;
+  //A failed reload may still have closed the image read from
 
-      if (known_hosts == -1) {
-        error = "open(): cannot open file \"" + known_hosts_path + "\"";
-      }
+  InventoryStream::Source source;
+  size_t done = pushed.size();
 
-      else {
-        error = "fork(): returned -1";
-      }
+  std::sort(pushed.begin(), pushed.end());
 
-      throw std::runtime_error(error);
-    }
+  try {
+    if (Selecting) {
+      selected = SelectAPs(config, Where);
+      source = InventoryStream::Of(selected);
 
-    catch (...) {
-      std::throw_with_nested(std::runtime_error(failure_message));
+    } else {
+      source = GetInventorySource(config);
     }
+
+  } catch (const std::exception &exception) {
+    wout << Output::Verbosity::kDefault
+         << "wrt: Inventory unreadable, the rest of the push is skipped."
+         << std::endl;
+
+    PrintException(exception, 1);
+
+    stream.reset([](AccessPoint &) { return false; });
+    return;
   }
 
-  return;
+  stream.reset([source, &pushed, done](AccessPoint &AP) mutable {
+    while (source(AP)) {
+      if (!std::binary_search(pushed.begin(), pushed.begin() + done,
+                              AP.getMACValue())) {
+        return true;
+      }
+    }
+
+    return false;
+  });
 }
 
 /**
- * Removes AP key from config file
+ * Polls APs whose wireless restart was deferred, restarting each once it is
+ * quiet or the maintenance window opens. APs still busy when the defer limit
+ * passes are left committed, for a later push to restart - WRTd stops each
+ * push after 60 seconds, so the limit must pass well before then.
  *
- * @method  RemoveAPConfig
+ * @method  DeferredRestart
  *
- * @param   AP              [description]
+ * @param   deferred    APs committed, but not yet restarted
+ * @param   journal     Checkpoint of the current push
  */
-void RemoveAPConfig(AccessPoint &AP)
+void DeferredRestart(std::vector<AccessPoint *> &deferred, Checkpoint &journal)
 {
-  std::string error_message = "RemoveAPConfig() failed";
+  int limit = kDefaultDeferLimit;
+  time_t deadline;
 
-  wout << "wrt: Removing \"" << AP.getName()
-       << "\" from config file." << std::endl;
+  State.lookupValue(kDeferLimit, limit);
+  deadline = time(NULL) + limit;
 
-  try {
-    libconfig::Config &config = ReadConfigFile();
-    libconfig::Setting &APList = config.lookup(kAPList);
+  wout << Output::Verbosity::kBrief
+       << "Waiting on " << deferred.size()
+       << " busy APs to restart wireless..." << std::endl;
+
+  while (!deferred.empty() && time(NULL) + kDefaultLoadPollInterval < deadline) {
+    Trace::Clock::time_point waited = Trace::Clock::now();
 
-    for (int i = 0, size = APList.getLength(); i < size; i++) {
-      std::string name = APList[i][kAPName],
-                  mac  = APList[i][kAPMAC];
+    sleep(kDefaultLoadPollInterval);
+    Trace::Complete("wait", "push", waited);
 
-      if (name == AP.getName() || mac == AP.getMAC()) {
-        wout << Output::Verbosity::kDebug1
-             << "Removing kAPList index " << i << std::endl;
+    //The inventory may change while APs wait - those since removed, or
+    //given another MAC, are dropped (what was pushed is not what the name
+    //is now), and the rest restarted as they are now configured
+    try {
+      if (ReloadInventory(State)) {
+        for (auto AP = deferred.begin(); AP != deferred.end();) {
+          AccessPoint *known = GetInventory(State).find((*AP)->getName());
+
+          if (known && known->getMACValue() == (*AP)->getMACValue()) {
+            **AP = *known;
+            ++AP;
+
+          } else {
+            wout << Output::Verbosity::kDefault
+                 << "wrt: \"" << (*AP)->getName()
+                 << "\" left the inventory, or changed MAC, while waiting -"
+                 << " wireless restart dropped" << std::endl;
 
-        APList.remove(i);
+            AP = deferred.erase(AP);
+          }
+        }
       }
+
+    } catch (const std::exception &exception) {
+      wout << Output::Verbosity::kDefault
+           << "wrt: Inventory not reloaded, still restarting the APs as they"
+           << " were." << std::endl;
+
+      PrintException(exception, 1);
     }
 
-  } catch (const std::exception &exception) {
-    print_exception(exception);
+    for (auto AP = deferred.begin(); AP != deferred.end();) {
+      if (MaintenanceAllows(**AP) && RestartWireless(**AP)) {
+        journal.mark((*AP)->getMAC(), Checkpoint::Step::kRestarted);
+        AP = deferred.erase(AP);
 
-  } catch (...) {
-    std::throw_with_nested(std::runtime_error(error_message));
+      } else {
+        ++AP;
+      }
+    }
+
+    WriteMetrics(true);
   }
 
-  return;
+  for (auto AP : deferred) {
+    wout << Output::Verbosity::kDefault
+         << "wrt: \"" << AP->getName()
+         << "\" stayed busy, wireless restart left for a later push"
+         << std::endl;
+  }
 }
 
 /**
- * Removes AP key from known_hosts
+ * Benchmarks SSH crypto on one AP of each type, and records the fastest
+ * profile for each type in the configuration file. Every later connection
+ * to an AP of that type - ssh or library - uses the recorded profile.
  *
- * @method  RemoveAPKey
+ * @method  BenchmarkCrypto
  *
- * @param   APInfo       [description]
+ * @param   config      Configuration holding the managed APs
  */
-void RemoveAPKey(AccessPoint &AP)
+void BenchmarkCrypto(libconfig::Config &config)
 {
-  std::string known_hosts_path = ReadConfigFile().lookup(kConfigDirectory);
-  known_hosts_path += "known_hosts";
+  std::unordered_map<std::string, AccessPoint *> samples;
+  std::vector<std::string> types;
+  std::vector<AccessPoint *> fleet;
+  std::vector<AccessPoint> selected;
 
-  if (!std::ifstream(known_hosts_path.c_str())) {
-    std::exit(kExitSuccess);
-  }
+  wout << level::kDebug1
+       << "BenchmarkCrypto(libconfig::Config &) called." << std::endl;
+
+  try {
+    //With --where, only the types (and APs) selected are measured
+    if (Selecting) {
+      selected = SelectAPs(config, Where);
 
-  if (AP.hasIPv4()) {  /* Remove IPv4 from known_hosts */
-    int child = 0;
+      for (auto &AP : selected) {
+        fleet.push_back(&AP);
+      }
 
-    if ((child = fork()) != -1) {
-      if (child) { /* Parent */
-        int status = 0;
-        waitpid(child, &status, 0);
+    } else {
+      for (auto &AP : GetAPList(config)) {
+        fleet.push_back(&AP.second);
+      }
+    }
 
-      } else { /* Child */
-        execlp("ssh-keygen",
-               "ssh-keygen", "-q",
-               "-R", AP.getIPv4().c_str(),
-               "-f", known_hosts_path.c_str(),
-               NULL);
+    for (auto AP : fleet) {
+      std::string type = AP->getType();
 
-        std::exit(kExitFailure);
+      if (!samples.count(type)) {
+        samples[type] = AP;
+        types.push_back(type);
       }
     }
-  }
 
-  if (AP.hasIPv6()) {  /* Remove IPv6 from known_hosts */
-    int child = 0;
+    for (auto &type : types) {
+      AccessPoint &AP = *samples[type];
+      Trace::Span traced("benchmark", "benchmark", AP.getName());
+      std::vector<CryptoBenchmark::Result> results;
 
-    if ((child = fork()) != -1) {
-      if (child) { /* Parent */
-        int status = 0;
-        waitpid(child, &status, 0);
+      CryptoBenchmark benchmark([&AP](ssh::Session &session,
+                                      const CryptoProfile &profile) {
+        OpenSession(AP, session, &profile);
+      });
 
-      } else { /* Child */
-        execlp("ssh-keygen",
-               "ssh-keygen", "-q",
-               "-R", AP.getIPv6().c_str(),
-               "-f", known_hosts_path.c_str(),
-               NULL);
+      wout << Output::Verbosity::kDefault
+           << "wrt: Measuring \"" << type << "\" on \"" << AP.getName()
+           << "\"..." << std::endl;
 
-        std::exit(kExitFailure);
-      }
-    }
-  }
+      CryptoProfile fastest = benchmark.run(GetCryptoProfile(AP), &results);
+      bool any = false;
 
-  if (AP.hasLinkLocalIPv6()) {
-    execlp("ssh-keygen",
-           "ssh-keygen", "-q",
-           "-R", AP.getLinkLocalIPv6().append("\%eth0").c_str(),
-           "-f", known_hosts_path.c_str(),
-           NULL);
+      for (auto &result : results) {
+        wout << Output::Verbosity::kVerbose
+             << std::string(Output::kTabWidth, ' ')
+             << result.profile.kex.substr(0, result.profile.kex.find(','))
+             << " / "
+             << result.profile.ciphers.substr(0,
+                                              result.profile.ciphers.find(','))
+             << ": ";
+
+        if (!result.ok()) {
+          wout << Output::Verbosity::kVerbose << "failed" << std::endl;
+          continue;
+        }
 
-    std::exit(kExitFailure);
-  }
+        any = true;
 
-  std::exit(kExitFailure);
-}
+        wout << Output::Verbosity::kVerbose
+             << static_cast<int>(result.handshake * 1000) << " ms handshake";
 
-/**
- * [CheckConfig description]
- *
- * @method  CheckConfig
- *
- * @param   AP           [description]
- *
- * @return               [description]
- */
-bool CheckConfig(AccessPoint &AP)
-{
-  return true;
-}
+        if (result.throughput >= 0) {
+          wout << Output::Verbosity::kVerbose
+               << ", " << static_cast<int>(result.throughput / 1024)
+               << " KiB/s";
+        }
 
-/**
- * Push configuration using fork, scp, and ssh
- *
- * @method  PushConfig
- *
- * @param   AP          [description]
- */
-void PushConfig(AccessPoint &AP)
-{
-  std::string localConfig = State.lookup(kConfigDirectory);
-  localConfig += "config";
+        wout << Output::Verbosity::kVerbose << std::endl;
+      }
 
-  std::cout << localConfig;
+      if (!any) {
+        wout << Output::Verbosity::kDefault
+             << "wrt: No profile worked with \"" << AP.getName()
+             << "\", \"" << type << "\" left as it was." << std::endl;
+        continue;
+      }
 
-  execlp("scp",
-         "scp",
-         "-F",
-         "/etc/wrt/ssh_config",
-         "-pr",
-         localConfig.c_str(),
-         SCPTarget(AP).c_str(),
-         (char *)NULL);
+      GetConfigStore().mutate([type, fastest](libconfig::Config &settings) {
+        libconfig::Setting &root = settings.getRoot();
 
-  std::exit(kExitFailure);
-}
+        if (!root.exists(kCryptoProfiles)) {
+          root.add(kCryptoProfiles, libconfig::Setting::TypeGroup);
+        }
 
-void PushWirelessConfig(AccessPoint &AP)
-{
-  std::string command("uci set system.hostname="),
-      target(getTarget(AP)),
-      ssid   = State.lookup(kSSID),
-      crypto = State.lookup(kCrypto),
-      secret = State.lookup(kPassword);
+        libconfig::Setting &profiles = root[kCryptoProfiles];
 
-  if (AP.hasName()) {
-    command += AP.getName();
-    command += ';';
-  } else {
-    command.clear();
-  }
+        if (profiles.exists(type)) {
+          profiles.remove(type);
+        }
 
-  command += "uci set wireless.@wifi-device[0].disabled=0";
-  command += ";uci set wireless.@wifi-iface[0].ssid=";
-  command += ssid;
-  command += ";uci set wireless.@wifi-iface[0].encryption=";
-  command += crypto;
-  command += ";uci set wireless.@wifi-iface[0].key=";
-  command += secret;
+        libconfig::Setting &recorded =
+          profiles.add(type, libconfig::Setting::TypeGroup);
 
+        recorded.add(kCiphers, libconfig::Setting::TypeString) =
+          fastest.ciphers;
+        recorded.add(kKex,     libconfig::Setting::TypeString) = fastest.kex;
+        recorded.add(kMACs,    libconfig::Setting::TypeString) = fastest.macs;
+      });
 
-  execlp("ssh",
-         "ssh",
-         "-F",
-         "/etc/wrt/ssh_config",
-         target.c_str(),
-         command.c_str(),
-         (char *)NULL);
+      wout << Output::Verbosity::kDefault
+           << "wrt: \"" << type << "\" will use " << fastest.kex
+           << " and " << fastest.ciphers << std::endl;
+    }
 
-  std::exit(kExitSuccess);
-}
+    WriteConfigFile(ConfigFile);
 
-void CommitConfig(AccessPoint &AP)
-{
-  std::string target(getTarget(AP));
-  auto command = "uci commit dhcp;"
-                 "uci commit 6relayd;"
-                 "uci commit dropbear;"
-                 "uci commit firewall;"
-                 "uci commit network;"
-                 "uci commit ubootenv;"
-                 "uci commit wireless;"
-                 "wifi down;"
-                 "wifi up";
-  execlp("ssh",
-         "ssh",
-         "-F",
-         "/etc/wrt/ssh_config",
-         target.c_str(),
-         command,
-         (char *)NULL);
+    //Identities accepted along the way are kept
+    GetCredentials().write();
 
-  std::exit(kExitSuccess);
+  } catch (...) {
+    std::throw_with_nested(std::runtime_error("BenchmarkCrypto"
+                           "(libconfig::Config &) failed."));
+  }
 }
 
 /******************************************************************************
@@ -1224,11 +3715,55 @@ void Help()
             << "\tRemove an AP from managed devices"
             << std::endl << std::endl;
 
+  std::cout << "  -S <NAME>"
+            << "\t--shard <NAME>"
+            << "\tWith --add, write to the inventory shard NAME.cfg in"
+            << std::endl
+            << "\t\t\t\tInventory_Dir, rather than to the config file."
+            << std::endl << std::endl;
+
+  std::cout << "  -w <SELECTOR>" << std::endl;
+  std::cout << "  --where <SELECTOR>"
+            << "\tLimit --list, --push or --benchmark to the access"
+            << std::endl
+            << "\t\t\t\tpoints selected, e.g. \"type=TL-MR3020,"
+            << "net=10.4.0.0/16\"" << std::endl
+            << "\t\t\t\t(keys: name, type, net, push). --remove"
+            << std::endl
+            << "\t\t\t\ttakes a selector in place of an AP."
+            << std::endl << std::endl;
+
+  std::cout << "  -o <FORMAT>"
+            << "\t--format <FORMAT>"
+            << "\tWrite --list and --push results as json, ndjson"
+            << std::endl
+            << "\t\t\t\tor csv records (text, the default, as now)."
+            << std::endl << std::endl;
+
+  std::cout << "  -t <FILE>"
+            << "\t--trace <FILE>"
+            << "\tWrite a timeline of the run - every AP, push step"
+            << std::endl
+            << "\t\t\t\tand ssh child - to FILE as Chrome trace events."
+            << std::endl << std::endl;
+
   std::cout << "  -p"
             << "\t\t--push"
             << "\t\tUpdate configs on managed access points."
             << std::endl << std::endl;
 
+  std::cout << "  -s"
+            << "\t\t--sync"
+            << "\t\tWith --push, commit on all access points at once."
+            << std::endl << std::endl;
+
+  std::cout << "  -k"
+            << "\t\t--benchmark"
+            << "\tMeasure SSH ciphers and key exchanges on each type of"
+            << std::endl
+            << "\t\t\t\taccess point, and record the fastest."
+            << std::endl << std::endl;
+
   std::cout << "  -u"
             << "\t\t--usage"
             << "\t\tGive a short usage message"
@@ -1264,12 +3799,18 @@ void Help()
  */
 void Usage()
 {
-  std::cout << "Usage: wrt\t[-lpuvbhV]" << std::endl;
-  std::cout << "\t\t[--list] [--push] [--usage] [--verbose]" << std::endl;
+  std::cout << "Usage: wrt\t[-lpskuvbhV]" << std::endl;
+  std::cout << "\t\t[--list] [--push] [--sync] [--benchmark] [--usage]"
+            << std::endl;
+  std::cout << "\t\t[--verbose]" << std::endl;
   std::cout << "\t\t[--brief] [--help] [--version]" << std::endl;
   std::cout << "\t\t[-c <CONFIG FILE>] [--config <CONFIG FILE>]" << std::endl;
   std::cout << "\t\t[-a <AP NAME> <AP MAC>]"
             << " [--add <AP NAME> <AP MAC>]" << std::endl;
+  std::cout << "\t\t[-S <SHARD>] [--shard <SHARD>]" << std::endl;
+  std::cout << "\t\t[-w <SELECTOR>] [--where <SELECTOR>]" << std::endl;
+  std::cout << "\t\t[-o <FORMAT>] [--format <FORMAT>]" << std::endl;
+  std::cout << "\t\t[-t <FILE>] [--trace <FILE>]" << std::endl;
   std::cout << "\t\t[-r <AP NAME> | <AP MAC>]"
             << " [--remove <AP NAME> | <AP MAC>]" << std::endl;
 